@@ -120,9 +120,9 @@ namespace InsanityEditor
 				ImGuizmo::Enable(node);
 				if (node)
 				{
-					auto transform = node->WorldTransform().Get().ToMatrix();
-					ImGuizmo::Manipulate(camera.viewTransform._values.data(), camera.perspectiveTransform._values.data(), ImGuizmo::OPERATION::TRANSLATE, ImGuizmo::MODE::LOCAL, transform._values.data());
-					node->WorldTransform().Set(InsanityFramework::Transform::FromMatrix(transform));
+					auto transform = node->GetWorldMatrix();
+					if (ImGuizmo::Manipulate(camera.viewTransform._values.data(), camera.perspectiveTransform._values.data(), ImGuizmo::OPERATION::TRANSLATE, ImGuizmo::MODE::LOCAL, transform._values.data()))
+						node->WorldTransform().Set(InsanityFramework::Transform::FromMatrix(transform));
 				}
 				ImGui::EndChild();
 			});
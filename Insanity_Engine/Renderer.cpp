@@ -404,7 +404,7 @@ namespace InsanityEngine::Renderer
 	}
 	void SpriteHandle::SetTransform(xk::Math::Vector<float, 2> position, xk::Math::Degree<float> rotation, xk::Math::Vector<float, 2> scale)
 	{
-		SetTransform(xk::Math::RotationZMatrix(rotation) * xk::Math::TransformMatrix<float>(position) * xk::Math::ScaleMatrix<float>({ scale, 1 }));
+		SetTransform(xk::Math::TransformMatrix<float>(position) * xk::Math::RotationZMatrix(rotation) * xk::Math::ScaleMatrix<float>({ scale, 1 }));
 	}
 	void SpriteHandle::SetTexture(TypedD3D11::Wrapper<ID3D11ShaderResourceView> texture)
 	{
@@ -205,7 +205,7 @@ namespace InsanityFramework
 			if(alignedSize >= dataRegionSize)
 				return nullptr;
 
-			Append(std::construct_at<FreeListHeader>(DataRegion().SplitFromEnd(alignedSize), requestedSize));
+			Append(std::construct_at<FreeListHeader>(DataRegion().SplitFromEnd(alignedSize), alignedSize - sizeof(FreeListHeader)));
 			dataRegionSize -= alignedSize;
 
 			return Next();
@@ -218,7 +218,7 @@ namespace InsanityFramework
 			if(!Next() || Next()->inUse)
 				return false;
 
-			dataRegionSize += Next()->dataRegionSize;
+			dataRegionSize += sizeof(FreeListHeader) + Next()->dataRegionSize;
 			std::destroy_at(Next()->RemoveSelf());
 			return true;
 		}
@@ -259,7 +259,7 @@ namespace InsanityFramework
 		void* Allocate(std::size_t size)
 		{
 			FreeListHeader* currentHeader = First();
-			while(currentHeader && currentHeader->inUse && currentHeader->Size() >= size)
+			while(currentHeader && (currentHeader->inUse || currentHeader->Size() < size))
 			{
 				currentHeader = currentHeader->Next();
 			}
@@ -267,8 +267,9 @@ namespace InsanityFramework
 			if(!currentHeader)
 				return nullptr;
 
-			if(currentHeader->Size() > size)
-				currentHeader = currentHeader->Split(size);
+			//Too small to split off a new block means the whole block is handed out
+			if(FreeListHeader* split = currentHeader->Split(size))
+				currentHeader = split;
 
 			currentHeader->inUse = true;
 			return currentHeader->DataRegion();
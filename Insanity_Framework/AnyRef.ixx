@@ -7,6 +7,7 @@ module;
 #include <memory>
 
 export module InsanityFramework.AnyRef;
+import InsanityFramework.TypeID;
 
 namespace InsanityFramework
 {
@@ -16,14 +17,14 @@ namespace InsanityFramework
 		template<bool OtherConst>
 		friend class AnyRefT;
 	private:
-		const std::type_info* type;
+		TypeID type;
 		std::conditional_t<isConst, const void*, void*> ptr;
 
 	public:
 		template<class Ty>
 			requires (!std::same_as<AnyRefT, Ty>)
 		AnyRefT(Ty& obj) :
-			type{ &typeid(Ty) },
+			type{ GetTypeID<Ty>() },
 			ptr{ &obj }
 		{
 
@@ -44,7 +45,7 @@ namespace InsanityFramework
 		}
 
 		AnyRefT(AnyRefT&& other) noexcept :
-			type{ std::exchange(other.type, nullptr) },
+			type{ std::exchange(other.type, invalidTypeID) },
 			ptr{ std::exchange(other.ptr, nullptr) }
 		{
 
@@ -69,7 +70,7 @@ namespace InsanityFramework
 		template<class Ty>
 		Ty& As()
 		{
-			if(*type != typeid(Ty))
+			if(type != GetTypeID<Ty>())
 				throw std::exception{};
 
 			return *static_cast<Ty*>(ptr);
@@ -78,7 +79,7 @@ namespace InsanityFramework
 		template<class Ty>
 		const Ty& As() const
 		{
-			if(*type != typeid(Ty))
+			if(type != GetTypeID<Ty>())
 				throw std::exception{};
 
 			return *static_cast<const Ty*>(ptr);
@@ -163,7 +164,7 @@ namespace InsanityFramework
 		template<bool OtherConst>
 		friend class AnyPtrT;
 	private:
-		const std::type_info* type = nullptr;
+		TypeID type = invalidTypeID;
 		std::conditional_t<isConst, const void*, void*> ptr = nullptr;
 
 	public:
@@ -173,7 +174,7 @@ namespace InsanityFramework
 		template<class Ty>
 			requires (!std::same_as<AnyPtrT, Ty>)
 		AnyPtrT(Ty* obj) :
-			type{ &typeid(Ty) },
+			type{ GetTypeID<Ty>() },
 			ptr{ obj }
 		{
 
@@ -194,7 +195,7 @@ namespace InsanityFramework
 		}
 
 		AnyPtrT(AnyPtrT&& other) noexcept :
-			type{ std::exchange(other.type, nullptr) },
+			type{ std::exchange(other.type, invalidTypeID) },
 			ptr{ std::exchange(other.ptr, nullptr) }
 		{
 
@@ -203,7 +204,7 @@ namespace InsanityFramework
 		AnyPtrT& operator=(const AnyPtrT& ptr) = default;
 		AnyPtrT& operator=(AnyPtrT&& ptr) noexcept
 		{
-			type = std::exchange(ptr.type, nullptr);
+			type = std::exchange(ptr.type, invalidTypeID);
 			ptr = std::exchange(ptr.ptr, nullptr);
 			return *this;
 		}
@@ -217,7 +218,7 @@ namespace InsanityFramework
 
 		AnyPtrT& operator=(AnyPtrT<false>&& ptr) noexcept requires (isConst)
 		{
-			type = std::exchange(ptr.type, nullptr);
+			type = std::exchange(ptr.type, invalidTypeID);
 			ptr = std::exchange(ptr.ptr, nullptr);
 			return *this;
 		}
@@ -225,7 +226,7 @@ namespace InsanityFramework
 		template<class Ty>
 		Ty* operator=(const Ty* obj)
 		{
-			type = &typeid(Ty);
+			type = GetTypeID<Ty>();
 			ptr = obj;
 			return obj;
 		}
@@ -236,7 +237,7 @@ namespace InsanityFramework
 			if(!ptr)
 				return nullptr;
 
-			if(*type != typeid(Ty))
+			if(type != GetTypeID<Ty>())
 				throw std::exception{};
 
 			return static_cast<Ty*>(ptr);
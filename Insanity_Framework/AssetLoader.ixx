@@ -1,38 +1,116 @@
 module;
 
-#include <typeindex>
+#include <cstdint>
+#include <cassert>
 #include <filesystem>
 #include <functional>
 #include <any>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <list>
 #include <unordered_map>
+#include <vector>
+#include <concepts>
+#include <exception>
 
 export module InsanityFramework.AssetLoader;
+import InsanityFramework.TypeID;
 
 namespace InsanityFramework
 {
 	namespace AssetLoader
 	{
-		void InternalRegister(std::type_index type, std::function<std::any(std::filesystem::path)> loaderFunction);
-		void InternalUnregister(std::type_index type);
-		std::any InternalLoad(std::type_index type, std::filesystem::path path);
+		void InternalRegister(TypeID type, std::function<std::any(std::filesystem::path)> loaderFunction);
+		void InternalUnregister(TypeID type);
+		std::any InternalLoad(TypeID type, std::filesystem::path path);
 
 		export template<class Ty, class Func>
 			requires std::is_invocable_r_v<Ty, Func, std::filesystem::path>
 		void Register(Func&& loaderFunction)
 		{
-			InternalRegister(typeid(Ty), std::forward<Func>(loaderFunction));
+			InternalRegister(GetTypeID<Ty>(), std::forward<Func>(loaderFunction));
 		}
 
 		export template<class Ty>
 		void Unregister()
 		{
-			InternalUnregister(typeid(Ty));
+			InternalUnregister(GetTypeID<Ty>());
 		}
 
 		export template<class Ty>
 		Ty Load(std::filesystem::path path)
 		{
-			return std::any_cast<Ty>(InternalLoad(typeid(Ty), path));
+			return std::any_cast<Ty>(InternalLoad(GetTypeID<Ty>(), path));
+		}
+	}
+
+	//Assets with a MemoryUsage member are budgeted by it, others by their size
+	export template<class Ty>
+	concept HasMemoryUsage = requires(const Ty& asset) { { asset.MemoryUsage() } -> std::convertible_to<std::size_t>; };
+
+	export struct AssetCacheStats
+	{
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+		std::size_t evictions = 0;
+		//Every cached asset, and the part of it no handle refers to
+		std::size_t residentBytes = 0;
+		std::size_t unreferencedBytes = 0;
+	};
+
+	//Loads assets through the AssetLoader functions once per type and canonical path and hands out shared handles.
+	//Assets stay cached after their last handle is gone, the least recently released ones are evicted
+	//while the cache holds more than its budget. Referenced assets are never evicted, they count against the budget though.
+	//Thread safe, concurrent loads of the same asset wait for the first one instead of loading it again
+	export class AssetCache
+	{
+		struct State;
+		std::shared_ptr<State> state;
+
+	public:
+		AssetCache(std::size_t budget);
+		~AssetCache();
+
+		AssetCache(const AssetCache&) = delete;
+		AssetCache& operator=(const AssetCache&) = delete;
+
+	public:
+		//Rethrows the loader's exception, also to requests which waited on the failed load
+		template<class Ty>
+		std::shared_ptr<const Ty> Load(const std::filesystem::path& path)
+		{
+			std::shared_ptr<const std::any> asset = Acquire(GetTypeID<Ty>(), path, [](const std::any& asset) -> std::size_t
+			{
+				if constexpr(HasMemoryUsage<Ty>)
+					return std::any_cast<const Ty&>(asset).MemoryUsage();
+				else
+					return sizeof(Ty);
+			});
+			return { asset, std::any_cast<Ty>(asset.get()) };
+		}
+
+		void SetBudget(std::size_t budget);
+		std::size_t GetBudget() const;
+
+		//Evicts every asset without handles
+		void Clear();
+
+		AssetCacheStats GetStats() const;
+
+	private:
+		std::shared_ptr<const std::any> Acquire(TypeID type, const std::filesystem::path& path, std::size_t(*size)(const std::any&));
+	};
+
+	namespace AssetLoader
+	{
+		//Cache shared by the whole program, 256 MiB unless changed
+		export AssetCache& DefaultCache();
+
+		export template<class Ty>
+		std::shared_ptr<const Ty> LoadShared(const std::filesystem::path& path)
+		{
+			return DefaultCache().Load<Ty>(path);
 		}
 	}
 }
@@ -43,19 +121,229 @@ namespace InsanityFramework
 {
 	namespace AssetLoader
 	{
-		std::unordered_map<std::type_index, std::function<std::any(std::filesystem::path)>> loaderFunctions;
+		TypeMap<std::function<std::any(std::filesystem::path)>> loaderFunctions;
 
-		void InternalRegister(std::type_index type, std::function<std::any(std::filesystem::path)> loaderFunction)
+		void InternalRegister(TypeID type, std::function<std::any(std::filesystem::path)> loaderFunction)
+		{
+			loaderFunctions.TryEmplace(type, loaderFunction);
+		}
+		void InternalUnregister(TypeID type)
 		{
-			loaderFunctions.insert({ type, loaderFunction });
+			loaderFunctions.Erase(type);
 		}
-		void InternalUnregister(std::type_index type)
+		std::any InternalLoad(TypeID type, std::filesystem::path path)
 		{
-			loaderFunctions.erase(type);
+			return loaderFunctions.At(type)(path);
 		}
-		std::any InternalLoad(std::type_index type, std::filesystem::path path)
+
+		AssetCache& DefaultCache()
 		{
-			return loaderFunctions.at(type)(path);
+			static AssetCache cache{ 256 * 1024 * 1024 };
+			return cache;
 		}
 	}
-}
\ No newline at end of file
+
+	//Shared with the leases so handles can outlive the cache
+	struct AssetCache::State
+	{
+		struct Lease;
+
+		struct Entry
+		{
+			TypeID type;
+			std::filesystem::path::string_type key;
+			//Set once loaded, waiters block on loaded until then
+			std::shared_ptr<const std::any> value;
+			std::shared_future<void> loaded;
+			std::size_t bytes = 0;
+
+			//Every handle of the asset shares one lease, a new one is made when the asset is used again
+			std::weak_ptr<Lease> lease;
+			std::uint64_t leaseID = 0;
+
+			bool released = false;
+			bool evicted = false;
+			std::list<std::shared_ptr<Entry>>::iterator releasedIt;
+		};
+
+		struct Lease
+		{
+			std::shared_ptr<State> state;
+			std::shared_ptr<Entry> entry;
+			std::uint64_t id;
+
+			~Lease()
+			{
+				state->Release(entry, id);
+			}
+		};
+
+		mutable std::mutex mutex;
+		TypeMap<std::unordered_map<std::filesystem::path::string_type, std::shared_ptr<Entry>>> entries;
+		//Assets without handles, most recently released first
+		std::list<std::shared_ptr<Entry>> released;
+		std::size_t budget;
+		AssetCacheStats stats;
+
+		State(std::size_t budget) :
+			budget{ budget }
+		{
+
+		}
+
+		//Needs the lock, shared_from_this isn't available so the caller passes the owning pointer
+		std::shared_ptr<const std::any> LeaseLocked(const std::shared_ptr<State>& self, const std::shared_ptr<Entry>& entry)
+		{
+			if(std::shared_ptr<Lease> lease = entry->lease.lock())
+				return { lease, entry->value.get() };
+
+			if(entry->released)
+			{
+				released.erase(entry->releasedIt);
+				entry->released = false;
+				stats.unreferencedBytes -= entry->bytes;
+			}
+
+			auto lease = std::make_shared<Lease>(self, entry, ++entry->leaseID);
+			entry->lease = lease;
+			return { lease, entry->value.get() };
+		}
+
+		void Release(const std::shared_ptr<Entry>& entry, std::uint64_t leaseID)
+		{
+			std::vector<std::shared_ptr<const std::any>> evicted;
+			{
+				std::scoped_lock lock{ mutex };
+				//Leased again before the last handle of the old lease was gone
+				if(entry->leaseID != leaseID || entry->evicted)
+					return;
+
+				released.push_front(entry);
+				entry->released = true;
+				entry->releasedIt = released.begin();
+				stats.unreferencedBytes += entry->bytes;
+				EvictLocked(budget, evicted);
+			}
+		}
+
+		//Assets are destroyed by the caller once it let go of the lock
+		void EvictLocked(std::size_t limit, std::vector<std::shared_ptr<const std::any>>& evicted)
+		{
+			while(stats.residentBytes > limit && !released.empty())
+			{
+				std::shared_ptr<Entry> entry = std::move(released.back());
+				released.pop_back();
+
+				entries[entry->type].erase(entry->key);
+				stats.residentBytes -= entry->bytes;
+				stats.unreferencedBytes -= entry->bytes;
+				stats.evictions++;
+
+				entry->released = false;
+				entry->evicted = true;
+				evicted.push_back(std::move(entry->value));
+			}
+		}
+	};
+
+	AssetCache::AssetCache(std::size_t budget) :
+		state{ std::make_shared<State>(budget) }
+	{
+
+	}
+
+	AssetCache::~AssetCache() = default;
+
+	std::shared_ptr<const std::any> AssetCache::Acquire(TypeID type, const std::filesystem::path& path, std::size_t(*size)(const std::any&))
+	{
+		auto key = std::filesystem::weakly_canonical(path).native();
+
+		//Declared before the lock so evicted assets are destroyed after it's released
+		std::vector<std::shared_ptr<const std::any>> evicted;
+		std::unique_lock lock{ state->mutex };
+		while(true)
+		{
+			auto& entries = state->entries[type];
+			auto [it, inserted] = entries.try_emplace(key);
+			if(inserted)
+			{
+				state->stats.misses++;
+				auto entry = std::make_shared<State::Entry>(type, key);
+				it->second = entry;
+
+				std::promise<void> loaded;
+				entry->loaded = loaded.get_future().share();
+				lock.unlock();
+
+				std::shared_ptr<const std::any> value;
+				std::size_t bytes = 0;
+				try
+				{
+					value = std::make_shared<const std::any>(AssetLoader::InternalLoad(type, path));
+					bytes = size(*value);
+				}
+				catch(...)
+				{
+					//Dropped so the next request tries again
+					lock.lock();
+					state->entries[type].erase(key);
+					lock.unlock();
+					loaded.set_exception(std::current_exception());
+					throw;
+				}
+
+				lock.lock();
+				entry->value = std::move(value);
+				entry->bytes = bytes;
+				state->stats.residentBytes += bytes;
+				loaded.set_value();
+				std::shared_ptr<const std::any> asset = state->LeaseLocked(state, entry);
+				state->EvictLocked(state->budget, evicted);
+				return asset;
+			}
+
+			std::shared_ptr<State::Entry> entry = it->second;
+			if(!entry->value)
+			{
+				std::shared_future<void> loaded = entry->loaded;
+				lock.unlock();
+				loaded.get();
+				lock.lock();
+
+				//Loaded, released and evicted before this thread got the lock back
+				if(entry->evicted)
+					continue;
+			}
+
+			state->stats.hits++;
+			return state->LeaseLocked(state, entry);
+		}
+	}
+
+	void AssetCache::SetBudget(std::size_t budget)
+	{
+		std::vector<std::shared_ptr<const std::any>> evicted;
+		std::scoped_lock lock{ state->mutex };
+		state->budget = budget;
+		state->EvictLocked(budget, evicted);
+	}
+
+	std::size_t AssetCache::GetBudget() const
+	{
+		std::scoped_lock lock{ state->mutex };
+		return state->budget;
+	}
+
+	void AssetCache::Clear()
+	{
+		std::vector<std::shared_ptr<const std::any>> evicted;
+		std::scoped_lock lock{ state->mutex };
+		state->EvictLocked(0, evicted);
+	}
+
+	AssetCacheStats AssetCache::GetStats() const
+	{
+		std::scoped_lock lock{ state->mutex };
+		return state->stats;
+	}
+}
@@ -0,0 +1,469 @@
+module;
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <span>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cassert>
+#include <bit>
+#include <unordered_map>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define INSANITY_BROADPHASE_SSE2 1
+#else
+#define INSANITY_BROADPHASE_SSE2 0
+#endif
+
+export module InsanityFramework.ECS.Broadphase;
+export import InsanityFramework.ECS.Scene;
+import xk.Math;
+
+namespace InsanityFramework
+{
+	export struct OverlapPair
+	{
+		GameObject* first;
+		GameObject* second;
+	};
+
+	export using BroadphaseBodyID = std::uint32_t;
+
+	//Sweep and prune broadphase over the world space AABBs of registered game objects.
+	//Bodies stay sorted along the axis with the most spread between frames, so when little moves
+	//the insertion sort is close to a single pass. Candidates along the sort axis are tested against the
+	//remaining axes 4 at a time.
+	//Every Update produces the overlaps which began, stayed and ended since the previous Update.
+	//Bodies of objects destroyed in the scene active at construction are unregistered automatically, their ids must not be used after
+	export template<std::size_t Dimensions = 2>
+		requires (Dimensions == 2 || Dimensions == 3)
+	class Broadphase : public SceneSystem, private SceneCallbacks
+	{
+		using Vector = xk::Math::Vector<float, 3>;
+
+		struct Body
+		{
+			GameObject* object = nullptr;
+			Vector halfExtents;
+			//Position in sorted, so bodies can be taken out without searching
+			std::uint32_t sortedIndex = 0;
+		};
+
+		//Bounds in sweep order, kept as one array per axis so the overlap tests can load 4 bodies at once
+		struct SortedBounds
+		{
+			std::vector<BroadphaseBodyID> ids;
+			std::array<std::vector<float>, 3> min;
+			std::array<std::vector<float>, 3> max;
+
+			std::size_t Size() const noexcept { return ids.size(); }
+
+			void Resize(std::size_t size)
+			{
+				ids.resize(size);
+				for(std::size_t axis = 0; axis < 3; axis++)
+				{
+					min[axis].resize(size);
+					max[axis].resize(size);
+				}
+			}
+
+			void Swap(std::size_t a, std::size_t b)
+			{
+				std::swap(ids[a], ids[b]);
+				for(std::size_t axis = 0; axis < 3; axis++)
+				{
+					std::swap(min[axis][a], min[axis][b]);
+					std::swap(max[axis][a], max[axis][b]);
+				}
+			}
+		};
+
+		//Rows of the sweep a job takes at a time in parallel mode
+		static constexpr std::size_t parallelBlockSize = 512;
+
+	private:
+		Scene* scene = Scene::GetActiveScene();
+		JobSystem* jobs = nullptr;
+
+		std::vector<Body> bodies;
+		std::unordered_map<const Object*, BroadphaseBodyID> bodyLookup;
+		std::vector<BroadphaseBodyID> freeIDs;
+		//Unregistered since the last Update. Their ids can still be in previousPairs, so they are only reused after it
+		std::vector<BroadphaseBodyID> removedIDs;
+		std::vector<bool> removed;
+		SortedBounds sorted;
+		std::size_t sortAxis = 0;
+
+		std::vector<std::uint64_t> previousPairs;
+		std::vector<std::uint64_t> currentPairs;
+		std::vector<std::vector<std::uint64_t>> threadPairs;
+
+		std::vector<OverlapPair> beginOverlaps;
+		std::vector<OverlapPair> stayOverlaps;
+		std::vector<OverlapPair> endOverlaps;
+
+	public:
+		Broadphase()
+		{
+			if(scene)
+				scene->AddListener(this);
+		}
+
+		//Large sweeps are split into jobs when Update is called from a participant of jobs
+		Broadphase(JobSystem& jobs) :
+			Broadphase{}
+		{
+			this->jobs = &jobs;
+		}
+
+		Broadphase(const Broadphase&) = delete;
+		Broadphase& operator=(const Broadphase&) = delete;
+
+		~Broadphase()
+		{
+			if(scene)
+				scene->RemoveListener(this);
+		}
+
+	public:
+		BroadphaseBodyID Register(GameObject* object, Vector halfExtents)
+		{
+			assert(!bodyLookup.contains(object));
+
+			const std::uint32_t sortedIndex = static_cast<std::uint32_t>(sorted.Size());
+			BroadphaseBodyID id;
+			if(freeIDs.empty())
+			{
+				id = static_cast<BroadphaseBodyID>(bodies.size());
+				bodies.push_back({ object, halfExtents, sortedIndex });
+				removed.push_back(false);
+			}
+			else
+			{
+				id = freeIDs.back();
+				freeIDs.pop_back();
+				bodies[id] = { object, halfExtents, sortedIndex };
+			}
+			bodyLookup.insert({ object, id });
+
+			//The real bounds get filled in and sorted into place on the next Update
+			sorted.ids.push_back(id);
+			for(std::size_t axis = 0; axis < 3; axis++)
+			{
+				sorted.min[axis].push_back(0);
+				sorted.max[axis].push_back(0);
+			}
+
+			return id;
+		}
+
+		//Ongoing overlaps of the body are dropped without producing an end overlap.
+		//The last sorted body takes its place, the next Update's insertion sort moves it back
+		void Unregister(BroadphaseBodyID id)
+		{
+			assert(bodies[id].object && !removed[id]);
+
+			const std::size_t index = bodies[id].sortedIndex;
+			const std::size_t last = sorted.Size() - 1;
+			if(index != last)
+			{
+				sorted.Swap(index, last);
+				bodies[sorted.ids[index]].sortedIndex = static_cast<std::uint32_t>(index);
+			}
+			sorted.Resize(last);
+
+			bodyLookup.erase(bodies[id].object);
+			bodies[id] = {};
+			removed[id] = true;
+			removedIDs.push_back(id);
+		}
+
+		void SetHalfExtents(BroadphaseBodyID id, Vector halfExtents)
+		{
+			bodies[id].halfExtents = halfExtents;
+		}
+
+		//nullptr sweeps on the calling thread
+		void SetJobSystem(JobSystem* jobSystem) noexcept
+		{
+			jobs = jobSystem;
+		}
+
+		void Update()
+		{
+			RefreshBounds();
+			SelectSortAxis();
+			SortAlongAxis();
+
+			for(std::size_t i = 0; i < sorted.Size(); i++)
+				bodies[sorted.ids[i]].sortedIndex = static_cast<std::uint32_t>(i);
+
+			currentPairs.clear();
+			if(!jobs || jobs->ThreadCount() == 1 || !jobs->IsParticipant() || sorted.Size() < parallelBlockSize * 2)
+			{
+				Sweep(0, sorted.Size(), currentPairs);
+			}
+			else
+			{
+				ParallelSweep();
+			}
+
+			std::sort(currentPairs.begin(), currentPairs.end());
+			DiffPairs();
+			std::swap(previousPairs, currentPairs);
+
+			for(BroadphaseBodyID id : removedIDs)
+				removed[id] = false;
+			freeIDs.insert(freeIDs.end(), removedIDs.begin(), removedIDs.end());
+			removedIDs.clear();
+		}
+
+		std::span<const OverlapPair> GetBeginOverlaps() const noexcept { return beginOverlaps; }
+		std::span<const OverlapPair> GetStayOverlaps() const noexcept { return stayOverlaps; }
+		std::span<const OverlapPair> GetEndOverlaps() const noexcept { return endOverlaps; }
+
+		std::size_t Size() const noexcept { return sorted.Size(); }
+
+	private:
+		void OnObjectDestroyed(Object* object) override
+		{
+			if(bodyLookup.empty())
+				return;
+
+			auto it = bodyLookup.find(object);
+			if(it != bodyLookup.end())
+				Unregister(it->second);
+		}
+
+		//The AABB of the oriented box is taken straight from the cached world matrix
+		void RefreshBounds()
+		{
+			for(std::size_t i = 0; i < sorted.Size(); i++)
+			{
+				const Body& body = bodies[sorted.ids[i]];
+				const xk::Math::Matrix<float, 4, 4>& world = body.object->GetWorldMatrix();
+
+				for(std::size_t row = 0; row < Dimensions; row++)
+				{
+					float extent = 0;
+					for(std::size_t column = 0; column < Dimensions; column++)
+					{
+						extent += std::abs(world.At(row, column)) * body.halfExtents[column];
+					}
+
+					sorted.min[row][i] = world.At(row, 3) - extent;
+					sorted.max[row][i] = world.At(row, 3) + extent;
+				}
+			}
+		}
+
+		void SelectSortAxis()
+		{
+			if(sorted.Size() < 2)
+				return;
+
+			std::size_t bestAxis = sortAxis;
+			float bestVariance = -1;
+			for(std::size_t axis = 0; axis < Dimensions; axis++)
+			{
+				double sum = 0;
+				double sumSquared = 0;
+				for(std::size_t i = 0; i < sorted.Size(); i++)
+				{
+					double center = 0.5 * (sorted.min[axis][i] + sorted.max[axis][i]);
+					sum += center;
+					sumSquared += center * center;
+				}
+
+				double mean = sum / sorted.Size();
+				float variance = static_cast<float>(sumSquared / sorted.Size() - mean * mean);
+				if(variance > bestVariance)
+				{
+					bestVariance = variance;
+					bestAxis = axis;
+				}
+			}
+
+			if(bestAxis == sortAxis)
+				return;
+
+			//The old order says nothing about the new axis, so do a full sort instead of the insertion sort
+			sortAxis = bestAxis;
+			std::vector<std::size_t> permutation(sorted.Size());
+			std::iota(permutation.begin(), permutation.end(), std::size_t{ 0 });
+			std::sort(permutation.begin(), permutation.end(), [&](std::size_t a, std::size_t b) { return sorted.min[sortAxis][a] < sorted.min[sortAxis][b]; });
+
+			SortedBounds reordered;
+			reordered.Resize(sorted.Size());
+			for(std::size_t i = 0; i < permutation.size(); i++)
+			{
+				reordered.ids[i] = sorted.ids[permutation[i]];
+				for(std::size_t axis = 0; axis < 3; axis++)
+				{
+					reordered.min[axis][i] = sorted.min[axis][permutation[i]];
+					reordered.max[axis][i] = sorted.max[axis][permutation[i]];
+				}
+			}
+			sorted = std::move(reordered);
+		}
+
+		//Bodies barely move between frames so the previous order is almost sorted
+		void SortAlongAxis()
+		{
+			const std::vector<float>& keys = sorted.min[sortAxis];
+			for(std::size_t i = 1; i < sorted.Size(); i++)
+			{
+				for(std::size_t j = i; j > 0 && keys[j - 1] > keys[j]; j--)
+				{
+					sorted.Swap(j - 1, j);
+				}
+			}
+		}
+
+		void Sweep(std::size_t begin, std::size_t end, std::vector<std::uint64_t>& output) const
+		{
+			const std::size_t count = sorted.Size();
+			const std::size_t a = sortAxis;
+			const std::size_t b = (sortAxis + 1) % Dimensions;
+			const std::size_t c = (sortAxis + 2) % Dimensions;
+
+			const float* minA = sorted.min[a].data();
+			const float* minB = sorted.min[b].data();
+			const float* maxB = sorted.max[b].data();
+			const float* minC = sorted.min[c].data();
+			const float* maxC = sorted.max[c].data();
+
+			auto emit = [&](std::size_t i, std::size_t j)
+			{
+				output.push_back(MakePair(sorted.ids[i], sorted.ids[j]));
+			};
+
+			for(std::size_t i = begin; i < end; i++)
+			{
+				const float sweepEnd = sorted.max[a][i];
+				std::size_t j = i + 1;
+				bool ended = false;
+
+#if INSANITY_BROADPHASE_SSE2
+				const __m128 sweepEnd4 = _mm_set1_ps(sweepEnd);
+				const __m128 minB4 = _mm_set1_ps(minB[i]);
+				const __m128 maxB4 = _mm_set1_ps(maxB[i]);
+				const __m128 minC4 = _mm_set1_ps(minC[i]);
+				const __m128 maxC4 = _mm_set1_ps(maxC[i]);
+
+				for(; j + 4 <= count; j += 4)
+				{
+					const __m128 inSweep = _mm_cmple_ps(_mm_loadu_ps(minA + j), sweepEnd4);
+					__m128 overlap = _mm_and_ps(inSweep, _mm_and_ps(
+						_mm_cmple_ps(_mm_loadu_ps(minB + j), maxB4),
+						_mm_cmpge_ps(_mm_loadu_ps(maxB + j), minB4)));
+
+					if constexpr(Dimensions == 3)
+					{
+						overlap = _mm_and_ps(overlap, _mm_and_ps(
+							_mm_cmple_ps(_mm_loadu_ps(minC + j), maxC4),
+							_mm_cmpge_ps(_mm_loadu_ps(maxC + j), minC4)));
+					}
+
+					for(unsigned mask = static_cast<unsigned>(_mm_movemask_ps(overlap)); mask != 0; mask &= mask - 1)
+					{
+						emit(i, j + std::countr_zero(mask));
+					}
+
+					//Sorted by min, so the first body past the sweep means every following one is too
+					if(_mm_movemask_ps(inSweep) != 0xF)
+					{
+						ended = true;
+						break;
+					}
+				}
+#endif
+
+				for(; !ended && j < count && minA[j] <= sweepEnd; j++)
+				{
+					bool overlaps = minB[j] <= maxB[i] && maxB[j] >= minB[i];
+					if constexpr(Dimensions == 3)
+						overlaps = overlaps && minC[j] <= maxC[i] && maxC[j] >= minC[i];
+
+					if(overlaps)
+						emit(i, j);
+				}
+			}
+		}
+
+		//Rows are handed out in blocks, job stealing spreads the long sweeps near dense clusters between participants.
+		//The pairs get sorted afterwards, so the result doesn't depend on the thread count
+		void ParallelSweep()
+		{
+			threadPairs.resize(jobs->ThreadCount());
+			for(std::vector<std::uint64_t>& pairs : threadPairs)
+				pairs.clear();
+
+			const std::size_t blockCount = (sorted.Size() + parallelBlockSize - 1) / parallelBlockSize;
+			jobs->ParallelFor(blockCount, [&](std::size_t firstBlock, std::size_t lastBlock)
+			{
+				std::vector<std::uint64_t>& pairs = threadPairs[jobs->CurrentParticipant()];
+				for(std::size_t block = firstBlock; block < lastBlock; block++)
+				{
+					std::size_t begin = block * parallelBlockSize;
+					Sweep(begin, (std::min)(begin + parallelBlockSize, sorted.Size()), pairs);
+				}
+			}, 1);
+
+			for(const std::vector<std::uint64_t>& pairs : threadPairs)
+			{
+				currentPairs.insert(currentPairs.end(), pairs.begin(), pairs.end());
+			}
+		}
+
+		//Both pair lists are sorted, so a single merge walk splits them into begin, stay and end
+		void DiffPairs()
+		{
+			beginOverlaps.clear();
+			stayOverlaps.clear();
+			endOverlaps.clear();
+
+			//Pairs of unregistered bodies are dropped without an end overlap
+			if(!removedIDs.empty())
+				std::erase_if(previousPairs, [&](std::uint64_t pair) { return removed[PairFirst(pair)] || removed[PairSecond(pair)]; });
+
+			auto previous = previousPairs.begin();
+			auto current = currentPairs.begin();
+			while(previous != previousPairs.end() || current != currentPairs.end())
+			{
+				if(current == currentPairs.end() || (previous != previousPairs.end() && *previous < *current))
+				{
+					endOverlaps.push_back(ToOverlap(*previous++));
+				}
+				else if(previous == previousPairs.end() || *current < *previous)
+				{
+					beginOverlaps.push_back(ToOverlap(*current++));
+				}
+				else
+				{
+					stayOverlaps.push_back(ToOverlap(*current++));
+					previous++;
+				}
+			}
+		}
+
+		OverlapPair ToOverlap(std::uint64_t pair) const
+		{
+			return { bodies[PairFirst(pair)].object, bodies[PairSecond(pair)].object };
+		}
+
+		static std::uint64_t MakePair(BroadphaseBodyID a, BroadphaseBodyID b)
+		{
+			if(a > b)
+				std::swap(a, b);
+			return (static_cast<std::uint64_t>(a) << 32) | b;
+		}
+
+		static BroadphaseBodyID PairFirst(std::uint64_t pair) { return static_cast<BroadphaseBodyID>(pair >> 32); }
+		static BroadphaseBodyID PairSecond(std::uint64_t pair) { return static_cast<BroadphaseBodyID>(pair); }
+	};
+}
@@ -0,0 +1,545 @@
+module;
+
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <vector>
+#include <array>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <concepts>
+#include <type_traits>
+#include <algorithm>
+#include <utility>
+
+export module InsanityFramework.ECS.ComponentStore;
+import InsanityFramework.Memory;
+
+namespace InsanityFramework
+{
+	//Components are plain data, they are moved between chunks with memcpy and never destroyed
+	export template<class Ty>
+	concept Component = std::same_as<Ty, std::remove_cvref_t<Ty>> && std::is_trivially_copyable_v<Ty> && std::is_trivially_destructible_v<Ty>;
+
+	export struct Entity
+	{
+		std::uint32_t index = ~0u;
+		std::uint32_t generation = 0;
+
+		bool operator==(const Entity&) const noexcept = default;
+		explicit operator bool() const noexcept { return index != ~0u; }
+	};
+
+	using ComponentTypeID = std::uint32_t;
+
+	struct ComponentInfo
+	{
+		std::size_t size;
+		std::size_t alignment;
+	};
+
+	//Dense ids for component types, shared by every store so archetype signatures are comparable
+	class ComponentRegistry
+	{
+		inline static std::mutex mutex;
+		inline static std::vector<ComponentInfo> infos;
+
+	public:
+		static ComponentTypeID Register(ComponentInfo info)
+		{
+			std::scoped_lock lock{ mutex };
+			infos.push_back(info);
+			return static_cast<ComponentTypeID>(infos.size() - 1);
+		}
+
+		static ComponentInfo Get(ComponentTypeID id)
+		{
+			std::scoped_lock lock{ mutex };
+			return infos[id];
+		}
+	};
+
+	template<Component Ty>
+	ComponentTypeID GetComponentTypeID()
+	{
+		static const ComponentTypeID id = ComponentRegistry::Register({ sizeof(Ty), alignof(Ty) });
+		return id;
+	}
+
+	export class ComponentStore;
+
+	export template<Component... Tys>
+	class ComponentQuery;
+
+	//Entities with the exact same set of components, stored in fixed size chunks with one column per component.
+	//Rows are kept packed, every chunk but the last is full
+	class Archetype
+	{
+		friend ComponentStore;
+
+		template<Component... Tys>
+		friend class ComponentQuery;
+
+	public:
+		static constexpr std::size_t chunkSize = 16 * 1024;
+		static constexpr std::size_t chunkAlignment = 64;
+
+	private:
+		class Chunk
+		{
+			std::byte* data;
+
+		public:
+			Chunk() :
+				data{ static_cast<std::byte*>(::operator new(chunkSize, std::align_val_t{ chunkAlignment })) }
+			{
+
+			}
+
+			Chunk(const Chunk&) = delete;
+			Chunk& operator=(const Chunk&) = delete;
+
+			~Chunk()
+			{
+				::operator delete(data, std::align_val_t{ chunkAlignment });
+			}
+
+			std::byte* Data() const noexcept { return data; }
+		};
+
+		std::vector<ComponentTypeID> types;
+		std::vector<std::size_t> sizes;
+		std::vector<std::size_t> offsets;
+		std::uint32_t capacity = 0;
+		std::uint32_t size = 0;
+		std::vector<std::unique_ptr<Chunk>> chunks;
+
+		std::unordered_map<ComponentTypeID, Archetype*> addEdges;
+		std::unordered_map<ComponentTypeID, Archetype*> removeEdges;
+
+	public:
+		Archetype(std::vector<ComponentTypeID> signature) :
+			types{ std::move(signature) }
+		{
+			std::size_t rowSize = sizeof(Entity);
+			std::size_t padding = 0;
+			for(ComponentTypeID type : types)
+			{
+				ComponentInfo info = ComponentRegistry::Get(type);
+				sizes.push_back(info.size);
+				rowSize += info.size;
+				padding += info.alignment;
+			}
+
+			capacity = static_cast<std::uint32_t>((chunkSize - padding) / rowSize);
+			assert(capacity > 0);
+
+			//The entity column sits at the start of the chunk, components follow it
+			std::size_t offset = capacity * sizeof(Entity);
+			for(std::size_t i = 0; i < types.size(); i++)
+			{
+				offset = AlignCeilPow2(offset, ComponentRegistry::Get(types[i]).alignment);
+				offsets.push_back(offset);
+				offset += capacity * sizes[i];
+			}
+			assert(offset <= chunkSize);
+		}
+
+	public:
+		std::uint32_t AddRow(Entity entity)
+		{
+			if(size == chunks.size() * capacity)
+				chunks.push_back(std::make_unique<Chunk>());
+
+			std::uint32_t row = size++;
+			EntityAt(row) = entity;
+			return row;
+		}
+
+		//Moves the last row into the removed one, returns the entity that now lives at row
+		Entity RemoveRow(std::uint32_t row)
+		{
+			assert(row < size);
+			std::uint32_t last = --size;
+			Entity moved{};
+			if(row != last)
+			{
+				EntityAt(row) = EntityAt(last);
+				for(std::size_t column = 0; column < types.size(); column++)
+				{
+					std::memcpy(ComponentAt(column, row), ComponentAt(column, last), sizes[column]);
+				}
+				moved = EntityAt(row);
+			}
+
+			//Keep a spare chunk around so entities moving back and forth don't thrash the allocator
+			if(chunks.size() * capacity - size >= 2 * capacity)
+				chunks.pop_back();
+
+			return moved;
+		}
+
+		int ColumnOf(ComponentTypeID type) const
+		{
+			auto it = std::lower_bound(types.begin(), types.end(), type);
+			return it != types.end() && *it == type ? static_cast<int>(it - types.begin()) : -1;
+		}
+
+		Entity& EntityAt(std::uint32_t row)
+		{
+			return reinterpret_cast<Entity*>(chunks[row / capacity]->Data())[row % capacity];
+		}
+
+		void* ComponentAt(std::size_t column, std::uint32_t row)
+		{
+			return chunks[row / capacity]->Data() + offsets[column] + (row % capacity) * sizes[column];
+		}
+
+		std::uint32_t ChunkCount() const noexcept { return static_cast<std::uint32_t>(chunks.size()); }
+
+		std::uint32_t RowsInChunk(std::uint32_t chunk) const noexcept
+		{
+			return (std::min)(capacity, size - chunk * capacity);
+		}
+
+		template<Component Ty>
+		Ty* Column(std::uint32_t chunk, std::size_t column) const
+		{
+			return std::launder(reinterpret_cast<Ty*>(chunks[chunk]->Data() + offsets[column]));
+		}
+
+		const Entity* Entities(std::uint32_t chunk) const
+		{
+			return std::launder(reinterpret_cast<const Entity*>(chunks[chunk]->Data()));
+		}
+	};
+
+	//Data oriented storage for plain data components, grouped into archetypes by component set
+	export class ComponentStore
+	{
+		template<Component... Tys>
+		friend class ComponentQuery;
+
+		struct EntityRecord
+		{
+			Archetype* archetype = nullptr;
+			std::uint32_t row = 0;
+			std::uint32_t generation = 0;
+		};
+
+	private:
+		std::map<std::vector<ComponentTypeID>, std::unique_ptr<Archetype>> archetypes;
+		std::vector<Archetype*> archetypeList;
+		std::vector<EntityRecord> records;
+		std::vector<std::uint32_t> freeIndices;
+		std::size_t entityCount = 0;
+
+	public:
+		ComponentStore() = default;
+		ComponentStore(const ComponentStore&) = delete;
+		ComponentStore& operator=(const ComponentStore&) = delete;
+
+	public:
+		template<Component... Tys>
+		Entity NewEntity(const Tys&... components)
+		{
+			std::vector<ComponentTypeID> signature{ GetComponentTypeID<Tys>()... };
+			std::sort(signature.begin(), signature.end());
+			assert(std::adjacent_find(signature.begin(), signature.end()) == signature.end());
+
+			Archetype* archetype = GetArchetype(std::move(signature));
+
+			Entity entity = AllocateEntity();
+			EntityRecord& record = records[entity.index];
+			record.archetype = archetype;
+			record.row = archetype->AddRow(entity);
+			(std::memcpy(archetype->ComponentAt(archetype->ColumnOf(GetComponentTypeID<Tys>()), record.row), &components, sizeof(Tys)), ...);
+
+			return entity;
+		}
+
+		void DeleteEntity(Entity entity)
+		{
+			assert(IsAlive(entity));
+			EntityRecord& record = records[entity.index];
+			Entity moved = record.archetype->RemoveRow(record.row);
+			if(moved)
+				records[moved.index].row = record.row;
+
+			record.archetype = nullptr;
+			record.generation++;
+			freeIndices.push_back(entity.index);
+			entityCount--;
+		}
+
+		bool IsAlive(Entity entity) const noexcept
+		{
+			return entity.index < records.size() && records[entity.index].generation == entity.generation && records[entity.index].archetype;
+		}
+
+		template<Component Ty>
+		bool Has(Entity entity) const
+		{
+			assert(IsAlive(entity));
+			return records[entity.index].archetype->ColumnOf(GetComponentTypeID<Ty>()) >= 0;
+		}
+
+		//Pointers are invalidated by any structural change to the store
+		template<Component Ty>
+		Ty* Get(Entity entity)
+		{
+			assert(IsAlive(entity));
+			const EntityRecord& record = records[entity.index];
+			int column = record.archetype->ColumnOf(GetComponentTypeID<Ty>());
+			return column >= 0 ? std::launder(static_cast<Ty*>(record.archetype->ComponentAt(column, record.row))) : nullptr;
+		}
+
+		//Moves the entity to the archetype with the extra component, or overwrites it if already present
+		template<Component Ty>
+		Ty& AddComponent(Entity entity, const Ty& component = {})
+		{
+			assert(IsAlive(entity));
+			const ComponentTypeID type = GetComponentTypeID<Ty>();
+			EntityRecord& record = records[entity.index];
+			if(record.archetype->ColumnOf(type) < 0)
+			{
+				Archetype*& target = record.archetype->addEdges[type];
+				if(!target)
+				{
+					std::vector<ComponentTypeID> signature = record.archetype->types;
+					signature.insert(std::lower_bound(signature.begin(), signature.end(), type), type);
+					target = GetArchetype(std::move(signature));
+				}
+				MoveEntity(entity, target);
+			}
+
+			Ty* output = Get<Ty>(entity);
+			std::memcpy(output, &component, sizeof(Ty));
+			return *output;
+		}
+
+		template<Component Ty>
+		void RemoveComponent(Entity entity)
+		{
+			assert(IsAlive(entity));
+			const ComponentTypeID type = GetComponentTypeID<Ty>();
+			EntityRecord& record = records[entity.index];
+			if(record.archetype->ColumnOf(type) < 0)
+				return;
+
+			Archetype*& target = record.archetype->removeEdges[type];
+			if(!target)
+			{
+				std::vector<ComponentTypeID> signature = record.archetype->types;
+				std::erase(signature, type);
+				target = GetArchetype(std::move(signature));
+			}
+			MoveEntity(entity, target);
+		}
+
+		template<Component... Tys>
+		ComponentQuery<Tys...> Query()
+		{
+			return { *this };
+		}
+
+		std::size_t EntityCount() const noexcept { return entityCount; }
+		std::size_t ArchetypeCount() const noexcept { return archetypeList.size(); }
+
+	private:
+		Archetype* GetArchetype(std::vector<ComponentTypeID> signature)
+		{
+			auto it = archetypes.find(signature);
+			if(it != archetypes.end())
+				return it->second.get();
+
+			auto archetype = std::make_unique<Archetype>(signature);
+			Archetype* output = archetype.get();
+			archetypes.insert({ std::move(signature), std::move(archetype) });
+			archetypeList.push_back(output);
+			return output;
+		}
+
+		Entity AllocateEntity()
+		{
+			entityCount++;
+			if(!freeIndices.empty())
+			{
+				std::uint32_t index = freeIndices.back();
+				freeIndices.pop_back();
+				return { index, records[index].generation };
+			}
+
+			records.push_back({});
+			return { static_cast<std::uint32_t>(records.size() - 1), 0 };
+		}
+
+		void MoveEntity(Entity entity, Archetype* target)
+		{
+			EntityRecord& record = records[entity.index];
+			Archetype* source = record.archetype;
+
+			std::uint32_t row = target->AddRow(entity);
+			for(std::size_t column = 0; column < source->types.size(); column++)
+			{
+				int targetColumn = target->ColumnOf(source->types[column]);
+				if(targetColumn >= 0)
+					std::memcpy(target->ComponentAt(targetColumn, row), source->ComponentAt(column, record.row), source->sizes[column]);
+			}
+
+			Entity moved = source->RemoveRow(record.row);
+			if(moved)
+				records[moved.index].row = record.row;
+
+			record.archetype = target;
+			record.row = row;
+		}
+	};
+
+	//Iterates every chunk whose archetype has all of Tys. Matching archetypes are cached,
+	//keeping a query around only checks archetypes created since the last iteration
+	export template<Component... Tys>
+	class ComponentQuery
+	{
+		struct Match
+		{
+			Archetype* archetype;
+			std::array<std::size_t, sizeof...(Tys)> columns;
+		};
+
+		ComponentStore* store;
+		std::vector<Match> matches;
+		std::size_t checkedArchetypes = 0;
+
+	public:
+		ComponentQuery(ComponentStore& store) :
+			store{ &store }
+		{
+
+		}
+
+	public:
+		//func(std::span<const Entity>, std::span<Tys>...) per chunk
+		template<class Func>
+		void ForEachChunk(Func&& func)
+		{
+			Refresh();
+			for(const Match& match : matches)
+			{
+				for(std::uint32_t chunk = 0; chunk < match.archetype->ChunkCount(); chunk++)
+				{
+					std::uint32_t count = match.archetype->RowsInChunk(chunk);
+					if(count == 0)
+						continue;
+
+					ForChunk(func, match, chunk, count, std::index_sequence_for<Tys...>{});
+				}
+			}
+		}
+
+		//func(Tys&...) or func(Entity, Tys&...) per entity
+		template<class Func>
+		void ForEach(Func&& func)
+		{
+			ForEachChunk([&](std::span<const Entity> entities, std::span<Tys>... columns)
+			{
+				for(std::size_t i = 0; i < entities.size(); i++)
+				{
+					if constexpr(std::invocable<Func&, Entity, Tys&...>)
+						func(entities[i], columns[i]...);
+					else
+						func(columns[i]...);
+				}
+			});
+		}
+
+		std::size_t Count()
+		{
+			Refresh();
+			std::size_t count = 0;
+			for(const Match& match : matches)
+				count += match.archetype->size;
+			return count;
+		}
+
+	private:
+		void Refresh()
+		{
+			for(; checkedArchetypes < store->archetypeList.size(); checkedArchetypes++)
+			{
+				Archetype* archetype = store->archetypeList[checkedArchetypes];
+				std::array<int, sizeof...(Tys)> columns{ archetype->ColumnOf(GetComponentTypeID<Tys>())... };
+				if(std::any_of(columns.begin(), columns.end(), [](int column) { return column < 0; }))
+					continue;
+
+				Match match{ archetype };
+				std::copy(columns.begin(), columns.end(), match.columns.begin());
+				matches.push_back(match);
+			}
+		}
+
+		template<class Func, std::size_t... Indices>
+		static void ForChunk(Func& func, const Match& match, std::uint32_t chunk, std::uint32_t count, std::index_sequence<Indices...>)
+		{
+			func(std::span<const Entity>{ match.archetype->Entities(chunk), count },
+				std::span<Tys>{ match.archetype->template Column<Tys>(chunk, match.columns[Indices]), count }...);
+		}
+	};
+
+	//Owns an entity and deletes it from its store when destroyed, meant to be held by a GameObject
+	export class UniqueEntity
+	{
+		ComponentStore* store = nullptr;
+		Entity entity;
+
+	public:
+		UniqueEntity() = default;
+		UniqueEntity(ComponentStore& store, Entity entity) :
+			store{ &store },
+			entity{ entity }
+		{
+
+		}
+
+		UniqueEntity(const UniqueEntity&) = delete;
+		UniqueEntity(UniqueEntity&& other) noexcept :
+			store{ std::exchange(other.store, nullptr) },
+			entity{ std::exchange(other.entity, {}) }
+		{
+
+		}
+
+		UniqueEntity& operator=(const UniqueEntity&) = delete;
+		UniqueEntity& operator=(UniqueEntity&& other) noexcept
+		{
+			UniqueEntity temp{ std::move(other) };
+			std::swap(store, temp.store);
+			std::swap(entity, temp.entity);
+			return *this;
+		}
+
+		~UniqueEntity()
+		{
+			if(store)
+				store->DeleteEntity(entity);
+		}
+
+	public:
+		Entity Get() const noexcept { return entity; }
+
+		template<Component Ty>
+		Ty* Get() const { return store->Get<Ty>(entity); }
+
+		template<Component Ty>
+		Ty& AddComponent(const Ty& component = {}) const { return store->AddComponent(entity, component); }
+
+		template<Component Ty>
+		void RemoveComponent() const { store->RemoveComponent<Ty>(entity); }
+
+		explicit operator bool() const noexcept { return store != nullptr; }
+	};
+}
@@ -4,6 +4,7 @@ module;
 #include <memory>
 #include <concepts>
 #include <cassert>
+#include <vector>
 
 export module InsanityFramework.ECS.Scene:Object;
 import InsanityFramework.Memory;
@@ -14,16 +15,27 @@ namespace InsanityFramework
 {
 	export class Object;
 	export class ObjectAllocator;
+	export class Scene;
+	export class SceneSnapshots;
 
 	export template<std::derived_from<InsanityFramework::Object> Ty>
 	class UniqueObject;
 
+	export template<std::derived_from<InsanityFramework::Object> Ty>
+	class WeakObject;
+
+	struct ObjectBucket;
+
 	export class Object
 	{
 		friend ObjectAllocator;
+		friend Scene;
 
 		template<std::derived_from<InsanityFramework::Object> Ty>
 		friend class UniqueObject;
+
+		template<std::derived_from<InsanityFramework::Object> Ty>
+		friend class WeakObject;
 	public:
 		struct Key
 		{
@@ -45,37 +57,67 @@ namespace InsanityFramework
 
 	private:
 		bool isRoot = true;
+		//Set per type or per delete, the destructor then runs on the background reclaimer, see Scene::DeleteObjectInBackground
+		bool reclaimInBackground = false;
+		//Where the owning scene keeps this object so it can be unregistered with a swap and pop
+		std::uint32_t bucketSlot = 0;
+		//The object's entry in its scene's handle table, read by WeakObject without going through the scene
+		std::uint32_t handleSlot = 0;
+		std::uint32_t handleGeneration = 0;
+		ObjectBucket* bucket = nullptr;
 
 	public:
 		bool IsRoot() const noexcept { return isRoot; }
 	};
 
+	//Entry of a scene's handle table, see WeakObject
+	struct ObjectHandleSlot
+	{
+		Object* object = nullptr;
+		std::uint32_t generation = 0;
+	};
+
 	export class ObjectAllocator
 	{
 		friend class Object;
+		friend SceneSnapshots;
 
 		static constexpr std::size_t pageSize = AlignNextPow2<size_t>(8'000'000);
 		class Page : public IntrusiveForwardListNode<Page>
 		{
 			FreeListAllocator allocator;
+			//Never changes, so any thread can find an object's scene from its address
+			Scene* scene;
+			bool writeWatched;
 
 		public:
-			void* operator new(size_t size)
+			void* operator new(size_t size, bool watched)
+			{
+				return AllocatePageMemory(watched);
+			}
+
+			void operator delete(void* ptr, bool)
 			{
-				return ::operator new(pageSize, std::align_val_t{ pageSize });
+				FreePageMemory(ptr);
 			}
 
 			void operator delete(void* ptr)
 			{
-				::operator delete(ptr, std::align_val_t{ pageSize });
+				FreePageMemory(ptr);
 			}
 
 		public:
-			Page() :
-				allocator{ { this + 1, pageSize - sizeof(Page) } }
+			Page(Scene* owner, bool watched) :
+				allocator{ { this + 1, pageSize - sizeof(Page) } },
+				scene{ owner },
+				writeWatched{ watched }
 			{
 			}
 
+			Scene* GetScene() const noexcept { return scene; }
+
+			bool IsWriteWatched() const noexcept { return writeWatched; }
+
 			void* Allocate(std::size_t size)
 			{
 				return allocator.Allocate(size);
@@ -92,14 +134,29 @@ namespace InsanityFramework
 			{
 				return std::launder(static_cast<Page*>(AlignFloorPow2(ptr, pageSize)));
 			}
+
+			//Hands the page back without walking its free list, everything in it must already be dead
+			static void Discard(Page* page)
+			{
+				Page::operator delete(page);
+			}
 		};
 
 
 	private:
-		Page* firstPage = new Page{ /*this*/ };
+		Scene* scene;
+		//Made by the first allocation so a scene's pages are watched if snapshots are attached before it has objects
+		Page* firstPage = nullptr;
+		//Last page an allocation succeeded in, full pages are only revisited once it fills up
+		Page* allocationHint = nullptr;
+		//Set by SceneSnapshots, applies to pages allocated from then on
+		bool writeWatched = false;
 
 	public:
-		ObjectAllocator() = default;
+		ObjectAllocator(Scene* scene) :
+			scene{ scene }
+		{
+		}
 
 		~ObjectAllocator()
 		{
@@ -120,6 +177,28 @@ namespace InsanityFramework
 			delete ptr;
 		}
 
+		//Frees the memory of an object whose destructor already ran, allocation is the pointer to the most derived object
+		static void FreeDestroyed(void* allocation)
+		{
+			Free(allocation);
+		}
+
+		//Releases every page in one go without per object bookkeeping, used by fast scene teardown
+		void ReleasePages()
+		{
+			while(firstPage)
+			{
+				Page::Discard(std::exchange(firstPage, firstPage->RemoveSelfAndGetNext()));
+			}
+			allocationHint = nullptr;
+		}
+
+		//The scene whose allocator made the object, a lookup in the object's page header
+		static Scene* GetScene(Object* ptr)
+		{
+			return Page::GetPageFrom(ptr)->GetScene();
+		}
+
 		bool Contains(Object* ptr) const
 		{
 			Page* page = Page::GetPageFrom(ptr);
@@ -134,8 +213,23 @@ namespace InsanityFramework
 		}
 
 	private:
+		//Write watched pages let snapshots tell which parts changed, watching slows down every write to them
+		static void* AllocatePageMemory(bool writeWatch);
+		static void FreePageMemory(void* page);
+
+		Page* NewPage() const
+		{
+			return new(writeWatched) Page{ scene, writeWatched };
+		}
+
 		void* Allocate(std::size_t size)
 		{
+			if(!firstPage)
+				allocationHint = firstPage = NewPage();
+
+			if(void* ptr = allocationHint->Allocate(size))
+				return ptr;
+
 			Page* currentPage = firstPage;
 			void* ptr = currentPage->Allocate(size);
 			while(!ptr)
@@ -145,13 +239,14 @@ namespace InsanityFramework
 
 				if(!currentPage)
 				{
-					currentPage = new Page{/* this*/ };
+					currentPage = NewPage();
 					oldPage->Append(currentPage);
 				}
 
 				ptr = currentPage->Allocate(size);
 			}
 
+			allocationHint = currentPage;
 			return ptr;
 		}
 
@@ -0,0 +1,92 @@
+module;
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <concepts>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define INSANITY_OBJECT_MASK_SSE2 1
+#else
+#define INSANITY_OBJECT_MASK_SSE2 0
+#endif
+
+export module InsanityFramework.ECS.Scene:ObjectMask;
+import :Object;
+
+namespace InsanityFramework
+{
+	//Objects start on layer 0 without tags unless their type has a static objectLayers or objectTags member
+	export constexpr std::uint64_t defaultObjectLayers = 1;
+
+	export template<class Ty>
+	concept HasObjectLayers = requires { { Ty::objectLayers } -> std::convertible_to<std::uint64_t>; };
+
+	export template<class Ty>
+	concept HasObjectTags = requires { { Ty::objectTags } -> std::convertible_to<std::uint64_t>; };
+
+	//Which objects a filtered query visits: on any of layers, with every tag of allTags and none of noTags
+	export struct ObjectFilter
+	{
+		std::uint64_t layers = ~std::uint64_t{ 0 };
+		std::uint64_t allTags = 0;
+		std::uint64_t noTags = 0;
+
+		bool Matches(std::uint64_t objectLayers, std::uint64_t objectTags) const noexcept
+		{
+			return (objectLayers & layers) != 0 && (objectTags & allTags) == allTags && (objectTags & noTags) == 0;
+		}
+	};
+
+	//Objects of one concrete type in a scene. Layer and tag masks are kept in arrays parallel to the objects
+	//so filtered queries scan packed masks instead of following every pointer
+	struct ObjectBucket
+	{
+		std::vector<Object*> objects;
+		std::vector<std::uint64_t> layers;
+		std::vector<std::uint64_t> tags;
+	};
+
+	//Bit i is set if the object at first + i passes the filter, for up to 64 objects
+	std::uint64_t MatchObjectMasks(const ObjectBucket& bucket, std::size_t first, const ObjectFilter& filter) noexcept
+	{
+		const std::size_t count = bucket.objects.size() - first < 64 ? bucket.objects.size() - first : 64;
+		const std::uint64_t* layers = bucket.layers.data() + first;
+		const std::uint64_t* tags = bucket.tags.data() + first;
+
+		std::uint64_t result = 0;
+		std::size_t i = 0;
+#if INSANITY_OBJECT_MASK_SSE2
+		//SSE2 has no 64 bit compare, lanes are equal when both of their 32 bit halves are
+		auto equal64 = [](__m128i lh, __m128i rh)
+		{
+			const __m128i equal32 = _mm_cmpeq_epi32(lh, rh);
+			return _mm_and_si128(equal32, _mm_shuffle_epi32(equal32, _MM_SHUFFLE(2, 3, 0, 1)));
+		};
+
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i layers2 = _mm_set1_epi64x(static_cast<long long>(filter.layers));
+		const __m128i allTags2 = _mm_set1_epi64x(static_cast<long long>(filter.allTags));
+		const __m128i noTags2 = _mm_set1_epi64x(static_cast<long long>(filter.noTags));
+		for(; i + 2 <= count; i += 2)
+		{
+			const __m128i objectLayers = _mm_loadu_si128(reinterpret_cast<const __m128i*>(layers + i));
+			const __m128i objectTags = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags + i));
+
+			const __m128i offLayers = equal64(_mm_and_si128(objectLayers, layers2), zero);
+			const __m128i hasAll = equal64(_mm_and_si128(objectTags, allTags2), allTags2);
+			const __m128i hasNone = equal64(_mm_and_si128(objectTags, noTags2), zero);
+			const __m128i match = _mm_andnot_si128(offLayers, _mm_and_si128(hasAll, hasNone));
+
+			result |= static_cast<std::uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(match))) << i;
+		}
+#endif
+		for(; i < count; i++)
+		{
+			if(filter.Matches(layers[i], tags[i]))
+				result |= std::uint64_t{ 1 } << i;
+		}
+		return result;
+	}
+}
@@ -0,0 +1,172 @@
+module;
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <span>
+#include <unordered_map>
+#include <utility>
+
+export module InsanityFramework.ECS.Prefab;
+import InsanityFramework.ECS.Scene;
+import InsanityFramework.ECS.SceneFile;
+
+namespace InsanityFramework
+{
+	//A GameObject subtree captured once and spawned many times. Objects are stored the same way as in scene files,
+	//so every type in the subtree must be registered in the SceneFileTypes, which must outlive the prefab
+	export class Prefab
+	{
+		struct Node
+		{
+			std::uint32_t block;
+			std::uint32_t indexInBlock;
+			Transform local;
+		};
+
+		//SceneData of every node of one type, in node order
+		struct Block
+		{
+			std::size_t type;
+			std::uint32_t count = 0;
+			std::vector<std::byte> data;
+		};
+
+		//Children of parent are childIndices[first, first + count)
+		struct Link
+		{
+			std::uint32_t parent;
+			std::uint32_t first;
+			std::uint32_t count;
+		};
+
+	private:
+		const SceneFileTypes* types;
+		//Parents come before their children, the root is first
+		std::vector<Node> nodes;
+		std::vector<Block> blocks;
+		std::vector<Link> links;
+		std::vector<std::uint32_t> childIndices;
+
+	private:
+		Prefab(const SceneFileTypes& types) :
+			types{ &types }
+		{
+
+		}
+
+	public:
+		//Captures root's subtree, root's scene must be the active scene. Children that are plain TransformNodes
+		//and objects owned through UniqueObject members are left out along with their children, their owner recreates them.
+		//The root's parent is dropped and its world transform kept
+		static Prefab Capture(GameObject& root, const SceneFileTypes& types)
+		{
+			Prefab prefab{ types };
+
+			//TransformNode isn't polymorphic, children are matched to objects through their address instead
+			std::unordered_map<const TransformNode*, GameObject*> sceneObjects;
+			for(GameObject* object : Scene::GetObjectsInScene<GameObject>(Scene::GetActiveScene()))
+				sceneObjects.insert({ object, object });
+
+			std::unordered_map<std::size_t, std::uint32_t> blockOfType;
+			std::vector<std::vector<std::uint32_t>> children;
+
+			std::vector<std::pair<GameObject*, std::uint32_t>> stack{ { &root, ~0u } };
+			while(!stack.empty())
+			{
+				auto [object, parent] = stack.back();
+				stack.pop_back();
+
+				const std::size_t type = types.IndexOf(*object);
+				auto [it, inserted] = blockOfType.insert({ type, static_cast<std::uint32_t>(prefab.blocks.size()) });
+				if(inserted)
+					prefab.blocks.push_back({ type });
+
+				Block& block = prefab.blocks[it->second];
+				const std::size_t dataSize = types.DataSize(type);
+				block.data.resize(block.data.size() + dataSize);
+				types.WriteData(type, object, block.data.data() + block.data.size() - dataSize);
+
+				const std::uint32_t index = static_cast<std::uint32_t>(prefab.nodes.size());
+				prefab.nodes.push_back({ it->second, block.count++, index == 0 ? object->WorldTransform().Get() : object->LocalTransform().Get() });
+				children.emplace_back();
+				if(parent != ~0u)
+					children[parent].push_back(index);
+
+				//Pushed in reverse so children keep their order once popped
+				std::span<TransformNode* const> objectChildren = object->GetChildren();
+				for(auto child = objectChildren.rbegin(); child != objectChildren.rend(); child++)
+				{
+					auto childObject = sceneObjects.find(*child);
+					if(childObject != sceneObjects.end() && childObject->second->IsRoot())
+						stack.push_back({ childObject->second, index });
+				}
+			}
+
+			for(std::uint32_t i = 0; i < children.size(); i++)
+			{
+				if(children[i].empty())
+					continue;
+
+				prefab.links.push_back({ i, static_cast<std::uint32_t>(prefab.childIndices.size()), static_cast<std::uint32_t>(children[i].size()) });
+				prefab.childIndices.insert(prefab.childIndices.end(), children[i].begin(), children[i].end());
+			}
+
+			return prefab;
+		}
+
+		std::size_t NodeCount() const noexcept { return nodes.size(); }
+
+		//Spawns count copies in the active scene with the root where it was captured
+		std::vector<GameObject*> Instantiate(std::size_t count) const
+		{
+			std::vector<Transform> rootTransforms(count, nodes.front().local);
+			return Instantiate(rootTransforms);
+		}
+
+		//Spawns one copy per root transform in the active scene and returns their roots.
+		//Objects are constructed one type at a time, linked without cycle checks and registered in one batch per type
+		std::vector<GameObject*> Instantiate(std::span<const Transform> rootTransforms) const
+		{
+			const std::size_t count = rootTransforms.size();
+			Scene* scene = Scene::GetActiveScene();
+			SceneLifetimeScopeLock lifetimeLock{ *scene };
+
+			std::vector<std::vector<GameObject*>> blockObjects(blocks.size());
+			for(std::size_t i = 0; i < blocks.size(); i++)
+			{
+				const Block& block = blocks[i];
+				blockObjects[i].reserve(count * block.count);
+				for(std::size_t instance = 0; instance < count; instance++)
+					types->Construct(block.type, block.data.data(), block.count, blockObjects[i]);
+			}
+
+			std::vector<GameObject*> roots;
+			std::vector<GameObject*> instanceObjects(nodes.size());
+			std::vector<TransformNode*> linked;
+			roots.reserve(count);
+			for(std::size_t instance = 0; instance < count; instance++)
+			{
+				for(std::size_t i = 0; i < nodes.size(); i++)
+				{
+					const Node& node = nodes[i];
+					GameObject* object = blockObjects[node.block][instance * blocks[node.block].count + node.indexInBlock];
+					object->LocalTransform() = i == 0 ? rootTransforms[instance] : node.local;
+					instanceObjects[i] = object;
+				}
+
+				for(const Link& link : links)
+				{
+					linked.clear();
+					for(std::uint32_t i = 0; i < link.count; i++)
+						linked.push_back(instanceObjects[childIndices[link.first + i]]);
+					TransformNode::LinkChildren(instanceObjects[link.parent], linked);
+				}
+
+				roots.push_back(instanceObjects.front());
+			}
+
+			return roots;
+		}
+	};
+}
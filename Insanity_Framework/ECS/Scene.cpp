@@ -1,3 +1,11 @@
+module;
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <cstddef>
+#include <new>
+
 module InsanityFramework.ECS.Scene;
 import InsanityFramework.ECS.SceneGlobals;
 import :Object;
@@ -9,9 +17,40 @@ namespace InsanityFramework
 		return activeScene;
 	}
 
+	Scene* Scene::ExchangeActiveScene(Scene* scene)
+	{
+		Scene* previousScene = activeScene;
+		activeScene = scene;
+		return previousScene;
+	}
+
 	Scene* Scene::GetOwner(Object* object)
 	{
-		return SceneGroup::GetScene(object).first;
+		//Read from the object's page, so no other scene or group is looked at
+		return ObjectAllocator::GetScene(object);
+	}
+
+	void* ObjectAllocator::AllocatePageMemory(bool writeWatch)
+	{
+		//VirtualAlloc only aligns to 64 KiB, reserve twice the size to find an aligned address and take just that.
+		//Another thread can grab the range in between, in which case we try again
+		while(true)
+		{
+			void* probe = VirtualAlloc(nullptr, pageSize * 2, MEM_RESERVE, PAGE_NOACCESS);
+			if(!probe)
+				throw std::bad_alloc{};
+
+			void* aligned = AlignFloorPow2(static_cast<std::byte*>(probe) + pageSize - 1, pageSize);
+			VirtualFree(probe, 0, MEM_RELEASE);
+
+			if(void* page = VirtualAlloc(aligned, pageSize, MEM_RESERVE | MEM_COMMIT | (writeWatch ? MEM_WRITE_WATCH : 0), PAGE_READWRITE))
+				return page;
+		}
+	}
+
+	void ObjectAllocator::FreePageMemory(void* page)
+	{
+		VirtualFree(page, 0, MEM_RELEASE);
 	}
 
 	void ObjectDeleter::operator()(Object* object)
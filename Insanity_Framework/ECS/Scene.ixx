@@ -4,19 +4,31 @@ module;
 #include <memory>
 #include <concepts>
 #include <cassert>
-#include <unordered_map>
 #include <vector>
 #include <typeindex>
 #include <algorithm>
 #include <span>
 #include <functional>
 #include <list>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <shared_mutex>
+#include <thread>
+#include <new>
+#include <bit>
 
 export module InsanityFramework.ECS.Scene;
 import InsanityFramework.Memory;
 import InsanityFramework.Allocator;
+import InsanityFramework.TypeID;
 export import :Object;
+export import :ObjectMask;
+export import :Snapshot;
 export import InsanityFramework.TransformationNode;
+export import InsanityFramework.ECS.ComponentStore;
+export import InsanityFramework.Jobs;
 
 namespace InsanityFramework
 {
@@ -46,20 +58,141 @@ namespace InsanityFramework
 		}
 	};
 
+	export enum class SceneTeardownMode
+	{
+		//Deletes root objects one at a time as if DeleteObject was called on each
+		Safe,
+		//Runs destructors in page order and frees pages wholesale, see Scene::FastTeardown
+		Fast,
+	};
+
+	//Types with a true static skipDestructorOnTeardown member aren't destroyed by a fast teardown,
+	//only mark types whose destructor has no effect worth keeping once the scene is gone
+	export template<class Ty>
+	concept SkipsDestructorOnTeardown = requires { requires Ty::skipDestructorOnTeardown; };
+
+	//Types with a true static reclaimInBackground member are destroyed on the background reclaimer when deleted.
+	//Their destructor must not touch the scene, other objects or anything the owning thread uses, such as by deleting objects
+	export template<class Ty>
+	concept ReclaimsInBackground = requires { requires Ty::reclaimInBackground; };
+
+	//Runs destructors handed off by scenes on a background thread, so despawning objects with large resources
+	//doesn't stall the frame. Queued objects are capped, a scene handing off more waits for the thread to catch up.
+	//The memory goes back to its scene, which frees it on its own thread as the allocator isn't thread safe
+	class ObjectReclaimer
+	{
+	public:
+		static constexpr std::size_t maxQueuedObjects = 16 * 1024;
+
+		struct Work
+		{
+			Scene* scene;
+			Object* object;
+			//Pointer to the most derived object, taken before the destructor runs
+			void* allocation;
+		};
+
+	private:
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable space;
+		std::vector<Work> queue;
+		bool stopping = false;
+		std::jthread worker{ [this] { Run(); } };
+
+	public:
+		ObjectReclaimer() = default;
+		ObjectReclaimer(const ObjectReclaimer&) = delete;
+		ObjectReclaimer& operator=(const ObjectReclaimer&) = delete;
+
+		//Drains the queue before the thread exits
+		~ObjectReclaimer()
+		{
+			{
+				std::scoped_lock lock{ mutex };
+				stopping = true;
+			}
+			wake.notify_one();
+		}
+
+	public:
+		static ObjectReclaimer& Default()
+		{
+			static ObjectReclaimer reclaimer;
+			return reclaimer;
+		}
+
+		void Submit(std::span<const Work> work)
+		{
+			for(std::size_t submitted = 0; submitted < work.size();)
+			{
+				std::unique_lock lock{ mutex };
+				space.wait(lock, [&] { return queue.size() < maxQueuedObjects; });
+
+				const std::size_t count = (std::min)(work.size() - submitted, maxQueuedObjects - queue.size());
+				queue.insert(queue.end(), work.begin() + submitted, work.begin() + submitted + count);
+				submitted += count;
+
+				lock.unlock();
+				wake.notify_one();
+			}
+		}
+
+	private:
+		void Run();
+	};
+
 	export class SceneSystem
 	{
 	public:
 		virtual ~SceneSystem() = default;
 	};
 
+	export template<std::derived_from<GameObject> Ty>
+	class ObjectPool;
+
+	//Takes objects back from the scene instead of them being deleted, see ObjectPool
+	class ObjectRecycler
+	{
+		friend class Scene;
+
+	protected:
+		virtual ~ObjectRecycler() = default;
+
+		//The object has left the scene, its handle is dead
+		virtual void Recycle(Object* object) = 0;
+		//The scene is being destroyed, objects kept for reuse must be deleted now
+		virtual void DeleteKept() = 0;
+	};
+
 	export struct SceneCallbacks
 	{
 		virtual void OnObjectCreated(Object* object) {}
 		virtual void OnObjectDestroyed(Object* object) {}
+
+		//Objects registered or destroyed together by FlushLifetimes, all of the same type,
+		//or every object of a scene at once on a fast teardown
+		virtual void OnObjectsCreated(std::span<Object* const> objects)
+		{
+			for(Object* object : objects)
+				OnObjectCreated(object);
+		}
+
+		virtual void OnObjectsDestroyed(std::span<Object* const> objects)
+		{
+			for(Object* object : objects)
+				OnObjectDestroyed(object);
+		}
+
+		//The scene's objects were rolled back to a snapshot in place, without create or destroy callbacks.
+		//Anything caching object pointers or object state has to be rebuilt from the scene
+		virtual void OnSceneRestored(Scene* scene) {}
 	};
 	export SceneCallbacks defaultSceneCallbacks;
 
 	export class SceneGroup;
+	export class ActiveSceneScope;
+	struct ParallelSceneIteration;
 
 	template<class Ty>
 	class ExactObjectIterator
@@ -191,6 +324,13 @@ namespace InsanityFramework
 		using reference = Ty&;
 	};
 
+	//Buckets whose concrete type converts to a queried type, along with the pointer adjustment from Object*
+	struct SubtypeMatch
+	{
+		const ObjectBucket* bucket;
+		std::ptrdiff_t offset;
+	};
+
 	template<class Ty>
 	class ObjectIterator
 	{
@@ -200,8 +340,10 @@ namespace InsanityFramework
 		using pointer = Ty*;
 		using reference = Ty&;
 
-		std::unordered_map<std::type_index, std::vector<Object*>>::const_iterator currentMapIt{};
-		std::unordered_map<std::type_index, std::vector<Object*>>::const_iterator endMapIt{};
+		//Held so a query updating the cached list while this iterates doesn't invalidate it
+		std::shared_ptr<const std::vector<SubtypeMatch>> matches;
+		std::vector<SubtypeMatch>::const_iterator currentMatchIt{};
+		std::vector<SubtypeMatch>::const_iterator endMatchIt{};
 		std::vector<Object*>::const_iterator currentIt{};
 		std::vector<Object*>::const_iterator endIt{};
 		std::ptrdiff_t offset{};
@@ -225,19 +367,8 @@ namespace InsanityFramework
 
 			if (currentIt == endIt)
 			{
-				currentMapIt++;
-				for (; currentMapIt != endMapIt; currentMapIt++)
-				{
-					currentIt = currentMapIt->second.begin();
-					auto temp = dynamic_cast<Ty*>(*currentIt);
-					if (!temp)
-						continue;
-
-					offset = OffsetOf(*currentIt, temp);
-					endIt = currentMapIt->second.end();
-
-					break;
-				}
+				currentMatchIt++;
+				SkipEmptyMatches();
 			}
 			return *this;
 		}
@@ -249,7 +380,22 @@ namespace InsanityFramework
 		}
 
 		bool operator==(const ObjectSentinal<Ty>& right) const noexcept {
-			return currentMapIt == endMapIt;
+			return currentMatchIt == endMatchIt;
+		}
+
+	private:
+		void SkipEmptyMatches() noexcept
+		{
+			for (; currentMatchIt != endMatchIt; currentMatchIt++)
+			{
+				if (currentMatchIt->bucket->objects.empty())
+					continue;
+
+				currentIt = currentMatchIt->bucket->objects.begin();
+				endIt = currentMatchIt->bucket->objects.end();
+				offset = currentMatchIt->offset;
+				break;
+			}
 		}
 	};
 
@@ -275,6 +421,129 @@ namespace InsanityFramework
 			return { };
 		}
 	};
+
+	//Visits the objects of a list of buckets which pass a filter. Masks are matched 64 objects at a time
+	//into a bitset, objects are only touched for the set bits
+	template<class Ty>
+	class FilteredObjectIterator
+	{
+		using iterator_concept = std::forward_iterator_tag;
+		using value_type = Ty;
+		using difference_type = std::ptrdiff_t;
+		using pointer = Ty*;
+		using reference = Ty&;
+
+		const SubtypeMatch* currentMatch = nullptr;
+		const SubtypeMatch* endMatch = nullptr;
+		ObjectFilter filter;
+		//First object of the current block of 64 and its matches not visited yet
+		std::size_t block = 0;
+		std::uint64_t matches = 0;
+		std::size_t index = 0;
+
+	public:
+		FilteredObjectIterator() = default;
+		FilteredObjectIterator(const SubtypeMatch* first, const SubtypeMatch* last, const ObjectFilter& filter) :
+			currentMatch{ first },
+			endMatch{ last },
+			filter{ filter }
+		{
+			if(currentMatch != endMatch)
+				matches = MatchBlock();
+			FindMatch();
+		}
+
+	public:
+		pointer operator*() const noexcept {
+			return std::launder(static_cast<pointer>(IncrementPointer(currentMatch->bucket->objects[index], currentMatch->offset)));
+		}
+
+		pointer operator->() const noexcept {
+			return std::launder(static_cast<pointer>(IncrementPointer(currentMatch->bucket->objects[index], currentMatch->offset)));
+		}
+
+		FilteredObjectIterator& operator++() noexcept {
+			matches &= matches - 1;
+			FindMatch();
+			return *this;
+		}
+
+		FilteredObjectIterator operator++(int) noexcept {
+			FilteredObjectIterator temp = *this;
+			++*this;
+			return temp;
+		}
+
+		bool operator==(const ObjectSentinal<Ty>& right) const noexcept {
+			return currentMatch == endMatch;
+		}
+
+	private:
+		std::uint64_t MatchBlock() const noexcept
+		{
+			return block < currentMatch->bucket->objects.size() ? MatchObjectMasks(*currentMatch->bucket, block, filter) : 0;
+		}
+
+		void FindMatch() noexcept
+		{
+			while(currentMatch != endMatch)
+			{
+				if(matches != 0)
+				{
+					index = block + std::countr_zero(matches);
+					return;
+				}
+
+				block += 64;
+				if(block >= currentMatch->bucket->objects.size())
+				{
+					currentMatch++;
+					block = 0;
+					if(currentMatch == endMatch)
+						return;
+				}
+				matches = MatchBlock();
+			}
+		}
+	};
+
+	template<class Ty>
+	class FilteredObjectRange
+	{
+		//Exact type queries have a single bucket, held here as the range has no scene side list to point into
+		SubtypeMatch exact{};
+		std::shared_ptr<const std::vector<SubtypeMatch>> matches;
+		ObjectFilter filter;
+
+	public:
+		FilteredObjectRange(const SubtypeMatch& exact, const ObjectFilter& filter) :
+			exact{ exact },
+			filter{ filter }
+		{
+
+		}
+
+		FilteredObjectRange(std::shared_ptr<const std::vector<SubtypeMatch>> matches, const ObjectFilter& filter) :
+			matches{ std::move(matches) },
+			filter{ filter }
+		{
+
+		}
+
+		FilteredObjectIterator<Ty> begin() const
+		{
+			if(exact.bucket)
+				return { &exact, &exact + 1, filter };
+			if(!matches)
+				return {};
+			return { matches->data(), matches->data() + matches->size(), filter };
+		}
+
+		ObjectSentinal<Ty> end() const
+		{
+			return { };
+		}
+	};
 	
 
 	template<class Ty>
@@ -471,6 +740,183 @@ namespace InsanityFramework
 		}
 	};
 
+	//Refers to an object created by SceneCommands::New before it is played back
+	export template<class Ty>
+	struct PendingObject
+	{
+		std::uint32_t index;
+	};
+
+	//Structural changes recorded by one thread, get the calling thread's buffer with Scene::GetThreadCommands.
+	//Commands are played back when the scene flushes its lifetimes, sorted by sort key. Commands with the same key keep
+	//the order they were recorded in, tasks running in parallel should each use their own key for playback to be deterministic.
+	//Only record while the work doing so holds the scene's lifetime lock, as the flush isn't synchronized with recording
+	export class SceneCommands
+	{
+		friend Scene;
+
+		struct Command
+		{
+			std::uint64_t sortKey;
+			void* payload;
+			void(*play)(void* payload, SceneCommands& commands);
+			void(*destroy)(void* payload);
+		};
+
+		struct Block
+		{
+			std::unique_ptr<std::byte[]> data;
+			std::size_t size;
+		};
+
+		//Payloads are bump allocated, blocks are kept between flushes so recording stops allocating once warmed up
+		static constexpr std::size_t blockSize = 64 * 1024;
+
+	private:
+		Scene* scene;
+		std::thread::id thread = std::this_thread::get_id();
+		std::vector<Command> commands;
+		std::vector<Block> blocks;
+		std::size_t currentBlock = 0;
+		std::size_t blockOffset = 0;
+		std::vector<Object*> created;
+		std::uint64_t sortKey = 0;
+
+	public:
+		SceneCommands(Scene* scene) :
+			scene{ scene }
+		{
+
+		}
+
+		SceneCommands(const SceneCommands&) = delete;
+		SceneCommands& operator=(const SceneCommands&) = delete;
+
+		~SceneCommands()
+		{
+			for(Command& command : commands)
+				command.destroy(command.payload);
+		}
+
+	public:
+		//Sets the key for the lifetime of the scope and puts the previous one back after,
+		//so commands recorded later by the same thread don't inherit the key of the job it ran before
+		class SortKeyScope
+		{
+			SceneCommands& commands;
+			std::uint64_t previousKey;
+
+		public:
+			SortKeyScope(SceneCommands& commands, std::uint64_t key) noexcept :
+				commands{ commands },
+				previousKey{ commands.sortKey }
+			{
+				commands.sortKey = key;
+			}
+
+			SortKeyScope(const SortKeyScope&) = delete;
+			SortKeyScope& operator=(const SortKeyScope&) = delete;
+
+			~SortKeyScope()
+			{
+				commands.sortKey = previousKey;
+			}
+		};
+
+	public:
+		void SetSortKey(std::uint64_t key) noexcept { sortKey = key; }
+		std::uint64_t GetSortKey() const noexcept { return sortKey; }
+
+		//Constructs the object in the scene on playback, it starts out as a root object
+		template<std::derived_from<GameObject> Ty, class... Args>
+		PendingObject<Ty> New(Args&&... args);
+
+		void Delete(Object* object);
+
+		template<class Ty>
+		void Delete(PendingObject<Ty> object);
+
+		//Child and parent are either GameObject pointers or pending objects, parent may be nullptr
+		template<class Child, class Parent>
+		void SetParent(Child child, Parent parent);
+
+		template<std::derived_from<SceneSystem> Ty, class... Args>
+		void AddSystem(Args&&... args);
+
+		template<std::invocable<> Func>
+		void Defer(Func&& func)
+		{
+			Record([func = std::forward<Func>(func)](SceneCommands&) mutable { func(); });
+		}
+
+		//Only valid during playback, for deferred functions referring to objects created earlier by this buffer
+		template<class Ty>
+		Ty* Resolve(PendingObject<Ty> object) const
+		{
+			assert(object.index < created.size() && created[object.index]);
+			return static_cast<Ty*>(created[object.index]);
+		}
+
+	private:
+		static GameObject* ResolveNode(GameObject* object, const SceneCommands&) { return object; }
+		static GameObject* ResolveNode(std::nullptr_t, const SceneCommands&) { return nullptr; }
+
+		template<class Ty>
+		static GameObject* ResolveNode(PendingObject<Ty> object, const SceneCommands& commands) { return commands.Resolve(object); }
+
+		template<class Func>
+		void Record(Func&& func)
+		{
+			using Payload = std::remove_cvref_t<Func>;
+			static_assert(alignof(Payload) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+
+			void* payload = std::construct_at(static_cast<Payload*>(Allocate(sizeof(Payload), alignof(Payload))), std::forward<Func>(func));
+			commands.push_back(
+			{
+				sortKey,
+				payload,
+				[](void* payload, SceneCommands& commands)
+				{
+					Payload& func = *static_cast<Payload*>(payload);
+					func(commands);
+					std::destroy_at(&func);
+				},
+				[](void* payload) { std::destroy_at(static_cast<Payload*>(payload)); }
+			});
+		}
+
+		void* Allocate(std::size_t size, std::size_t alignment)
+		{
+			while(true)
+			{
+				if(currentBlock == blocks.size())
+				{
+					const std::size_t newSize = (std::max)(blockSize, size);
+					blocks.push_back({ std::make_unique_for_overwrite<std::byte[]>(newSize), newSize });
+				}
+
+				Block& block = blocks[currentBlock];
+				const std::size_t offset = (blockOffset + alignment - 1) / alignment * alignment;
+				if(offset + size <= block.size)
+				{
+					blockOffset = offset + size;
+					return block.data.get() + offset;
+				}
+
+				currentBlock++;
+				blockOffset = 0;
+			}
+		}
+
+		//Called once every command has been played back
+		void Reset() noexcept
+		{
+			currentBlock = 0;
+			blockOffset = 0;
+			created.clear();
+		}
+	};
+
 	class Scene
 	{
 		template<class Ty>
@@ -481,6 +927,18 @@ namespace InsanityFramework
 
 		template<class Ty>
 		friend class ObjectIterator;
+
+		template<std::derived_from<Object> Ty>
+		friend class WeakObject;
+
+		template<std::derived_from<GameObject> Ty>
+		friend class ObjectPool;
+
+		friend class SceneGroup;
+		friend class ObjectReclaimer;
+		friend struct ParallelSceneIteration;
+		friend ActiveSceneScope;
+		friend SceneSnapshots;
 	public:
 		struct Key
 		{
@@ -490,20 +948,80 @@ namespace InsanityFramework
 		};
 
 	private:
-		ObjectAllocator allocator;
-
-		std::unordered_map<std::type_index, std::vector<Object*>> gameObjects;
-		std::unordered_map<std::type_index, std::unique_ptr<SceneSystem>> sceneSystems;
-		std::vector<Object*> queuedConstruction;
+		ObjectAllocator allocator{ this };
+		ComponentStore components;
+		//Set by the group holding the scene so finding it doesn't touch the shared group list
+		SceneGroup* group = nullptr;
+
+		TypeMap<ObjectBucket> gameObjects;
+		std::vector<const ObjectBucket*> buckets;
+		TypeMap<std::unique_ptr<SceneSystem>> sceneSystems;
+		std::vector<SceneSystem*> systemOrder;
+		std::vector<SceneCallbacks*> listeners;
+		//Queued with their type so FlushLifetimes doesn't need typeid to group them, and with their masks
+		//which only get a place in the bucket once the object is registered
+		struct QueuedConstruction
+		{
+			Object* object;
+			TypeID type;
+			std::uint64_t layers;
+			std::uint64_t tags;
+		};
+		std::vector<QueuedConstruction> queuedConstruction;
 		std::vector<Object*> queuedDestruction;
+		//Objects released to a pool while lifetimes were locked, they leave the scene with the next flush
+		std::vector<std::pair<Object*, ObjectRecycler*>> queuedRecycling;
 		std::uint32_t lifetimeLockCounter = 0;
+		//Pools keeping objects of this scene, which have to go before its pages do
+		std::vector<ObjectRecycler*> recyclers;
+
+		//Every object has a slot from creation to destruction, slot 0 is never used so default handles are null.
+		//Generations come from a counter shared by all scenes so handles don't resolve in a scene they're not from
+		std::vector<ObjectHandleSlot> handleSlots{ 1 };
+		std::vector<std::uint32_t> freeHandleSlots;
+		inline static std::atomic<std::uint32_t> nextHandleGeneration = 1;
+
+		SceneTeardownMode teardownMode = SceneTeardownMode::Safe;
+		//Indexed by TypeID
+		std::vector<bool> skipDestructorTypes;
+
+		//Objects whose destructor is queued on the reclaimer, their memory comes back through reclaimedAllocations.
+		//Guarded by reclaimMutex, which the reclaimer holds until it is done with the scene
+		std::size_t pendingReclaims = 0;
+		std::mutex reclaimMutex;
+		std::condition_variable reclaimsDone;
+		std::vector<void*> reclaimedAllocations;
+
+		inline static thread_local Scene* tearingDownScene = nullptr;
+
+		struct ThreadCommandsCache
+		{
+			const Scene* scene = nullptr;
+			std::uint64_t sceneId = 0;
+			SceneCommands* commands = nullptr;
+		};
+
+		inline static std::atomic<std::uint64_t> nextSceneId = 1;
+		inline static thread_local ThreadCommandsCache threadCommandsCache;
+
+		//Scene addresses can be reused, the id tells a thread's cached buffer apart from one of a deleted scene
+		const std::uint64_t sceneId = nextSceneId.fetch_add(1, std::memory_order_relaxed);
+		std::mutex threadCommandsMutex;
+		std::vector<std::unique_ptr<SceneCommands>> threadCommands;
 
 	public:
+		//Shared by every scene, must be thread safe when scene groups run on several threads
 		inline static SceneCallbacks* callbacks = &defaultSceneCallbacks;
 		static Scene* GetActiveScene();
+		//The scene whose allocator made the object, safe from any thread
+		static Scene* GetOwner(Object* object);
+
+	private:
+		static Scene* ExchangeActiveScene(Scene* scene);
+
 	public:
 		Scene(Key) :
-			allocator{ /*this*/ }
+			allocator{ this }
 		{
 
 		}
@@ -511,28 +1029,50 @@ namespace InsanityFramework
 		~Scene()
 		{
 			assert(lifetimeLockCounter == 0);
-			std::vector<Object*> rootObjects;
-			for(auto& [type, objects] : gameObjects)
+			WaitForReclaims();
+
+			for(ObjectRecycler* recycler : std::exchange(recyclers, {}))
+				recycler->DeleteKept();
+
+			//The scene may already be gone from its group, deletes of its objects are routed here directly
+			Scene* previousTearingDown = std::exchange(tearingDownScene, this);
+
+			if(teardownMode == SceneTeardownMode::Fast)
+			{
+				FastTeardown();
+			}
+			else
 			{
-				for(Object* object : objects)
+				std::vector<Object*> rootObjects;
+				for(auto& [type, bucket] : gameObjects)
 				{
-					if(object->IsRoot())
-						rootObjects.push_back(object);
+					for(Object* object : bucket.objects)
+					{
+						if(object->IsRoot())
+							rootObjects.push_back(object);
+					}
 				}
-			}
 
-			for(Object* object : rootObjects)
-			{
-				DeleteObject(object);
-				//allocator.Delete(object);
+				for(Object* object : rootObjects)
+				{
+					DeleteObject(object);
+					//allocator.Delete(object);
+				}
 			}
 
+			tearingDownScene = previousTearingDown;
+
 			for(auto& [type, object] : sceneSystems)
 			{
 				object = nullptr;
 			}
 		}
 
+		void SetTeardownMode(SceneTeardownMode mode) noexcept
+		{
+			teardownMode = mode;
+		}
+
 		bool Contains(Object* object) const
 		{
 			return allocator.Contains(object);
@@ -542,19 +1082,22 @@ namespace InsanityFramework
 		template<std::derived_from<GameObject> Ty, class... Args>
 		static UniqueObject<Ty> NewObject(Args&&... args)
 		{
-			UniqueObject<Ty> object = GetActiveScene()->allocator.New<Ty>(std::forward<Args>(args)...);
-			if(GetActiveScene()->lifetimeLockCounter == 0)
-				GetActiveScene()->gameObjects[typeid(Ty)].push_back(object.get());
-			else
-				GetActiveScene()->queuedConstruction.push_back(object.get());
-
-			callbacks->OnObjectCreated(object.get());
-
+			Scene* scene = GetActiveScene();
+			UniqueObject<Ty> object = scene->allocator.New<Ty>(std::forward<Args>(args)...);
+			scene->AddObject(object.get(), scene->GetBucket(GetTypeID<Ty>()));
 			return object;
 		}
 
 		static void DeleteObject(Object* object)
 		{
+			if(tearingDownScene && tearingDownScene->Contains(object))
+			{
+				//A fast teardown destroys every object itself, owners must not delete them a second time
+				if(tearingDownScene->teardownMode == SceneTeardownMode::Safe)
+					tearingDownScene->ImmediateDeleteObject(object);
+				return;
+			}
+
 			Scene* owner = GetOwner(object);
 
 			if(owner->lifetimeLockCounter == 0)
@@ -567,40 +1110,88 @@ namespace InsanityFramework
 			}
 		}
 
+		//Deletes the object like DeleteObject but runs its destructor on the background reclaimer, with the same
+		//restrictions as for ReclaimsInBackground types. It leaves the scene and its hierarchy right away
+		static void DeleteObjectInBackground(Object* object)
+		{
+			object->reclaimInBackground = true;
+			DeleteObject(object);
+		}
+
+		//Blocks until every destructor handed to the reclaimer has run and frees their memory
+		void WaitForReclaims()
+		{
+			std::vector<void*> allocations;
+			{
+				std::unique_lock lock{ reclaimMutex };
+				reclaimsDone.wait(lock, [&] { return pendingReclaims == 0; });
+				allocations.swap(reclaimedAllocations);
+			}
+			for(void* allocation : allocations)
+				ObjectAllocator::FreeDestroyed(allocation);
+		}
+
 		template<std::derived_from<SceneSystem> Ty, class... Args>
 		static Ty& AddSystem(Args&&... args)
 		{
-			auto it = GetActiveScene()->sceneSystems.find(typeid(Ty));
-			if(it != GetActiveScene()->sceneSystems.end())
+			if(GetActiveScene()->sceneSystems.Contains(GetTypeID<Ty>()))
 			{
 				throw std::exception("System already added");
 			}
 			auto system = std::make_unique<Ty>(std::forward<Args>(args)...);
 			auto output = system.get();
-			GetActiveScene()->sceneSystems.insert({ typeid(Ty),  std::move(system) });
+			GetActiveScene()->sceneSystems.TryEmplace(GetTypeID<Ty>(), std::move(system));
+			GetActiveScene()->systemOrder.push_back(output);
 			return *output;
 		}
 
 		template<std::derived_from<SceneSystem> Ty>
 		static Ty& GetSystem()
 		{
-			return dynamic_cast<Ty&>(*GetActiveScene()->sceneSystems.at(typeid(Ty)));
+			return dynamic_cast<Ty&>(*GetActiveScene()->sceneSystems.At(GetTypeID<Ty>()));
 		}
 
 		template<std::derived_from<SceneSystem> Ty>
 		static Ty* TryGetSystem()
 		{
-			auto it = GetActiveScene()->sceneSystems.find(typeid(Ty));
-			if(it == GetActiveScene()->sceneSystems.end())
+			auto system = GetActiveScene()->sceneSystems.Find(GetTypeID<Ty>());
+			if(!system)
 			{
 				return nullptr;
 			}
 
-			return dynamic_cast<Ty*>(it->second);
+			return dynamic_cast<Ty*>(system->get());
 		}
 
 
-		template<std::derived_from<GameObject> Ty>
+		//Creates an entity in the active scene's component store, a GameObject can hold the handle to own it
+		template<Component... Tys>
+		static UniqueEntity NewEntity(const Tys&... components)
+		{
+			ComponentStore& store = GetActiveScene()->components;
+			return { store, store.NewEntity(components...) };
+		}
+
+		//Iterates the chunks of every archetype in the active scene which has all of Tys
+		template<Component... Tys>
+		static ComponentQuery<Tys...> Query()
+		{
+			return GetActiveScene()->components.Query<Tys...>();
+		}
+
+		static ComponentStore& GetComponentStore()
+		{
+			return GetActiveScene()->components;
+		}
+
+		//Runs func(Ty&) or func(Ty&, SceneCommands&) over every object of exactly Ty in the active scene on the job system.
+		//Threads which aren't participants of it run every chunk themselves.
+		//Lifetimes stay locked until it returns, structural changes should go through the worker's commands.
+		//Commands are keyed by chunk so they play back in the order a serial loop would have recorded them
+		template<std::derived_from<GameObject> Ty, class Func>
+		static void ParallelForEach(Func&& func, JobSystem& jobs);
+
+		template<std::derived_from<GameObject> Ty>
 		static GlobalExactObjectRange<Ty> GetObjectsExactType() 
 		{
 			return { SceneGroup::GetGroup(GetActiveScene()) };
@@ -624,6 +1215,74 @@ namespace InsanityFramework
 			return { scene };
 		}
 
+		//Objects of exactly Ty in the scene which pass the filter
+		template<std::derived_from<GameObject> Ty>
+		static FilteredObjectRange<Ty> GetObjectsExactTypeInScene(Scene* scene, const ObjectFilter& filter)
+		{
+			const ObjectBucket* bucket = scene->gameObjects.Find(GetTypeID<Ty>());
+			if(!bucket || bucket->objects.empty())
+				return { std::shared_ptr<const std::vector<SubtypeMatch>>{}, filter };
+
+			Object* front = bucket->objects.front();
+			return { SubtypeMatch{ bucket, OffsetOf(front, dynamic_cast<Ty*>(front)) }, filter };
+		}
+
+		//Objects converting to Ty in the scene which pass the filter
+		template<class Ty>
+		static FilteredObjectRange<Ty> GetObjectsInScene(Scene* scene, const ObjectFilter& filter)
+		{
+			return { scene->GetSubtypeMatches(GetTypeID<Ty>(), [](Object* object) -> void* { return dynamic_cast<Ty*>(object); }), filter };
+		}
+
+		//Layer and tag masks of an object, which may still be queued for registration
+		static std::uint64_t GetLayers(const Object* object)
+		{
+			return LayersOf(const_cast<Object*>(object));
+		}
+
+		static void SetLayers(Object* object, std::uint64_t layers)
+		{
+			LayersOf(object) = layers;
+		}
+
+		static std::uint64_t GetTags(const Object* object)
+		{
+			return TagsOf(const_cast<Object*>(object));
+		}
+
+		static void SetTags(Object* object, std::uint64_t tags)
+		{
+			TagsOf(object) = tags;
+		}
+
+		static void AddTags(Object* object, std::uint64_t tags)
+		{
+			TagsOf(object) |= tags;
+		}
+
+		static void RemoveTags(Object* object, std::uint64_t tags)
+		{
+			TagsOf(object) &= ~tags;
+		}
+
+		//Systems in the order they were added
+		std::span<SceneSystem* const> GetSystems() const
+		{
+			return systemOrder;
+		}
+
+		//Listeners hear about this scene's objects after the global callbacks, for systems holding on to object pointers.
+		//A listener has to be removed before it is destroyed
+		void AddListener(SceneCallbacks* listener)
+		{
+			listeners.push_back(listener);
+		}
+
+		void RemoveListener(SceneCallbacks* listener)
+		{
+			std::erase(listeners, listener);
+		}
+
 		void LockLifetimes()
 		{
 			lifetimeLockCounter++;
@@ -638,32 +1297,465 @@ namespace InsanityFramework
 			}
 		}
 
+		//Registers queued objects and deletes queued ones, both grouped by type so each type's bucket is looked up once
 		void FlushLifetimes()
 		{
 			assert(lifetimeLockCounter == 0);
 
-			for(Object* object : queuedConstruction)
+			FreeReclaimed();
+
+			//Played with lifetimes locked so their objects join the batches below
+			lifetimeLockCounter++;
+			PlayThreadCommands();
+			lifetimeLockCounter--;
+
+			if(!queuedConstruction.empty())
+			{
+				std::vector<QueuedConstruction> byType = std::move(queuedConstruction);
+				queuedConstruction.clear();
+				std::stable_sort(byType.begin(), byType.end(), [](const auto& lh, const auto& rh) { return lh.type < rh.type; });
+
+				std::vector<Object*> constructions(byType.size());
+
+				for(std::size_t begin = 0; begin < byType.size();)
+				{
+					std::size_t end = begin + 1;
+					while(end < byType.size() && byType[end].type == byType[begin].type)
+						end++;
+
+					ObjectBucket& bucket = GetBucket(byType[begin].type);
+					const std::size_t size = bucket.objects.size() + (end - begin);
+					bucket.objects.reserve(size);
+					bucket.layers.reserve(size);
+					bucket.tags.reserve(size);
+					for(std::size_t i = begin; i < end; i++)
+					{
+						constructions[i] = byType[i].object;
+						Register(constructions[i], bucket, byType[i].layers, byType[i].tags);
+					}
+					Notify([&](SceneCallbacks& listener) { listener.OnObjectsCreated(std::span<Object* const>{ constructions.data() + begin, end - begin }); });
+
+					begin = end;
+				}
+			}
+
+			if(!queuedDestruction.empty())
+			{
+				//Destructors may delete other objects which would otherwise be appended while we iterate
+				std::vector<Object*> destructions = std::move(queuedDestruction);
+				queuedDestruction.clear();
+
+				//Groups by bucket, std::less since the buckets are unrelated objects
+				std::stable_sort(destructions.begin(), destructions.end(), [](const Object* lh, const Object* rh) { return std::less<ObjectBucket*>{}(lh->bucket, rh->bucket); });
+				std::vector<ObjectReclaimer::Work> reclaims;
+				for(std::size_t begin = 0; begin < destructions.size();)
+				{
+					std::size_t end = begin + 1;
+					while(end < destructions.size() && destructions[end]->bucket == destructions[begin]->bucket)
+						end++;
+
+					std::span<Object* const> batch{ destructions.data() + begin, end - begin };
+					Notify([&](SceneCallbacks& listener) { listener.OnObjectsDestroyed(batch); });
+					for(Object* object : batch)
+					{
+						Unregister(object);
+						if(object->reclaimInBackground)
+							reclaims.push_back(PrepareReclaim(object));
+						else
+							allocator.Delete(object);
+					}
+
+					begin = end;
+				}
+
+				if(!reclaims.empty())
+					SubmitReclaims(reclaims);
+			}
+
+			if(!queuedRecycling.empty())
 			{
-				gameObjects[typeid(*object)].push_back(object);
+				std::vector<std::pair<Object*, ObjectRecycler*>> recycling = std::move(queuedRecycling);
+				queuedRecycling.clear();
+				for(auto [object, recycler] : recycling)
+					RecycleObject(object, *recycler);
 			}
-			queuedConstruction.clear();
+		}
 
-			for(Object* object : queuedDestruction)
+		//The calling thread's command buffer for this scene, safe to call from any thread
+		SceneCommands& GetThreadCommands()
+		{
+			ThreadCommandsCache& cache = threadCommandsCache;
+			if(cache.scene == this && cache.sceneId == sceneId)
+				return *cache.commands;
+
+			std::scoped_lock lock{ threadCommandsMutex };
+			auto it = std::find_if(threadCommands.begin(), threadCommands.end(), [](const auto& commands) { return commands->thread == std::this_thread::get_id(); });
+			if(it == threadCommands.end())
 			{
-				ImmediateDeleteObject(object);
+				threadCommands.push_back(std::make_unique<SceneCommands>(this));
+				it = threadCommands.end() - 1;
 			}
-			queuedDestruction.clear();
+
+			cache = { this, sceneId, it->get() };
+			return **it;
 		}
 
 	private:
+		void PlayThreadCommands()
+		{
+			{
+				std::scoped_lock lock{ threadCommandsMutex };
+				if(threadCommands.empty())
+					return;
+			}
+
+			Scene* previousScene = ExchangeActiveScene(this);
+
+			//Commands may record more commands, those are played in the next round
+			std::vector<std::pair<SceneCommands*, SceneCommands::Command>> ordered;
+			while(true)
+			{
+				ordered.clear();
+				{
+					std::scoped_lock lock{ threadCommandsMutex };
+					for(const auto& commands : threadCommands)
+					{
+						for(const SceneCommands::Command& command : commands->commands)
+							ordered.push_back({ commands.get(), command });
+						commands->commands.clear();
+					}
+				}
+
+				if(ordered.empty())
+					break;
+
+				std::stable_sort(ordered.begin(), ordered.end(), [](const auto& lh, const auto& rh) { return lh.second.sortKey < rh.second.sortKey; });
+				for(auto& [commands, command] : ordered)
+					command.play(command.payload, *commands);
+			}
+
+			{
+				std::scoped_lock lock{ threadCommandsMutex };
+				for(const auto& commands : threadCommands)
+					commands->Reset();
+			}
+
+			ExchangeActiveScene(previousScene);
+		}
+
+		struct SubtypeQuery
+		{
+			//Replaced instead of appended to, iterators of earlier queries keep the old list alive
+			std::shared_ptr<const std::vector<SubtypeMatch>> matches;
+			std::vector<const ObjectBucket*> pending;
+			std::size_t checkedBuckets = 0;
+			std::uint64_t checkedVersion = ~std::uint64_t{ 0 };
+		};
+
+		//GetObjects<Ty> results per queried type. Buckets are never removed so a query only
+		//has to look at buckets for concrete types registered since it last ran, and at buckets which were
+		//empty at the time as there was no object to dynamic_cast. Up to date queries only take the shared lock,
+		//so systems of a parallel schedule can query at the same time
+		mutable TypeMap<SubtypeQuery> subtypeQueries;
+		mutable std::shared_mutex subtypeQueriesMutex;
+		//Bumped when a bucket is added or stops being empty, queries checked at the current version are up to date
+		std::atomic<std::uint64_t> bucketsVersion = 0;
+
+		ObjectBucket& GetBucket(TypeID type)
+		{
+			auto [bucket, inserted] = gameObjects.TryEmplace(type);
+			if(inserted)
+			{
+				buckets.push_back(bucket);
+				bucketsVersion.fetch_add(1, std::memory_order_release);
+			}
+			return *bucket;
+		}
+
+		//Gives a new or reused object a handle and registers it, or queues it while lifetimes are locked
+		template<std::derived_from<GameObject> Ty>
+		void AddObject(Ty* object, ObjectBucket& bucket)
+		{
+			AssignHandle(object);
+			if constexpr(SkipsDestructorOnTeardown<Ty>)
+				SkipDestructorOnTeardown(GetTypeID<Ty>());
+			if constexpr(ReclaimsInBackground<Ty>)
+				static_cast<Object*>(object)->reclaimInBackground = true;
+			if(lifetimeLockCounter == 0)
+			{
+				Register(object, bucket, InitialLayers<Ty>(), InitialTags<Ty>());
+				Notify([&](SceneCallbacks& listener) { listener.OnObjectCreated(object); });
+			}
+			else
+			{
+				//Listeners hear about it once it is registered by FlushLifetimes
+				queuedConstruction.push_back({ object, GetTypeID<Ty>(), InitialLayers<Ty>(), InitialTags<Ty>() });
+			}
+		}
+
+		//Takes the object out of the scene like a delete, but hands it to the recycler instead of destroying it
+		void RecycleObject(Object* object, ObjectRecycler& recycler)
+		{
+			Notify([&](SceneCallbacks& listener) { listener.OnObjectDestroyed(object); });
+			Unregister(object);
+			recycler.Recycle(object);
+		}
+
+		template<class Ty>
+		static constexpr std::uint64_t InitialLayers()
+		{
+			if constexpr(HasObjectLayers<Ty>)
+				return Ty::objectLayers;
+			else
+				return defaultObjectLayers;
+		}
+
+		template<class Ty>
+		static constexpr std::uint64_t InitialTags()
+		{
+			if constexpr(HasObjectTags<Ty>)
+				return Ty::objectTags;
+			else
+				return 0;
+		}
+
+		static std::uint64_t& LayersOf(Object* object)
+		{
+			return object->bucket ? object->bucket->layers[object->bucketSlot] : FindQueuedConstruction(object).layers;
+		}
+
+		static std::uint64_t& TagsOf(Object* object)
+		{
+			return object->bucket ? object->bucket->tags[object->bucketSlot] : FindQueuedConstruction(object).tags;
+		}
+
+		static QueuedConstruction& FindQueuedConstruction(Object* object)
+		{
+			std::vector<QueuedConstruction>& queue = GetOwner(object)->queuedConstruction;
+			//Masks are mostly set right after NewObject, so the object is near the back
+			auto it = std::find_if(queue.rbegin(), queue.rend(), [&](const QueuedConstruction& queued) { return queued.object == object; });
+			assert(it != queue.rend());
+			return *it;
+		}
+
+		void SkipDestructorOnTeardown(TypeID type)
+		{
+			if(type >= skipDestructorTypes.size())
+				skipDestructorTypes.resize(type + 1);
+			skipDestructorTypes[type] = true;
+		}
+
+		std::shared_ptr<const std::vector<SubtypeMatch>> GetSubtypeMatches(TypeID type, void* (*cast)(Object*)) const
+		{
+			const std::uint64_t version = bucketsVersion.load(std::memory_order_acquire);
+			{
+				std::shared_lock lock{ subtypeQueriesMutex };
+				if(const SubtypeQuery* query = subtypeQueries.Find(type); query && query->checkedVersion == version)
+					return query->matches;
+			}
+
+			std::scoped_lock lock{ subtypeQueriesMutex };
+			SubtypeQuery& query = subtypeQueries[type];
+			if(query.checkedVersion == version)
+				return query.matches;
+
+			auto matches = query.matches ? std::make_shared<std::vector<SubtypeMatch>>(*query.matches) : std::make_shared<std::vector<SubtypeMatch>>();
+			auto tryMatch = [&](const ObjectBucket* bucket)
+			{
+				if(bucket->objects.empty())
+					return false;
+
+				if(void* ptr = cast(bucket->objects.front()))
+					matches->push_back({ bucket, OffsetOf(bucket->objects.front(), ptr) });
+				return true;
+			};
+
+			if(!query.pending.empty())
+				std::erase_if(query.pending, tryMatch);
+
+			for(; query.checkedBuckets < buckets.size(); query.checkedBuckets++)
+			{
+				if(!tryMatch(buckets[query.checkedBuckets]))
+					query.pending.push_back(buckets[query.checkedBuckets]);
+			}
+
+			query.matches = std::move(matches);
+			query.checkedVersion = version;
+			return query.matches;
+		}
+
+		//Destroys every object in address order, so page by page, then releases the pages wholesale.
+		//Objects aren't unregistered one at a time and listeners get a single batch
+		void FastTeardown()
+		{
+			FlushLifetimes();
+
+			std::size_t objectCount = 0;
+			for(const ObjectBucket* bucket : buckets)
+				objectCount += bucket->objects.size();
+
+			std::vector<Object*> objects;
+			std::vector<Object*> destroyed;
+			objects.reserve(objectCount);
+			destroyed.reserve(objectCount);
+			for(auto& [type, bucket] : gameObjects)
+			{
+				objects.insert(objects.end(), bucket.objects.begin(), bucket.objects.end());
+				if(type >= skipDestructorTypes.size() || !skipDestructorTypes[type])
+					destroyed.insert(destroyed.end(), bucket.objects.begin(), bucket.objects.end());
+			}
+
+			if(!objects.empty())
+				Notify([&](SceneCallbacks& listener) { listener.OnObjectsDestroyed(objects); });
+
+			std::sort(destroyed.begin(), destroyed.end(), std::less<Object*>{});
+			for(Object* object : destroyed)
+				object->~Object();
+
+			{
+				std::scoped_lock lock{ subtypeQueriesMutex };
+				subtypeQueries.Clear();
+			}
+			buckets.clear();
+			gameObjects.Clear();
+			allocator.ReleasePages();
+		}
+
 		void ImmediateDeleteObject(Object* object)
 		{
-			callbacks->OnObjectDestroyed(object);
-			std::erase(gameObjects[typeid(*object)], object);
-			allocator.Delete(object);
+			Notify([&](SceneCallbacks& listener) { listener.OnObjectDestroyed(object); });
+			Unregister(object);
+
+			//A scene being torn down destroys everything itself
+			if(object->reclaimInBackground && tearingDownScene != this)
+			{
+				const ObjectReclaimer::Work work = PrepareReclaim(object);
+				SubmitReclaims({ &work, 1 });
+			}
+			else
+			{
+				allocator.Delete(object);
+			}
+		}
+
+		//Leaves the hierarchy on the owning thread so the destructor on the reclaimer only touches the object itself
+		ObjectReclaimer::Work PrepareReclaim(Object* object)
+		{
+			if(auto gameObject = dynamic_cast<GameObject*>(object))
+				gameObject->Detach();
+			return { this, object, dynamic_cast<void*>(object) };
 		}
 
-		static Scene* GetOwner(Object* object);
+		void SubmitReclaims(std::span<const ObjectReclaimer::Work> work)
+		{
+			{
+				std::scoped_lock lock{ reclaimMutex };
+				pendingReclaims += work.size();
+			}
+			ObjectReclaimer::Default().Submit(work);
+		}
+
+		//Called by the reclaimer once it ran the destructors, the scene may be destroyed as soon as the lock is released
+		void CompleteReclaims(std::span<void* const> allocations)
+		{
+			std::scoped_lock lock{ reclaimMutex };
+			reclaimedAllocations.insert(reclaimedAllocations.end(), allocations.begin(), allocations.end());
+			pendingReclaims -= allocations.size();
+			if(pendingReclaims == 0)
+				reclaimsDone.notify_all();
+		}
+
+		static void RunDestructor(Object* object)
+		{
+			object->~Object();
+		}
+
+		template<class Func>
+		void Notify(Func func)
+		{
+			func(*callbacks);
+			for(SceneCallbacks* listener : listeners)
+				func(*listener);
+		}
+
+		void FreeReclaimed()
+		{
+			std::vector<void*> allocations;
+			{
+				std::scoped_lock lock{ reclaimMutex };
+				allocations.swap(reclaimedAllocations);
+			}
+			for(void* allocation : allocations)
+				ObjectAllocator::FreeDestroyed(allocation);
+		}
+
+		void Register(Object* object, ObjectBucket& bucket, std::uint64_t layers, std::uint64_t tags)
+		{
+			object->bucket = &bucket;
+			object->bucketSlot = static_cast<std::uint32_t>(bucket.objects.size());
+			bucket.objects.push_back(object);
+			bucket.layers.push_back(layers);
+			bucket.tags.push_back(tags);
+
+			//Queries skip empty buckets as they can't cast them yet
+			if(bucket.objects.size() == 1)
+				bucketsVersion.fetch_add(1, std::memory_order_release);
+		}
+
+		void AssignHandle(Object* object)
+		{
+			std::uint32_t slot;
+			if(freeHandleSlots.empty())
+			{
+				slot = static_cast<std::uint32_t>(handleSlots.size());
+				handleSlots.emplace_back();
+			}
+			else
+			{
+				slot = freeHandleSlots.back();
+				freeHandleSlots.pop_back();
+			}
+
+			//0 marks a null handle, skipped when the counter wraps
+			std::uint32_t generation = nextHandleGeneration.fetch_add(1, std::memory_order_relaxed);
+			if(generation == 0)
+				generation = nextHandleGeneration.fetch_add(1, std::memory_order_relaxed);
+
+			handleSlots[slot] = { object, generation };
+			object->handleSlot = slot;
+			object->handleGeneration = generation;
+		}
+
+		Object* ResolveHandle(std::uint32_t slot, std::uint32_t generation) const noexcept
+		{
+			if(slot >= handleSlots.size())
+				return nullptr;
+
+			const ObjectHandleSlot& handle = handleSlots[slot];
+			return handle.generation == generation ? handle.object : nullptr;
+		}
+
+		//Swaps the last object of the bucket into the removed slot and frees the object's handle slot
+		void Unregister(Object* object)
+		{
+			handleSlots[object->handleSlot] = {};
+			freeHandleSlots.push_back(object->handleSlot);
+
+			ObjectBucket& bucket = *object->bucket;
+			const std::uint32_t slot = object->bucketSlot;
+			assert(bucket.objects[slot] == object);
+
+			Object* last = bucket.objects.back();
+			bucket.objects[slot] = last;
+			bucket.layers[slot] = bucket.layers.back();
+			bucket.tags[slot] = bucket.tags.back();
+			last->bucketSlot = slot;
+			bucket.objects.pop_back();
+			bucket.layers.pop_back();
+			bucket.tags.pop_back();
+
+			object->bucket = nullptr;
+		}
 	};
 
 	struct SceneGroupDeleter
@@ -680,9 +1772,12 @@ namespace InsanityFramework
 	export using UniqueSceneHandle = std::unique_ptr<Scene, SceneHandleDeleter>;
 	export using UniqueSceneGroupHandle = std::unique_ptr<SceneGroup, SceneGroupDeleter>;
 
+	//Groups are independent worlds, each may run on its own thread with its own active scene.
+	//The group list and scene ownership are guarded, a group's scenes must only be used by the thread running that group
 	export class SceneGroup
 	{
 		inline static std::list<SceneGroup> groups;
+		inline static std::shared_mutex registryMutex;
 
 		std::vector<std::unique_ptr<Scene>> scenes;
 
@@ -692,6 +1787,7 @@ namespace InsanityFramework
 	public:
 		static UniqueSceneGroupHandle New()
 		{
+			std::scoped_lock lock{ registryMutex };
 			groups.push_back({});
 
 			return { &groups.back(), {} };
@@ -699,50 +1795,75 @@ namespace InsanityFramework
 
 		static SceneGroup* GetGroup(Scene* scene)
 		{
-			for (SceneGroup& group : groups)
-			{
-				if (group.Contains(scene))
-					return &group;
-			}
-			return nullptr;
+			return scene->group;
 		}
 
 		static void Delete(SceneGroup* group)
 		{
-			std::erase_if(groups, [=](const auto& g) { return &g == group; });
+			//Destroyed outside the lock as object destructors may look up their scene
+			std::list<SceneGroup> removed;
+			{
+				std::scoped_lock lock{ registryMutex };
+				auto it = std::find_if(groups.begin(), groups.end(), [=](const auto& g) { return &g == group; });
+				if(it != groups.end())
+					removed.splice(removed.begin(), groups, it);
+			}
 		}
 
 		static std::pair<Scene*, SceneGroup*> GetScene(Object* object)
 		{
-			for (SceneGroup& group : groups)
-			{
-				for (const auto& scene : group.scenes)
-				{
-					if (scene->Contains(object))
-						return { scene.get(), &group };
-				}
-			}
-			return {};
+			Scene* scene = ObjectAllocator::GetScene(object);
+			return { scene, scene->group };
 		}
 
 	public:
 		UniqueSceneHandle NewScene()
 		{
+			std::scoped_lock lock{ registryMutex };
 			scenes.push_back(std::make_unique<Scene>(Scene::Key{}));
+			scenes.back()->group = this;
 			return { scenes.back().get(), {} };
 		}
 
 		void DeleteScene(Scene* scene)
 		{
-			std::erase_if(scenes, [=](const auto& s) { return s.get() == scene; });
+			std::unique_ptr<Scene> removed;
+			{
+				std::scoped_lock lock{ registryMutex };
+				auto it = std::find_if(scenes.begin(), scenes.end(), [=](const auto& s) { return s.get() == scene; });
+				if(it == scenes.end())
+					return;
+
+				removed = std::move(*it);
+				scenes.erase(it);
+			}
+		}
+
+		//Moves a scene from whichever group owns it into this one, object pointers stay valid
+		UniqueSceneHandle AdoptScene(UniqueSceneHandle scene)
+		{
+			SceneGroup* owner = GetGroup(scene.get());
+			if(owner == this)
+				return scene;
+
+			std::scoped_lock lock{ registryMutex };
+			auto it = std::find_if(owner->scenes.begin(), owner->scenes.end(), [&](const auto& s) { return s.get() == scene.get(); });
+			scenes.push_back(std::move(*it));
+			owner->scenes.erase(it);
+			scenes.back()->group = this;
+			return { scene.release(), {} };
 		}
 
 		bool Contains(Scene* scene) const
 		{
-			return std::find_if(scenes.begin(), scenes.end(), [=](const auto& s) { return s.get() == scene; }) != scenes.end();
+			return scene->group == this;
 		}
 
 		std::span<const std::unique_ptr<Scene>> GetScenes() const { return scenes; }
+
+		//Scene::ParallelForEach over every scene in the group, chunks from all scenes share the same parallel for
+		template<std::derived_from<GameObject> Ty, class Func>
+		void ParallelForEach(Func&& func, JobSystem& jobs);
 	};
 
 	export class SceneLifetimeScopeLock
@@ -757,12 +1878,310 @@ namespace InsanityFramework
 			scene.LockLifetimes();
 		}
 
+		SceneLifetimeScopeLock(const SceneLifetimeScopeLock&) = delete;
+		SceneLifetimeScopeLock& operator=(const SceneLifetimeScopeLock&) = delete;
+
 		~SceneLifetimeScopeLock()
 		{
 			scene.UnlockLifetimes();
 		}
 	};
 
+	//Makes scene the thread's active scene and puts the previous one back at the end of the scope
+	export class ActiveSceneScope
+	{
+	private:
+		Scene* previousScene;
+
+	public:
+		ActiveSceneScope(Scene* scene) :
+			previousScene{ Scene::ExchangeActiveScene(scene) }
+		{
+		}
+
+		ActiveSceneScope(const ActiveSceneScope&) = delete;
+		ActiveSceneScope& operator=(const ActiveSceneScope&) = delete;
+
+		~ActiveSceneScope()
+		{
+			Scene::ExchangeActiveScene(previousScene);
+		}
+	};
+
+	struct ParallelSceneIteration
+	{
+		//8 KiB of object pointers per chunk
+		static constexpr std::size_t chunkSize = 1024;
+
+		template<std::derived_from<GameObject> Ty, class Func>
+		static void Run(std::span<Scene* const> scenes, Func& func, JobSystem& jobs)
+		{
+			struct Chunk
+			{
+				Scene* scene;
+				ExactObjectIterator<Ty> begin;
+				std::size_t count;
+			};
+
+			//Unlocking plays the recorded commands, also when func throws. A list since the locks can't move
+			std::list<SceneLifetimeScopeLock> lifetimeLocks;
+			std::vector<Chunk> chunks;
+			for(Scene* scene : scenes)
+			{
+				lifetimeLocks.emplace_back(*scene);
+
+				ExactObjectRange<Ty> range{ scene };
+				if(range.begin() == range.end())
+					continue;
+
+				const std::size_t count = static_cast<std::size_t>(range.end() - range.begin());
+				for(std::size_t i = 0; i < count; i += chunkSize)
+					chunks.push_back({ scene, range.begin() + static_cast<std::ptrdiff_t>(i), (std::min)(chunkSize, count - i) });
+			}
+
+			//A chunk is only run by one thread, so keying its commands by chunk gives the same order no matter the thread count
+			auto runChunk = [&](std::size_t chunkIndex)
+			{
+				const Chunk& chunk = chunks[chunkIndex];
+				//Pool workers have no active scene of their own, the chunk's scene is active while it runs
+				ActiveSceneScope activeScope{ chunk.scene };
+				SceneCommands& commands = chunk.scene->GetThreadCommands();
+				SceneCommands::SortKeyScope sortKey{ commands, chunkIndex };
+				for(std::size_t i = 0; i < chunk.count; i++)
+				{
+					Ty& object = chunk.begin[static_cast<std::ptrdiff_t>(i)];
+					if constexpr(std::invocable<Func&, Ty&, SceneCommands&>)
+						func(object, commands);
+					else
+						func(object);
+				}
+			};
+
+			if(jobs.IsParticipant())
+			{
+				jobs.ParallelFor(chunks.size(), [&](std::size_t begin, std::size_t end)
+				{
+					for(std::size_t chunkIndex = begin; chunkIndex < end; chunkIndex++)
+						runChunk(chunkIndex);
+				}, 1);
+			}
+			else
+			{
+				for(std::size_t chunkIndex = 0; chunkIndex < chunks.size(); chunkIndex++)
+					runChunk(chunkIndex);
+			}
+		}
+	};
+
+	//Non owning reference to an object which can tell if the object has been destroyed. Made of a slot in the
+	//scene's handle table and the generation the slot had when the object was made, so Get is a single table lookup.
+	//Handles only resolve in the object's scene, anywhere else they return nullptr like a dead handle.
+	//Making and resolving handles doesn't modify anything so both are safe from parallel systems
+	template<std::derived_from<Object> Ty>
+	class WeakObject
+	{
+		template<std::derived_from<Object> Other>
+		friend class WeakObject;
+
+	private:
+		std::uint32_t slot = 0;
+		std::uint32_t generation = 0;
+
+	public:
+		WeakObject() = default;
+
+		WeakObject(Ty* object) noexcept
+		{
+			if(object)
+			{
+				slot = static_cast<const Object*>(object)->handleSlot;
+				generation = static_cast<const Object*>(object)->handleGeneration;
+			}
+		}
+
+		template<std::derived_from<Ty> Other>
+		WeakObject(const WeakObject<Other>& other) noexcept :
+			slot{ other.slot },
+			generation{ other.generation }
+		{
+
+		}
+
+	public:
+		//The object if it is still alive in the active scene
+		//Resolves in the calling thread's active scene, nullptr on threads without one
+		Ty* Get() const noexcept
+		{
+			return Get(Scene::GetActiveScene());
+		}
+
+		Ty* Get(const Scene* scene) const noexcept
+		{
+			if(!scene)
+				return nullptr;
+			return static_cast<Ty*>(scene->ResolveHandle(slot, generation));
+		}
+
+		//Whether the handle was made from an object, not whether it is still alive
+		bool IsNull() const noexcept { return generation == 0; }
+
+		template<class Other>
+		bool operator==(const WeakObject<Other>& other) const noexcept
+		{
+			return slot == other.slot && generation == other.generation;
+		}
+	};
+
+	//Keeps released objects of Ty out of the scene for reuse instead of deleting them. A spawn from the pool calls
+	//Reset(args...) on a kept object rather than constructing one, then adds it back like a new object: it gets a fresh
+	//bucket slot and handle slot, but the bucket is looked up once per pool so a spawn doesn't search the type map.
+	//Released objects are out of every query, their handles are dead and listeners hear about them as destroyed,
+	//and as created on the next spawn. Releases beyond the capacity are deleted. Scenes with pools can't be snapshotted
+	template<std::derived_from<GameObject> Ty>
+	class ObjectPool : public SceneSystem, private ObjectRecycler
+	{
+	private:
+		Scene* scene = Scene::GetActiveScene();
+		ObjectBucket* bucket = &scene->GetBucket(GetTypeID<Ty>());
+		std::vector<Ty*> kept;
+		std::size_t capacity;
+
+	public:
+		ObjectPool(std::size_t capacity) :
+			capacity{ capacity }
+		{
+			kept.reserve(capacity);
+			scene->recyclers.push_back(this);
+		}
+
+		ObjectPool(const ObjectPool&) = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+
+		~ObjectPool() override
+		{
+			if(!scene)
+				return;
+
+			std::erase(scene->recyclers, static_cast<ObjectRecycler*>(this));
+			DeleteKept();
+		}
+
+	public:
+		//Makes objects from args until count are kept, for example while a scene loads, and reserves
+		//room for them in the scene so spawning them later doesn't grow anything
+		template<class... Args>
+		void Prewarm(std::size_t count, const Args&... args)
+		{
+			count = (std::min)(count, capacity);
+			const std::size_t active = bucket->objects.size();
+			bucket->objects.reserve(active + count);
+			bucket->layers.reserve(active + count);
+			bucket->tags.reserve(active + count);
+
+			while(kept.size() < count)
+				kept.push_back(scene->allocator.New<Ty>(args...));
+		}
+
+		//Reuses a kept object or makes a new one from args when the pool is empty
+		template<class... Args>
+			requires requires(Ty& object, Args&&... args) { object.Reset(std::forward<Args>(args)...); }
+		Ty* Spawn(Args&&... args)
+		{
+			Ty* object;
+			if(kept.empty())
+			{
+				object = scene->allocator.New<Ty>(std::forward<Args>(args)...);
+			}
+			else
+			{
+				object = kept.back();
+				kept.pop_back();
+				object->Reset(std::forward<Args>(args)...);
+			}
+
+			scene->AddObject(object, *bucket);
+			return object;
+		}
+
+		//Takes the object out of the scene and keeps it for a later Spawn, with the next flush if lifetimes are locked
+		void Release(Ty* object)
+		{
+			if(scene->lifetimeLockCounter == 0)
+				scene->RecycleObject(object, *this);
+			else
+				scene->queuedRecycling.push_back({ object, this });
+		}
+
+		//Deletes kept objects over the new capacity
+		void SetCapacity(std::size_t newCapacity)
+		{
+			capacity = newCapacity;
+			while(kept.size() > capacity)
+			{
+				ObjectAllocator::Delete(kept.back());
+				kept.pop_back();
+			}
+		}
+
+		std::size_t Capacity() const noexcept { return capacity; }
+		std::size_t KeptCount() const noexcept { return kept.size(); }
+
+	private:
+		void Recycle(Object* object) override
+		{
+			Ty* released = static_cast<Ty*>(object);
+			released->Detach();
+			if(kept.size() < capacity)
+				kept.push_back(released);
+			else
+				ObjectAllocator::Delete(released);
+		}
+
+		void DeleteKept() override
+		{
+			for(Ty* object : kept)
+				ObjectAllocator::Delete(object);
+			kept.clear();
+			scene = nullptr;
+		}
+	};
+
+	void ObjectReclaimer::Run()
+	{
+		std::vector<Work> batch;
+		std::vector<void*> allocations;
+		while(true)
+		{
+			{
+				std::unique_lock lock{ mutex };
+				wake.wait(lock, [&] { return stopping || !queue.empty(); });
+				if(queue.empty())
+					return;
+				batch.swap(queue);
+			}
+			space.notify_all();
+
+			for(const Work& work : batch)
+				Scene::RunDestructor(work.object);
+
+			//Handed back per run of the same scene, work is queued a scene at a time
+			for(std::size_t begin = 0; begin < batch.size();)
+			{
+				std::size_t end = begin + 1;
+				while(end < batch.size() && batch[end].scene == batch[begin].scene)
+					end++;
+
+				allocations.clear();
+				for(std::size_t i = begin; i < end; i++)
+					allocations.push_back(batch[i].allocation);
+				batch[begin].scene->CompleteReclaims(allocations);
+
+				begin = end;
+			}
+			batch.clear();
+		}
+	}
+
 	void SceneHandleDeleter::operator()(Scene* scene)
 	{
 		SceneGroup::GetGroup(scene)->DeleteScene(scene);
@@ -775,7 +2194,7 @@ namespace InsanityFramework
 
 	template<class Ty>
 	ExactObjectRange<Ty>::ExactObjectRange(const Scene* scene) :
-		objects{ scene->gameObjects.contains(typeid(Ty)) ? &scene->gameObjects.at(typeid(Ty)) : nullptr },
+		objects{ [&]() -> const std::vector<Object*>* { auto bucket = scene->gameObjects.Find(GetTypeID<Ty>()); return bucket ? &bucket->objects : nullptr; }() },
 		offset{ objects && !objects->empty() ? OffsetOf(objects->front(), dynamic_cast<Ty*>(objects->front())) : 0  }
 	{
 	}
@@ -799,23 +2218,14 @@ namespace InsanityFramework
 	}
 
 	template<class Ty>
-	ObjectIterator<Ty>::ObjectIterator(const Scene* scene) :
-		currentMapIt{ scene->gameObjects.begin() },
-		endMapIt{ scene->gameObjects.end() }
+	ObjectIterator<Ty>::ObjectIterator(const Scene* scene)
 	{
-		for (; currentMapIt != endMapIt; currentMapIt++)
-		{
-			currentIt = currentMapIt->second.begin();
-			auto temp = dynamic_cast<Ty*>(*currentIt);
-			if (!temp)
-				continue;
-			
-			offset = OffsetOf(*currentIt, temp);
-			endIt = currentMapIt->second.end();
-
-			break;
-		}
+		matches = scene->GetSubtypeMatches(GetTypeID<Ty>(), [](Object* object) -> void* { return dynamic_cast<Ty*>(object); });
+		currentMatchIt = matches->begin();
+		endMatchIt = matches->end();
+		SkipEmptyMatches();
 	}
+
 	template<class Ty>
 	GlobalObjectIterator<Ty>::GlobalObjectIterator(const SceneGroup* sceneGroup) :
 		sceneItCurrent{ sceneGroup->GetScenes().begin() },
@@ -831,4 +2241,57 @@ namespace InsanityFramework
 				break;
 		}
 	}
+
+	template<std::derived_from<GameObject> Ty, class... Args>
+	PendingObject<Ty> SceneCommands::New(Args&&... args)
+	{
+		const PendingObject<Ty> pending{ static_cast<std::uint32_t>(created.size()) };
+		created.push_back(nullptr);
+
+		Record([index = pending.index, ...args = std::forward<Args>(args)](SceneCommands& commands) mutable
+		{
+			commands.created[index] = Scene::NewObject<Ty>(std::move(args)...).release();
+		});
+		return pending;
+	}
+
+	void SceneCommands::Delete(Object* object)
+	{
+		Record([object](SceneCommands&) { Scene::DeleteObject(object); });
+	}
+
+	template<class Ty>
+	void SceneCommands::Delete(PendingObject<Ty> object)
+	{
+		Record([object](SceneCommands& commands) { Scene::DeleteObject(commands.Resolve(object)); });
+	}
+
+	template<class Child, class Parent>
+	void SceneCommands::SetParent(Child child, Parent parent)
+	{
+		Record([child, parent](SceneCommands& commands) { ResolveNode(child, commands)->SetParent(ResolveNode(parent, commands)); });
+	}
+
+	template<std::derived_from<SceneSystem> Ty, class... Args>
+	void SceneCommands::AddSystem(Args&&... args)
+	{
+		Record([...args = std::forward<Args>(args)](SceneCommands&) mutable { Scene::AddSystem<Ty>(std::move(args)...); });
+	}
+
+	template<std::derived_from<GameObject> Ty, class Func>
+	void Scene::ParallelForEach(Func&& func, JobSystem& jobs)
+	{
+		Scene* scene = GetActiveScene();
+		ParallelSceneIteration::Run<Ty>(std::span<Scene* const>{ &scene, 1 }, func, jobs);
+	}
+
+	template<std::derived_from<GameObject> Ty, class Func>
+	void SceneGroup::ParallelForEach(Func&& func, JobSystem& jobs)
+	{
+		std::vector<Scene*> sceneList;
+		for(const auto& scene : scenes)
+			sceneList.push_back(scene.get());
+
+		ParallelSceneIteration::Run<Ty>(sceneList, func, jobs);
+	}
 }
\ No newline at end of file
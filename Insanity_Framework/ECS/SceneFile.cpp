@@ -0,0 +1,60 @@
+module;
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <cstdint>
+#include <vector>
+#include <span>
+#include <fstream>
+#include <filesystem>
+#include <exception>
+
+module InsanityFramework.ECS.SceneFile;
+
+namespace InsanityFramework
+{
+	void SceneFileWriter::WriteFile(const std::filesystem::path& path, Scene* scene, const SceneFileTypes& types)
+	{
+		const std::vector<std::byte> file = Write(scene, types);
+
+		std::ofstream stream{ path, std::ios::binary | std::ios::trunc };
+		if(!stream.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size())))
+			throw std::exception("Failed to write scene file");
+	}
+
+	MappedSceneFile::MappedSceneFile(const std::filesystem::path& path)
+	{
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if(file == INVALID_HANDLE_VALUE)
+			throw std::exception("Failed to open scene file");
+		fileHandle = file;
+
+		LARGE_INTEGER fileSize;
+		if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			throw std::exception("Failed to read scene file");
+		}
+		size = static_cast<std::size_t>(fileSize.QuadPart);
+
+		mappingHandle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(mappingHandle)
+			data = static_cast<const std::byte*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+
+		if(!data)
+		{
+			if(mappingHandle)
+				CloseHandle(mappingHandle);
+			CloseHandle(file);
+			throw std::exception("Failed to map scene file");
+		}
+	}
+
+	MappedSceneFile::~MappedSceneFile()
+	{
+		UnmapViewOfFile(data);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+	}
+}
@@ -0,0 +1,360 @@
+module;
+
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <vector>
+#include <span>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <typeindex>
+#include <concepts>
+#include <type_traits>
+#include <unordered_map>
+#include <filesystem>
+#include <exception>
+#include <utility>
+
+export module InsanityFramework.ECS.SceneFile;
+import InsanityFramework.ECS.Scene;
+import xk.Math;
+
+namespace InsanityFramework
+{
+	export class SceneFileView;
+	export class SceneFileWriter;
+
+	//Types stored in scene files keep their state in a trivially copyable SceneData struct.
+	//The file holds one packed array of SceneData per type which objects are constructed from in place
+	export template<class Ty>
+	concept SceneFileObject = std::derived_from<Ty, GameObject> &&
+		std::is_trivially_copyable_v<typename Ty::SceneData> &&
+		std::constructible_from<Ty, Object::Key, const typename Ty::SceneData&> &&
+		requires(const Ty& object)
+		{
+			{ object.GetSceneData() } -> std::convertible_to<typename Ty::SceneData>;
+		};
+
+	//Layout of the file, every offset is from the start of the file.
+	//Header, type table, object records, then each type's SceneData array aligned to the type's alignment
+	struct SceneFileHeader
+	{
+		static constexpr std::uint32_t magic = 0x4E435349; //"ISCN"
+		static constexpr std::uint32_t currentVersion = 1;
+
+		std::uint32_t fileMagic;
+		std::uint32_t version;
+		std::uint32_t typeCount;
+		std::uint32_t objectCount;
+		std::uint64_t typeTableOffset;
+		std::uint64_t recordsOffset;
+		std::uint64_t fileSize;
+	};
+
+	struct SceneFileTypeEntry
+	{
+		static constexpr std::size_t maxNameLength = 63;
+
+		char name[maxNameLength + 1];
+		std::uint32_t dataSize;
+		std::uint32_t dataAlign;
+		//Records of a type are contiguous and in the same order as its SceneData array
+		std::uint32_t firstRecord;
+		std::uint32_t objectCount;
+		std::uint64_t dataOffset;
+	};
+
+	struct SceneFileRecord
+	{
+		static constexpr std::uint32_t noParent = ~0u;
+
+		std::uint32_t type;
+		//Record index of the parent, the transform is in world space when there is none
+		std::uint32_t parent;
+		float position[3];
+		float rotation;
+		float scale[3];
+	};
+
+	static_assert(std::is_trivially_copyable_v<SceneFileHeader> && std::is_trivially_copyable_v<SceneFileTypeEntry> && std::is_trivially_copyable_v<SceneFileRecord>);
+
+	//Maps the names stored in scene files to object types. Names must stay the same across builds for old files to load
+	export class SceneFileTypes
+	{
+		friend SceneFileView;
+		friend SceneFileWriter;
+
+		struct Entry
+		{
+			std::string name;
+			std::uint32_t dataSize;
+			std::uint32_t dataAlign;
+			void(*collect)(Scene* scene, std::vector<GameObject*>& output);
+			void(*writeData)(const GameObject* object, std::byte* output);
+			void(*construct)(const std::byte* data, std::size_t count, std::vector<GameObject*>& output);
+		};
+
+		std::vector<Entry> entries;
+		std::unordered_map<std::string_view, std::size_t> byName;
+		std::unordered_map<std::type_index, std::size_t> byType;
+
+	public:
+		template<SceneFileObject Ty>
+		void Register(std::string_view name)
+		{
+			using Data = typename Ty::SceneData;
+
+			if(name.size() > SceneFileTypeEntry::maxNameLength)
+				throw std::exception("Scene file type name is too long");
+			if(byType.contains(typeid(Ty)))
+				throw std::exception("Type already registered");
+
+			entries.push_back(
+			{
+				std::string{ name },
+				static_cast<std::uint32_t>(sizeof(Data)),
+				static_cast<std::uint32_t>(alignof(Data)),
+				[](Scene* scene, std::vector<GameObject*>& output)
+				{
+					for(Ty* object : Scene::GetObjectsExactTypeInScene<Ty>(scene))
+					{
+						if(object->IsRoot())
+							output.push_back(object);
+					}
+				},
+				[](const GameObject* object, std::byte* output)
+				{
+					const Data data = static_cast<const Ty*>(object)->GetSceneData();
+					std::memcpy(output, &data, sizeof(Data));
+				},
+				[](const std::byte* data, std::size_t count, std::vector<GameObject*>& output)
+				{
+					const Data* first = reinterpret_cast<const Data*>(data);
+					for(std::size_t i = 0; i < count; i++)
+						output.push_back(Scene::NewObject<Ty>(first[i]).release());
+				}
+			});
+
+			//Rebuilt as the string_views point into entries
+			byName.clear();
+			for(std::size_t i = 0; i < entries.size(); i++)
+				byName.insert({ entries[i].name, i });
+			byType.insert({ typeid(Ty), entries.size() - 1 });
+		}
+
+		//Index of the registered type of object, throws if its exact type wasn't registered
+		std::size_t IndexOf(const GameObject& object) const
+		{
+			auto it = byType.find(typeid(object));
+			if(it == byType.end())
+				throw std::exception("Object type isn't registered");
+			return it->second;
+		}
+
+		std::size_t DataSize(std::size_t type) const noexcept { return entries[type].dataSize; }
+
+		void WriteData(std::size_t type, const GameObject* object, std::byte* output) const
+		{
+			entries[type].writeData(object, output);
+		}
+
+		//Constructs count objects of the type in the active scene from a packed SceneData array
+		void Construct(std::size_t type, const std::byte* data, std::size_t count, std::vector<GameObject*>& output) const
+		{
+			entries[type].construct(data, count, output);
+		}
+	};
+
+	//Snapshots the root objects of registered types in a scene. Objects owned through UniqueObject members
+	//are left out as their owner recreates them, parents outside the file are dropped and world transforms kept
+	export class SceneFileWriter
+	{
+	public:
+		static std::vector<std::byte> Write(Scene* scene, const SceneFileTypes& types)
+		{
+			std::vector<std::vector<GameObject*>> objectsByType(types.entries.size());
+			std::unordered_map<const TransformNode*, std::uint32_t> recordIndices;
+			std::uint32_t objectCount = 0;
+			for(std::size_t type = 0; type < types.entries.size(); type++)
+			{
+				types.entries[type].collect(scene, objectsByType[type]);
+				for(GameObject* object : objectsByType[type])
+					recordIndices.insert({ object, objectCount++ });
+			}
+
+			SceneFileHeader header{ SceneFileHeader::magic, SceneFileHeader::currentVersion, static_cast<std::uint32_t>(types.entries.size()), objectCount };
+			header.typeTableOffset = sizeof(SceneFileHeader);
+			header.recordsOffset = header.typeTableOffset + sizeof(SceneFileTypeEntry) * header.typeCount;
+
+			std::vector<SceneFileTypeEntry> typeTable(header.typeCount);
+			std::uint64_t offset = header.recordsOffset + sizeof(SceneFileRecord) * objectCount;
+			std::uint32_t firstRecord = 0;
+			for(std::size_t type = 0; type < types.entries.size(); type++)
+			{
+				const SceneFileTypes::Entry& entry = types.entries[type];
+				SceneFileTypeEntry& output = typeTable[type];
+				std::memcpy(output.name, entry.name.c_str(), entry.name.size() + 1);
+				output.dataSize = entry.dataSize;
+				output.dataAlign = entry.dataAlign;
+				output.firstRecord = firstRecord;
+				output.objectCount = static_cast<std::uint32_t>(objectsByType[type].size());
+				output.dataOffset = (offset + entry.dataAlign - 1) / entry.dataAlign * entry.dataAlign;
+
+				offset = output.dataOffset + std::uint64_t{ entry.dataSize } * output.objectCount;
+				firstRecord += output.objectCount;
+			}
+			header.fileSize = offset;
+
+			std::vector<std::byte> file(static_cast<std::size_t>(header.fileSize));
+			std::memcpy(file.data(), &header, sizeof(header));
+			std::memcpy(file.data() + header.typeTableOffset, typeTable.data(), sizeof(SceneFileTypeEntry) * typeTable.size());
+
+			std::byte* records = file.data() + header.recordsOffset;
+			for(std::size_t type = 0; type < types.entries.size(); type++)
+			{
+				const SceneFileTypeEntry& tableEntry = typeTable[type];
+				for(std::size_t i = 0; i < objectsByType[type].size(); i++)
+				{
+					GameObject* object = objectsByType[type][i];
+					auto parent = recordIndices.find(object->GetParent());
+					const bool hasParent = parent != recordIndices.end();
+					const Transform transform = hasParent ? object->LocalTransform().Get() : object->WorldTransform().Get();
+
+					const SceneFileRecord record
+					{
+						static_cast<std::uint32_t>(type),
+						hasParent ? parent->second : SceneFileRecord::noParent,
+						{ transform.position.X(), transform.position.Y(), transform.position.Z() },
+						transform.rotation._value,
+						{ transform.scale.X(), transform.scale.Y(), transform.scale.Z() }
+					};
+					std::memcpy(records + sizeof(SceneFileRecord) * (tableEntry.firstRecord + i), &record, sizeof(record));
+
+					types.entries[type].writeData(object, file.data() + tableEntry.dataOffset + std::size_t{ tableEntry.dataSize } * i);
+				}
+			}
+
+			return file;
+		}
+
+		static void WriteFile(const std::filesystem::path& path, Scene* scene, const SceneFileTypes& types);
+	};
+
+	//Reads a scene file in place, usually a MappedSceneFile. Only the header is validated up front,
+	//objects are constructed straight out of the SceneData arrays without copying or parsing them
+	export class SceneFileView
+	{
+		std::span<const std::byte> file;
+
+	public:
+		SceneFileView(std::span<const std::byte> file) :
+			file{ file }
+		{
+			if(file.size() < sizeof(SceneFileHeader))
+				throw std::exception("Scene file is truncated");
+
+			const SceneFileHeader& header = Header();
+			if(header.fileMagic != SceneFileHeader::magic)
+				throw std::exception("Not a scene file");
+			if(header.version != SceneFileHeader::currentVersion)
+				throw std::exception("Unsupported scene file version");
+			if(header.fileSize != file.size() ||
+				header.typeTableOffset + sizeof(SceneFileTypeEntry) * header.typeCount > file.size() ||
+				header.recordsOffset + sizeof(SceneFileRecord) * header.objectCount > file.size())
+				throw std::exception("Scene file is truncated");
+		}
+
+		std::size_t ObjectCount() const noexcept { return Header().objectCount; }
+
+		//Creates every object in the active scene and returns them in file order.
+		//Registration and OnObjectsCreated happen once per type when construction is done
+		std::vector<GameObject*> Instantiate(const SceneFileTypes& types) const
+		{
+			const SceneFileHeader& header = Header();
+			std::span<const SceneFileTypeEntry> typeTable{ reinterpret_cast<const SceneFileTypeEntry*>(file.data() + header.typeTableOffset), header.typeCount };
+			std::span<const SceneFileRecord> records{ reinterpret_cast<const SceneFileRecord*>(file.data() + header.recordsOffset), header.objectCount };
+
+			std::vector<const SceneFileTypes::Entry*> entries;
+			entries.reserve(typeTable.size());
+			//Types cover the records back to back, so constructing them in order fills objects in record order
+			std::uint64_t nextRecord = 0;
+			for(const SceneFileTypeEntry& type : typeTable)
+			{
+				auto it = types.byName.find(std::string_view{ type.name, strnlen(type.name, sizeof(type.name)) });
+				if(it == types.byName.end())
+					throw std::exception("Scene file uses an unregistered type");
+
+				const SceneFileTypes::Entry& entry = types.entries[it->second];
+				if(entry.dataSize != type.dataSize || entry.dataAlign != type.dataAlign)
+					throw std::exception("Scene file type layout doesn't match");
+				if(type.dataOffset % type.dataAlign != 0 ||
+					type.dataOffset + std::uint64_t{ type.dataSize } * type.objectCount > file.size() ||
+					type.firstRecord != nextRecord)
+					throw std::exception("Scene file is truncated");
+
+				nextRecord += type.objectCount;
+				entries.push_back(&entry);
+			}
+			if(nextRecord != header.objectCount)
+				throw std::exception("Scene file is truncated");
+
+			for(const SceneFileRecord& record : records)
+			{
+				if(record.type >= typeTable.size() || (record.parent != SceneFileRecord::noParent && record.parent >= records.size()))
+					throw std::exception("Scene file is corrupt");
+			}
+
+			Scene* scene = Scene::GetActiveScene();
+			std::vector<GameObject*> objects;
+			objects.reserve(header.objectCount);
+
+			SceneLifetimeScopeLock lifetimeLock{ *scene };
+			for(std::size_t type = 0; type < typeTable.size(); type++)
+			{
+				entries[type]->construct(file.data() + typeTable[type].dataOffset, typeTable[type].objectCount, objects);
+			}
+
+			for(std::size_t i = 0; i < records.size(); i++)
+			{
+				const SceneFileRecord& record = records[i];
+				GameObject* object = objects[i];
+				if(record.parent != SceneFileRecord::noParent)
+					object->SetParent(objects[record.parent]);
+
+				object->LocalTransform() = Transform
+				{
+					{ record.position[0], record.position[1], record.position[2] },
+					xk::Math::Degree<float>{ record.rotation },
+					{ record.scale[0], record.scale[1], record.scale[2] }
+				};
+			}
+
+			return objects;
+		}
+
+	private:
+		const SceneFileHeader& Header() const noexcept
+		{
+			return *reinterpret_cast<const SceneFileHeader*>(file.data());
+		}
+	};
+
+	//Read only memory mapping of a file, the pages are only read in as objects are constructed from them
+	export class MappedSceneFile
+	{
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+		const std::byte* data = nullptr;
+		std::size_t size = 0;
+
+	public:
+		MappedSceneFile(const std::filesystem::path& path);
+		MappedSceneFile(const MappedSceneFile&) = delete;
+		MappedSceneFile& operator=(const MappedSceneFile&) = delete;
+		~MappedSceneFile();
+
+	public:
+		SceneFileView GetView() const { return { std::span{ data, size } }; }
+	};
+}
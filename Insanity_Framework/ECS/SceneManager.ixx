@@ -5,23 +5,40 @@ module;
 #include <tuple>
 #include <memory>
 #include <functional>
-#include <unordered_map>
-#include <typeindex>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <exception>
 
 export module InsanityFramework.ECS.SceneManager;
 export import InsanityFramework.ECS.Scene;
 import InsanityFramework.ECS.SceneGlobals;
 import InsanityFramework.AnyRef;
+import InsanityFramework.TypeID;
 
 namespace InsanityFramework
 {
+	export class SceneManager;
 	export class SceneLoader
 	{
+		friend SceneManager;
+
+		inline static thread_local std::atomic<float>* currentProgress = nullptr;
+
 	public:
 		virtual ~SceneLoader() = default;
 
 	public:
 		virtual void Unload() = 0;
+
+	protected:
+		//How far Load is in [0, 1], only observed for scenes loaded asynchronously
+		static void ReportProgress(float progress)
+		{
+			if(currentProgress)
+				currentProgress->store(progress, std::memory_order_relaxed);
+		}
 	};
 
 	export template<class Ty, class... Args>
@@ -99,11 +116,11 @@ namespace InsanityFramework
 		std::size_t count = 0;
 	};
 
-	export class SceneManager;
 	export struct SceneManagerCallbacks
 	{
 		virtual void OnSceneRequestLoad(SceneManager& manager, Scene& scene) {}
 		virtual void OnSceneRequestProgress(SceneManager& manager, Scene& scene) {}
+		virtual void OnSceneLoadProgress(SceneManager& manager, Scene& scene, float progress) {}
 		virtual void OnSceneRequestStopProgress(SceneManager& manager, Scene& scene) {}
 		virtual void OnSceneLoadComplete(SceneManager& manager, Scene& scene) {}
 		virtual void OnSceneRequestUnload(SceneManager& manager, Scene& scene) {}
@@ -132,11 +149,53 @@ namespace InsanityFramework
 			}
 		};
 
+	private:
+		//A scene being loaded on a background thread. It stays in the staging group with its lifetimes locked,
+		//so nothing is registered or announced until it is committed on the main thread
+		struct AsyncSceneLoad
+		{
+			LoadedSceneResult::Type type;
+			SceneLoadPayload payload;
+			UniqueSceneHandle scene;
+			std::unique_ptr<SceneLoader> loader;
+			std::exception_ptr error;
+			std::atomic<float> progress = 0;
+			std::atomic<bool> done = false;
+			float reportedProgress = 0;
+			std::jthread thread;
+
+			AsyncSceneLoad(LoadedSceneResult::Type type, SceneLoadPayload payload, UniqueSceneHandle scene) :
+				type{ type },
+				payload{ std::move(payload) },
+				scene{ std::move(scene) }
+			{
+
+			}
+
+			~AsyncSceneLoad()
+			{
+				if(thread.joinable())
+					thread.join();
+
+				if(scene)
+				{
+					Scene* previousScene = std::exchange(activeScene, scene.get());
+					if(loader)
+						loader->Unload();
+					scene->UnlockLifetimes();
+					scene = nullptr;
+					activeScene = previousScene;
+				}
+			}
+		};
+
 	private:
 		UniqueSceneGroupHandle sceneGroup = SceneGroup::New();
+		UniqueSceneGroupHandle stagingGroup = SceneGroup::New();
 		std::vector<LoadedScenes> scenes;
 		std::optional<SceneLoadPayload> pendingSceneLoad;
 		std::vector<SceneLoadPayload> pendingSubscenesLoad;
+		std::vector<std::unique_ptr<AsyncSceneLoad>> asyncLoads;
 
 	public:
 		SceneManagerCallbacks* callbacks = &defaultSceneManagerCallback;
@@ -158,6 +217,61 @@ namespace InsanityFramework
 			pendingSubscenesLoad.push_back(SceneLoadPayload{ std::type_identity<Ty>{}, std::forward<Args>(args)... });
 		}
 
+		//Starts loading the scene on a background thread, UpdateLoadingScenes swaps it in once it is done.
+		//The current scenes keep running until then
+		template<class Ty, class... Args>
+			requires IsSceneLoader<Ty, Args...>
+		void LoadSceneAsync(Args&&... args)
+		{
+			StartAsyncLoad(LoadedSceneResult::Type::Scene, SceneLoadPayload{ std::type_identity<Ty>{}, std::forward<Args>(args)... });
+		}
+
+		//Subscenes load concurrently with each other but are committed in the order they were requested
+		template<class Ty, class... Args>
+			requires IsSceneLoader<Ty, Args...>
+		void LoadSubsceneAsync(Args&&... args)
+		{
+			const bool mainSceneLoading = std::any_of(asyncLoads.begin(), asyncLoads.end(), [](const auto& load) { return load->type == LoadedSceneResult::Type::Scene; });
+			if(scenes.empty() && !mainSceneLoading)
+				throw std::exception("Can't load subscenes without a main scene");
+			StartAsyncLoad(LoadedSceneResult::Type::Subscene, SceneLoadPayload{ std::type_identity<Ty>{}, std::forward<Args>(args)... });
+		}
+
+		//Call once per frame from the main thread. Reports progress and commits finished loads in request order
+		//until budget is spent, at least one commit is made per call so loading always moves forward.
+		//A loader's exception is rethrown here when its scene would have been committed
+		std::optional<LoadedSceneResult> UpdateLoadingScenes(std::chrono::microseconds budget)
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			for(auto& load : asyncLoads)
+			{
+				const float progress = load->progress.load(std::memory_order_relaxed);
+				if(progress != load->reportedProgress)
+				{
+					load->reportedProgress = progress;
+					callbacks->OnSceneLoadProgress(*this, *load->scene, progress);
+				}
+			}
+
+			std::optional<LoadedSceneResult> result;
+			while(!asyncLoads.empty() && asyncLoads.front()->done.load(std::memory_order_acquire))
+			{
+				if(result && (result->type != asyncLoads.front()->type || std::chrono::steady_clock::now() - start >= budget))
+					break;
+
+				std::unique_ptr<AsyncSceneLoad> load = std::move(asyncLoads.front());
+				asyncLoads.erase(asyncLoads.begin());
+				CommitAsyncLoad(*load);
+
+				if(!result)
+					result = LoadedSceneResult{ load->type };
+				result->count++;
+			}
+
+			return result;
+		}
+
 		std::optional<LoadedSceneResult> WaitForLoadingScenes()
 		{
 			if(pendingSceneLoad)
@@ -205,7 +319,7 @@ namespace InsanityFramework
 			return std::nullopt;
 		}
 
-		bool HasAnySceneLoading() const noexcept { return pendingSceneLoad || !pendingSubscenesLoad.empty(); }
+		bool HasAnySceneLoading() const noexcept { return pendingSceneLoad || !pendingSubscenesLoad.empty() || !asyncLoads.empty(); }
 
 		Scene* GetScene() { return scenes.front().scene.get(); }
 		const Scene* GetScene() const { return scenes.front().scene.get(); }
@@ -216,6 +330,60 @@ namespace InsanityFramework
 		std::size_t GetSubsceneCount() const { return scenes.size() - 1; }
 
 	private:
+		void StartAsyncLoad(LoadedSceneResult::Type type, SceneLoadPayload payload)
+		{
+			auto& load = *asyncLoads.emplace_back(std::make_unique<AsyncSceneLoad>(type, std::move(payload), stagingGroup->NewScene()));
+			load.scene->LockLifetimes();
+
+			callbacks->OnSceneRequestLoad(*this, *load.scene);
+			callbacks->OnSceneRequestProgress(*this, *load.scene);
+
+			load.thread = std::jthread{ [&load]
+			{
+				activeScene = load.scene.get();
+				SceneLoader::currentProgress = &load.progress;
+				try
+				{
+					load.loader = load.payload.Load(load.scene.get());
+				}
+				catch(...)
+				{
+					load.error = std::current_exception();
+				}
+				SceneLoader::currentProgress = nullptr;
+				activeScene = nullptr;
+
+				load.done.store(true, std::memory_order_release);
+			} };
+		}
+
+		void CommitAsyncLoad(AsyncSceneLoad& load)
+		{
+			load.thread.join();
+
+			if(load.error)
+			{
+				callbacks->OnSceneRequestStopProgress(*this, *load.scene);
+				std::rethrow_exception(load.error);
+			}
+
+			if(load.type == LoadedSceneResult::Type::Scene)
+				UnloadAllScenes();
+
+			LoadedScenes newScene = { sceneGroup->AdoptScene(std::move(load.scene)) };
+			newScene.loader = std::move(load.loader);
+
+			//Registers everything the loader created and announces it in batches
+			activeScene = newScene.scene.get();
+			newScene.scene->UnlockLifetimes();
+
+			callbacks->OnSceneRequestStopProgress(*this, *newScene.scene);
+			callbacks->OnSceneLoadComplete(*this, *newScene.scene);
+
+			scenes.push_back(std::move(newScene));
+			activeScene = GetScene();
+		}
+
 		void UnloadAllScenes()
 		{
 			while(!scenes.empty())
@@ -261,26 +429,26 @@ namespace InsanityFramework
 		}
 	};
 
-	void InternalRegisterGlobalSystem(std::type_index index, AnyRef system);
-	void InternalUnregisterGlobalSystem(std::type_index index);
-	AnyRef InternalGetGlobalSystem(std::type_index index);
+	void InternalRegisterGlobalSystem(TypeID type, AnyRef system);
+	void InternalUnregisterGlobalSystem(TypeID type);
+	AnyRef InternalGetGlobalSystem(TypeID type);
 
 	export template<class Ty>
 		void RegisterGlobalSystem(Ty& system)
 	{
-		InternalRegisterGlobalSystem(typeid(Ty), system);
+		InternalRegisterGlobalSystem(GetTypeID<Ty>(), system);
 	}
 
 	export template<class Ty>
 		void UnregisterGlobalSystem()
 	{
-		InternalUnregisterGlobalSystem(typeid(Ty));
+		InternalUnregisterGlobalSystem(GetTypeID<Ty>());
 	}
 
 	export template<class Ty>
 		Ty& GetGlobalSystem()
 	{
-		return InternalGetGlobalSystem(typeid(Ty)).As<Ty>();
+		return InternalGetGlobalSystem(GetTypeID<Ty>()).As<Ty>();
 	}
 }
 
@@ -288,20 +456,20 @@ module:private;
 
 namespace InsanityFramework
 {
-	std::unordered_map<std::type_index, AnyRef> systems;
+	TypeMap<AnyRef> systems;
 
-	void InternalRegisterGlobalSystem(std::type_index index, AnyRef system)
+	void InternalRegisterGlobalSystem(TypeID type, AnyRef system)
 	{
-		systems.insert({ index, system });
+		systems.TryEmplace(type, system);
 	}
 
-	void InternalUnregisterGlobalSystem(std::type_index index)
+	void InternalUnregisterGlobalSystem(TypeID type)
 	{
-		systems.erase(index);
+		systems.Erase(type);
 	}
 
-	AnyRef InternalGetGlobalSystem(std::type_index index)
+	AnyRef InternalGetGlobalSystem(TypeID type)
 	{
-		return systems.at(index);
+		return systems.At(type);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,294 @@
+module;
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <span>
+#include <memory>
+#include <typeindex>
+#include <typeinfo>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <utility>
+
+export module InsanityFramework.ECS.SceneScheduler;
+import InsanityFramework.ECS.SceneGlobals;
+import InsanityFramework.Jobs;
+
+namespace InsanityFramework
+{
+	export class SceneScheduler;
+
+	//Phases run one after the other, systems within a phase run in parallel when their accesses don't conflict
+	export enum class UpdatePhase : std::uint8_t
+	{
+		Early,
+		Update,
+		Late,
+	};
+
+	//What a system touches during Update. Types are only used as keys, they can be components,
+	//object types or any tag type standing in for a resource such as the audio mixer
+	export class SystemAccess
+	{
+		friend SceneScheduler;
+
+	private:
+		UpdatePhase phase = UpdatePhase::Update;
+		bool exclusive = false;
+		std::vector<std::type_index> reads;
+		std::vector<std::type_index> writes;
+		std::vector<std::type_index> after;
+
+	public:
+		SystemAccess& Phase(UpdatePhase newPhase)
+		{
+			phase = newPhase;
+			return *this;
+		}
+
+		template<class Ty>
+		SystemAccess& Read()
+		{
+			reads.push_back(typeid(Ty));
+			return *this;
+		}
+
+		template<class Ty>
+		SystemAccess& Write()
+		{
+			writes.push_back(typeid(Ty));
+			return *this;
+		}
+
+		//Runs after the system of type Ty if it is in the same phase
+		template<class Ty>
+		SystemAccess& After()
+		{
+			after.push_back(typeid(Ty));
+			return *this;
+		}
+
+		//Runs alone, needed for systems which create or delete objects directly as scene structure isn't thread safe.
+		//Changes recorded through Scene::GetThreadCommands don't need it
+		SystemAccess& Exclusive()
+		{
+			exclusive = true;
+			return *this;
+		}
+
+	private:
+		static bool Intersects(const std::vector<std::type_index>& lh, const std::vector<std::type_index>& rh)
+		{
+			return std::any_of(lh.begin(), lh.end(), [&](const std::type_index& type) { return std::find(rh.begin(), rh.end(), type) != rh.end(); });
+		}
+
+		bool ConflictsWith(const SystemAccess& other) const
+		{
+			return exclusive || other.exclusive ||
+				Intersects(writes, other.writes) ||
+				Intersects(writes, other.reads) ||
+				Intersects(reads, other.writes);
+		}
+	};
+
+	export class ScheduledSystem : public SceneSystem
+	{
+	public:
+		virtual void DeclareAccess(SystemAccess& access) const = 0;
+		virtual void Update() = 0;
+	};
+
+	export struct ScheduleTraceEntry
+	{
+		const ScheduledSystem* system;
+		const char* name;
+		UpdatePhase phase;
+		std::size_t thread;
+		std::chrono::nanoseconds start;
+		std::chrono::nanoseconds end;
+	};
+
+	//Runs every ScheduledSystem of the scene it was added to. Conflicting systems run in the order they were added,
+	//the rest run in parallel on the job system. The graph is rebuilt whenever systems are added to the scene
+	export class SceneScheduler : public SceneSystem
+	{
+		struct Node
+		{
+			ScheduledSystem* system;
+			SystemAccess access;
+			std::vector<Node*> successors;
+			std::uint32_t predecessorCount = 0;
+			std::atomic<std::uint32_t> remaining = 0;
+			//Also the node's index in nodes
+			std::size_t traceIndex = 0;
+		};
+
+	private:
+		Scene* scene = Scene::GetActiveScene();
+		JobSystem& jobs;
+
+		std::vector<std::unique_ptr<Node>> nodes;
+		std::vector<std::vector<Node*>> phases;
+		std::size_t knownSystemCount = 0;
+
+		std::vector<ScheduleTraceEntry> trace;
+		std::chrono::steady_clock::time_point frameStart;
+		std::chrono::nanoseconds frameTime{};
+
+	public:
+		SceneScheduler(JobSystem& jobs) :
+			jobs{ jobs }
+		{
+
+		}
+
+	public:
+		//Must be called from a thread that can wait on the job system
+		void Update()
+		{
+			if(knownSystemCount != scene->GetSystems().size())
+				Rebuild();
+
+			frameStart = std::chrono::steady_clock::now();
+			{
+				//Put back even when a system run inline by Wait throws
+				ActiveSceneScope activeScope{ scene };
+				SceneLifetimeScopeLock lifetimeLock{ *scene };
+
+				for(const std::vector<Node*>& phase : phases)
+				{
+					for(Node* node : phase)
+						node->remaining.store(node->predecessorCount, std::memory_order_relaxed);
+
+					JobHandle root = jobs.Create([] {});
+					for(Node* node : phase)
+					{
+						if(node->predecessorCount == 0)
+							jobs.Run([this, node, root] { RunNode(node, root); }, root);
+					}
+					jobs.Submit(root);
+					jobs.Wait(root);
+				}
+			}
+			frameTime = std::chrono::steady_clock::now() - frameStart;
+		}
+
+		//When and where each system ran during the last Update, in the order systems were added
+		std::span<const ScheduleTraceEntry> GetTrace() const noexcept { return trace; }
+
+		std::chrono::nanoseconds GetFrameTime() const noexcept { return frameTime; }
+
+		//Systems that must finish before system starts
+		std::vector<const ScheduledSystem*> GetPredecessors(const ScheduledSystem* system) const
+		{
+			std::vector<const ScheduledSystem*> output;
+			for(const auto& node : nodes)
+			{
+				if(std::any_of(node->successors.begin(), node->successors.end(), [&](const Node* successor) { return successor->system == system; }))
+					output.push_back(node->system);
+			}
+			return output;
+		}
+
+	private:
+		void RunNode(Node* node, JobHandle root)
+		{
+			ScheduleTraceEntry& entry = trace[node->traceIndex];
+			entry.thread = jobs.CurrentParticipant();
+			entry.start = std::chrono::steady_clock::now() - frameStart;
+			{
+				//Systems may call the static Scene functions from any worker
+				ActiveSceneScope activeScope{ scene };
+				SceneCommands::SortKeyScope sortKey{ scene->GetThreadCommands(), node->traceIndex };
+				node->system->Update();
+			}
+			entry.end = std::chrono::steady_clock::now() - frameStart;
+
+			for(Node* successor : node->successors)
+			{
+				if(successor->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					jobs.Run([this, successor, root] { RunNode(successor, root); }, root);
+			}
+		}
+
+		void Rebuild()
+		{
+			nodes.clear();
+			phases.clear();
+			trace.clear();
+
+			std::span<SceneSystem* const> systems = scene->GetSystems();
+			knownSystemCount = systems.size();
+			for(SceneSystem* system : systems)
+			{
+				auto scheduled = dynamic_cast<ScheduledSystem*>(system);
+				if(!scheduled)
+					continue;
+
+				auto node = std::make_unique<Node>();
+				node->system = scheduled;
+				scheduled->DeclareAccess(node->access);
+				node->traceIndex = trace.size();
+				trace.push_back({ scheduled, typeid(*scheduled).name(), node->access.phase });
+				nodes.push_back(std::move(node));
+			}
+
+			for(std::size_t i = 0; i < nodes.size(); i++)
+			{
+				Node& later = *nodes[i];
+				for(std::size_t j = 0; j < nodes.size(); j++)
+				{
+					Node& other = *nodes[j];
+					if(i == j || other.access.phase != later.access.phase)
+						continue;
+
+					const bool explicitOrder = std::find(later.access.after.begin(), later.access.after.end(), std::type_index{ typeid(*other.system) }) != later.access.after.end();
+					const bool conflict = j < i && later.access.ConflictsWith(other.access);
+					if(explicitOrder || conflict)
+					{
+						other.successors.push_back(&later);
+						later.predecessorCount++;
+					}
+				}
+			}
+
+			std::vector<Node*> ordered = TopologicalOrder();
+			std::size_t phaseCount = 0;
+			for(const auto& node : nodes)
+				phaseCount = (std::max)(phaseCount, static_cast<std::size_t>(node->access.phase) + 1);
+
+			phases.resize(phaseCount);
+			for(Node* node : ordered)
+				phases[static_cast<std::size_t>(node->access.phase)].push_back(node);
+		}
+
+		std::vector<Node*> TopologicalOrder()
+		{
+			std::vector<Node*> ordered;
+			std::vector<std::uint32_t> remaining;
+			for(const auto& node : nodes)
+			{
+				remaining.push_back(node->predecessorCount);
+				if(node->predecessorCount == 0)
+					ordered.push_back(node.get());
+			}
+
+			for(std::size_t i = 0; i < ordered.size(); i++)
+			{
+				for(Node* successor : ordered[i]->successors)
+				{
+					if(--remaining[successor->traceIndex] == 0)
+						ordered.push_back(successor);
+				}
+			}
+
+			if(ordered.size() != nodes.size())
+				throw std::exception("Scene systems have cyclic dependencies");
+
+			return ordered;
+		}
+	};
+}
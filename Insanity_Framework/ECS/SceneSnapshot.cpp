@@ -0,0 +1,233 @@
+module;
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <new>
+#include <exception>
+
+module InsanityFramework.ECS.Scene;
+import InsanityFramework.TypeID;
+import :Object;
+import :ObjectMask;
+import :Snapshot;
+
+namespace InsanityFramework
+{
+	namespace
+	{
+		using Buckets = TypeMap<ObjectBucket>;
+
+		//Calls func on every GameObject's node, the node offset is the same for every object of a bucket
+		template<class Func>
+		void ForEachNode(Buckets& buckets, Func func)
+		{
+			for(auto& [type, bucket] : buckets)
+			{
+				const std::vector<Object*>& objects = bucket.objects;
+				if(objects.empty())
+					continue;
+
+				auto first = dynamic_cast<GameObject*>(objects.front());
+				if(!first)
+					continue;
+
+				const std::ptrdiff_t offset = reinterpret_cast<std::byte*>(static_cast<TransformNode*>(first)) - reinterpret_cast<std::byte*>(objects.front());
+				for(Object* object : objects)
+					func(*reinterpret_cast<TransformNode*>(reinterpret_cast<std::byte*>(object) + offset));
+			}
+		}
+	}
+
+	std::size_t SceneSnapshots::TakeWrittenBlocks(ObjectAllocator::Page* page, const PageImage* current, std::vector<void*>& written)
+	{
+		written.resize(blocksPerPage);
+		if(!page->IsWriteWatched())
+		{
+			std::size_t count = 0;
+			for(std::size_t i = 0; i < blocksPerPage; i++)
+			{
+				std::byte* block = reinterpret_cast<std::byte*>(page) + i * blockSize;
+				const Block& previous = current ? *current->blocks[i] : *ZeroBlock();
+				if(std::memcmp(block, previous.bytes.data(), blockSize) != 0)
+					written[count++] = block;
+			}
+			return count;
+		}
+
+		ULONG_PTR count = written.size();
+		DWORD granularity;
+		[[maybe_unused]] const UINT result = GetWriteWatch(WRITE_WATCH_FLAG_RESET, page, pageSize, written.data(), &count, &granularity);
+		assert(result == 0 && granularity == blockSize);
+		return count;
+	}
+
+	const std::shared_ptr<const SceneSnapshots::Block>& SceneSnapshots::ZeroBlock()
+	{
+		static const std::shared_ptr<const Block> zeroBlock = std::make_shared<Block>();
+		return zeroBlock;
+	}
+
+	void SceneSnapshots::CheckNoPools() const
+	{
+		if(!scene->recyclers.empty())
+			throw std::exception("Scenes with object pools can't be snapshotted");
+	}
+
+	const SceneSnapshots::PageImage* SceneSnapshots::Snapshot::Find(const void* page) const noexcept
+	{
+		for(const PageImage& image : pages)
+		{
+			if(image.page == page)
+				return &image;
+		}
+		return nullptr;
+	}
+
+	SceneSnapshots::SceneSnapshots(Scene& scene, std::size_t capacity) :
+		scene{ &scene },
+		capacity{ capacity }
+	{
+		assert(capacity > 0);
+		CheckNoPools();
+		scene.allocator.writeWatched = true;
+	}
+
+	std::uint64_t SceneSnapshots::Capture()
+	{
+		CheckNoPools();
+		//Destructors still running on the reclaimer would write into the pages while they're copied
+		scene->WaitForReclaims();
+		scene->FlushLifetimes();
+		copiedBytes = 0;
+
+		Snapshot snapshot{ nextSequence++ };
+		std::vector<void*> written;
+		for(ObjectAllocator::Page* page = scene->allocator.firstPage; page; page = page->Next())
+		{
+			const PageImage* previous = base ? base->Find(page) : nullptr;
+			const std::size_t writtenCount = TakeWrittenBlocks(page, previous, written);
+
+			PageImage& image = snapshot.pages.emplace_back(page);
+			image.blocks = previous ? previous->blocks : std::vector<std::shared_ptr<const Block>>(blocksPerPage, ZeroBlock());
+			for(std::size_t i = 0; i < writtenCount; i++)
+			{
+				auto block = std::make_shared<Block>();
+				std::memcpy(block->bytes.data(), written[i], blockSize);
+				image.blocks[BlockIndex(page, written[i])] = std::move(block);
+			}
+			copiedBytes += writtenCount * blockSize;
+		}
+
+		for(auto& [type, bucket] : scene->gameObjects)
+			snapshot.buckets.push_back({ &bucket, bucket });
+		snapshot.handleSlots = scene->handleSlots;
+		snapshot.freeHandleSlots = scene->freeHandleSlots;
+
+		snapshots.push_back(std::move(snapshot));
+		base = &snapshots.back();
+		while(snapshots.size() > capacity)
+			snapshots.pop_front();
+
+		return base->sequence;
+	}
+
+	bool SceneSnapshots::Restore(std::uint64_t sequence)
+	{
+		const Snapshot* target = nullptr;
+		for(const Snapshot& snapshot : snapshots)
+		{
+			if(snapshot.sequence == sequence)
+				target = &snapshot;
+		}
+		if(!target)
+			return false;
+
+		CheckNoPools();
+		scene->WaitForReclaims();
+		scene->FlushLifetimes();
+		copiedBytes = 0;
+
+		ForEachNode(scene->gameObjects, [](TransformNode& node) { node.ReleaseChildrenForRollback(); });
+
+		std::vector<void*> written;
+		std::array<bool, blocksPerPage> dirty;
+		for(ObjectAllocator::Page* page = scene->allocator.firstPage; page;)
+		{
+			//The page list link is in the first block and must survive the copy
+			ObjectAllocator::Page* next = page->Next();
+
+			const PageImage* image = target->Find(page);
+			if(image)
+			{
+				const PageImage* current = base->Find(page);
+				dirty.fill(false);
+				const std::size_t writtenCount = TakeWrittenBlocks(page, current, written);
+				for(std::size_t i = 0; i < writtenCount; i++)
+					dirty[BlockIndex(page, written[i])] = true;
+
+				for(std::size_t i = 0; i < blocksPerPage; i++)
+				{
+					if(dirty[i] || !current || current->blocks[i] != image->blocks[i])
+					{
+						std::memcpy(reinterpret_cast<std::byte*>(page) + i * blockSize, image->blocks[i]->bytes.data(), blockSize);
+						copiedBytes += blockSize;
+					}
+				}
+				if(page->IsWriteWatched())
+					ResetWriteWatch(page, pageSize);
+			}
+			else
+			{
+				//Allocated after the snapshot, zeroed to match the zero blocks a capture assumes for new pages
+				Scene* owner = page->GetScene();
+				const bool watched = page->IsWriteWatched();
+				std::memset(page, 0, pageSize);
+				if(watched)
+					ResetWriteWatch(page, pageSize);
+				std::construct_at(page, owner, watched);
+				copiedBytes += pageSize;
+			}
+
+			//Written after the watch reset so the next capture sees the first block differs from the image
+			page->RemoveSelfAndGetNext();
+			if(next)
+				page->Append(next);
+
+			page = next;
+		}
+		scene->allocator.allocationHint = scene->allocator.firstPage;
+
+		//Map entries are never erased, buckets made after the snapshot are simply emptied
+		for(auto& [type, bucket] : scene->gameObjects)
+		{
+			bucket.objects.clear();
+			bucket.layers.clear();
+			bucket.tags.clear();
+		}
+		for(const BucketImage& image : target->buckets)
+			*image.bucket = image.contents;
+		scene->handleSlots = target->handleSlots;
+		scene->freeHandleSlots = target->freeHandleSlots;
+		//Buckets empty before the rollback may be filled again
+		scene->bucketsVersion.fetch_add(1, std::memory_order_release);
+
+		ForEachNode(scene->gameObjects, [](TransformNode& node) { node.ResetChildrenAfterRollback(); });
+		ForEachNode(scene->gameObjects, [](TransformNode& node) { node.RelinkAfterRollback(); });
+
+		while(snapshots.back().sequence != sequence)
+			snapshots.pop_back();
+		base = &snapshots.back();
+
+		scene->Notify([&](SceneCallbacks& listener) { listener.OnSceneRestored(scene); });
+		return true;
+	}
+}
@@ -0,0 +1,109 @@
+module;
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <deque>
+#include <memory>
+
+export module InsanityFramework.ECS.Scene:Snapshot;
+import :Object;
+import :ObjectMask;
+
+namespace InsanityFramework
+{
+	//Ring of whole scene snapshots for rollback and replays. A snapshot is a copy of the scene's object pages
+	//and object lists with their masks, blocks of a page that weren't written since the previous snapshot are shared with it
+	//so a capture only copies what changed. Restoring copies the bytes back in place, objects keep their addresses
+	//and pointers between objects of the scene stay valid. Objects made after the snapshot vanish without their destructors running.
+	//Objects must not own heap memory besides their GameObject children list, which is rebuilt from parent pointers.
+	//Components and scene systems aren't captured, SceneCallbacks::OnSceneRestored is called after a restore.
+	//Scenes with object pools can't be snapshotted, a rollback would hand the pools objects they no longer keep.
+	//Pages allocated once snapshots are attached are write watched, older pages are compared against the last capture instead.
+	//Captures and restores need the scene's lifetimes to be unlocked
+	export class SceneSnapshots
+	{
+	public:
+		//The write watch granularity, the size of a system page
+		static constexpr std::size_t blockSize = 4096;
+
+	private:
+		static constexpr std::size_t pageSize = ObjectAllocator::pageSize;
+		static constexpr std::size_t blocksPerPage = pageSize / blockSize;
+
+		struct Block
+		{
+			std::array<std::byte, blockSize> bytes;
+		};
+
+		struct PageImage
+		{
+			void* page;
+			std::vector<std::shared_ptr<const Block>> blocks;
+		};
+
+		struct BucketImage
+		{
+			ObjectBucket* bucket;
+			ObjectBucket contents;
+		};
+
+		struct Snapshot
+		{
+			std::uint64_t sequence;
+			//In allocator page order, pages are only ever appended
+			std::vector<PageImage> pages;
+			std::vector<BucketImage> buckets;
+			std::vector<ObjectHandleSlot> handleSlots;
+			std::vector<std::uint32_t> freeHandleSlots;
+
+			const PageImage* Find(const void* page) const noexcept;
+		};
+
+	private:
+		Scene* scene;
+		std::size_t capacity;
+		std::deque<Snapshot> snapshots;
+		//What the pages held when their write tracking was last reset, blocks it shares with another snapshot are equal
+		const Snapshot* base = nullptr;
+		std::uint64_t nextSequence = 1;
+		std::size_t copiedBytes = 0;
+
+	public:
+		SceneSnapshots(Scene& scene, std::size_t capacity);
+
+		SceneSnapshots(const SceneSnapshots&) = delete;
+		SceneSnapshots& operator=(const SceneSnapshots&) = delete;
+
+	public:
+		//Returns the snapshot's sequence number, the oldest snapshot is dropped once the ring is full
+		std::uint64_t Capture();
+
+		//Rolls the scene back to the snapshot, which stays in the ring while every newer snapshot is dropped.
+		//Returns false if the snapshot has already been dropped
+		bool Restore(std::uint64_t sequence);
+
+		std::size_t Size() const noexcept { return snapshots.size(); }
+		std::size_t Capacity() const noexcept { return capacity; }
+
+		//Bytes copied by the last Capture or Restore
+		std::size_t LastCopiedBytes() const noexcept { return copiedBytes; }
+
+	private:
+		//Addresses of the page's blocks written since its tracking was last reset, resets it.
+		//Unwatched pages report the blocks which differ from current, or from zero without it
+		static std::size_t TakeWrittenBlocks(ObjectAllocator::Page* page, const PageImage* current, std::vector<void*>& written);
+
+		//Untouched blocks of pages which are new since the last capture are still zero
+		static const std::shared_ptr<const Block>& ZeroBlock();
+
+		//Throws if the scene has an ObjectPool
+		void CheckNoPools() const;
+
+		static std::size_t BlockIndex(const void* page, const void* block) noexcept
+		{
+			return (static_cast<const std::byte*>(block) - static_cast<const std::byte*>(page)) / blockSize;
+		}
+	};
+}
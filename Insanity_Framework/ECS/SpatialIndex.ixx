@@ -0,0 +1,568 @@
+module;
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <concepts>
+#include <cassert>
+#include <optional>
+#include <mutex>
+
+export module InsanityFramework.ECS.SpatialIndex;
+export import InsanityFramework.ECS.Scene;
+import xk.Math;
+
+namespace InsanityFramework
+{
+	export struct SpatialRayHit
+	{
+		TransformNode* node = nullptr;
+		float distance = 0;
+	};
+
+	//Uniform hashed grid over the world positions of registered nodes.
+	//Nodes are bucketed by the cell their position falls in and queries only visit the cells they overlap.
+	//Each node carries a radius which is used for overlap and ray tests, queries are widened by the largest radius in the index.
+	//In 2D the Z axis is ignored entirely, in 3D it's bucketed like the other axes.
+	//The index is the move listener of its nodes, so Update only reads the nodes which moved since the last one.
+	//Nodes leave the index when they are destroyed, objects of the scene active at construction even on a fast teardown
+	export template<std::size_t Dimensions = 2>
+		requires (Dimensions == 2 || Dimensions == 3)
+	class SpatialIndex : public SceneSystem, private SceneCallbacks, private TransformMoveListener
+	{
+		using Vector = xk::Math::Vector<float, 3>;
+		using CellCoord = std::array<std::int32_t, 3>;
+
+		struct Entry
+		{
+			TransformNode* node;
+			Vector position;
+			float radius;
+			std::uint64_t cell;
+			std::uint32_t slotInCell;
+		};
+
+	private:
+		//Cell coordinates fit in the 21 bits per axis of a cell key
+		static constexpr std::int32_t minCell = -(1 << 20);
+		static constexpr std::int32_t maxCell = (1 << 20) - 1;
+
+	private:
+		Scene* scene = Scene::GetActiveScene();
+		float cellSize;
+		float inverseCellSize;
+		float largestRadius = 0;
+		std::vector<Entry> entries;
+		std::unordered_map<const TransformNode*, std::uint32_t> entryLookup;
+		std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> cells;
+
+		//Reported from whichever thread moved the node, may hold nodes removed since
+		std::mutex movedMutex;
+		std::vector<TransformNode*> moved;
+		std::vector<TransformNode*> updating;
+
+	public:
+		SpatialIndex(float cellSize = 4.f) :
+			cellSize{ cellSize },
+			inverseCellSize{ 1.f / cellSize }
+		{
+			assert(cellSize > 0);
+			if(scene)
+				scene->AddListener(this);
+		}
+
+		SpatialIndex(const SpatialIndex&) = delete;
+		SpatialIndex& operator=(const SpatialIndex&) = delete;
+
+		~SpatialIndex()
+		{
+			if(scene)
+				scene->RemoveListener(this);
+			for(const Entry& entry : entries)
+				entry.node->SetMoveListener(nullptr);
+		}
+
+	public:
+		void Insert(TransformNode* node, float radius = 0)
+		{
+			assert(!entryLookup.contains(node));
+			assert(!node->GetMoveListener() && "A node can only be in one index");
+			node->SetMoveListener(this);
+
+			Vector position = node->WorldTransform().Position().Get();
+			std::uint64_t cell = ToKey(ToCell(position));
+			std::uint32_t index = static_cast<std::uint32_t>(entries.size());
+
+			std::vector<std::uint32_t>& bucket = cells[cell];
+			entries.push_back({ node, position, radius, cell, static_cast<std::uint32_t>(bucket.size()) });
+			bucket.push_back(index);
+			entryLookup.insert({ node, index });
+			largestRadius = (std::max)(largestRadius, radius);
+		}
+
+		void Remove(TransformNode* node)
+		{
+			auto it = entryLookup.find(node);
+			if(it == entryLookup.end())
+				return;
+
+			std::uint32_t index = it->second;
+			entryLookup.erase(it);
+			RemoveFromCell(index);
+			node->SetMoveListener(nullptr);
+
+			std::uint32_t last = static_cast<std::uint32_t>(entries.size() - 1);
+			if(index != last)
+			{
+				entries[index] = entries[last];
+				cells[entries[index].cell][entries[index].slotInCell] = index;
+				entryLookup[entries[index].node] = index;
+			}
+			entries.pop_back();
+		}
+
+		bool Contains(const TransformNode* node) const
+		{
+			return entryLookup.contains(node);
+		}
+
+		void SetRadius(TransformNode* node, float radius)
+		{
+			entries[entryLookup.at(node)].radius = radius;
+			largestRadius = (std::max)(largestRadius, radius);
+		}
+
+		//Pulls the world position of a single node, only touching the grid if it crossed into another cell
+		void Update(TransformNode* node)
+		{
+			UpdateEntry(entryLookup.at(node));
+		}
+
+		//Pulls the world position of every node which moved since the last Update, only nodes which crossed
+		//into another cell are moved between buckets. Returns the amount of nodes which changed cells.
+		//Nodes must not be moved while it runs
+		std::size_t Update()
+		{
+			{
+				std::scoped_lock lock{ movedMutex };
+				updating.swap(moved);
+			}
+
+			std::size_t changedCells = 0;
+			for(TransformNode* node : updating)
+			{
+				auto it = entryLookup.find(node);
+				if(it == entryLookup.end())
+					continue;
+
+				changedCells += UpdateEntry(it->second);
+				node->AcknowledgeMove();
+			}
+			updating.clear();
+			return changedCells;
+		}
+
+		std::size_t Size() const noexcept { return entries.size(); }
+
+		template<std::invocable<TransformNode*> Func>
+		void ForEachInAABB(Vector min, Vector max, Func func) const
+		{
+			Vector paddedMin = min - Vector{ largestRadius, largestRadius, largestRadius };
+			Vector paddedMax = max + Vector{ largestRadius, largestRadius, largestRadius };
+
+			ForEachCandidate(ToCell(paddedMin), ToCell(paddedMax), [&](const Entry& entry)
+			{
+				float distanceSquared = 0;
+				for(std::size_t axis = 0; axis < Dimensions; axis++)
+				{
+					float closest = std::clamp(entry.position[axis], min[axis], max[axis]);
+					float delta = entry.position[axis] - closest;
+					distanceSquared += delta * delta;
+				}
+
+				if(distanceSquared <= entry.radius * entry.radius)
+					func(entry.node);
+			});
+		}
+
+		template<std::invocable<TransformNode*> Func>
+		void ForEachInRadius(Vector center, float radius, Func func) const
+		{
+			float padding = radius + largestRadius;
+			Vector extents{ padding, padding, padding };
+
+			ForEachCandidate(ToCell(center - extents), ToCell(center + extents), [&](const Entry& entry)
+			{
+				float combined = radius + entry.radius;
+				if(DistanceSquared(entry.position, center) <= combined * combined)
+					func(entry.node);
+			});
+		}
+
+		std::vector<TransformNode*> QueryAABB(Vector min, Vector max) const
+		{
+			std::vector<TransformNode*> output;
+			ForEachInAABB(min, max, [&](TransformNode* node) { output.push_back(node); });
+			return output;
+		}
+
+		std::vector<TransformNode*> QueryRadius(Vector center, float radius) const
+		{
+			std::vector<TransformNode*> output;
+			ForEachInRadius(center, radius, [&](TransformNode* node) { output.push_back(node); });
+			return output;
+		}
+
+		//Returns the node whose position is closest to center, ignoring anything further than maxDistance
+		TransformNode* Nearest(Vector center, float maxDistance) const
+		{
+			TransformNode* closest = nullptr;
+			float closestDistance = maxDistance * maxDistance;
+			Vector extents{ maxDistance, maxDistance, maxDistance };
+
+			ForEachCandidate(ToCell(center - extents), ToCell(center + extents), [&](const Entry& entry)
+			{
+				float distance = DistanceSquared(entry.position, center);
+				if(distance <= closestDistance)
+				{
+					closest = entry.node;
+					closestDistance = distance;
+				}
+			});
+
+			return closest;
+		}
+
+		//Returns up to count nodes ordered from closest to furthest from center.
+		//Searches outwards ring by ring of cells, stopping once no closer node can exist in the next ring
+		std::vector<TransformNode*> KNearest(Vector center, std::size_t count) const
+		{
+			std::vector<std::pair<float, std::uint32_t>> best;
+			if(count == 0 || entries.empty())
+				return {};
+
+			auto consider = [&](std::uint32_t index)
+			{
+				float distance = DistanceSquared(entries[index].position, center);
+				if(best.size() < count)
+				{
+					best.push_back({ distance, index });
+					std::push_heap(best.begin(), best.end());
+				}
+				else if(distance < best.front().first)
+				{
+					std::pop_heap(best.begin(), best.end());
+					best.back() = { distance, index };
+					std::push_heap(best.begin(), best.end());
+				}
+			};
+
+			CellCoord origin = ToCell(center);
+			std::size_t visited = 0;
+			for(std::int32_t ring = 0; visited < entries.size(); ring++)
+			{
+				//A ring covering more cells than are occupied is slower than scanning everything
+				std::size_t ringSpan = 2 * static_cast<std::size_t>(ring) + 1;
+				std::size_t cubeCells = Dimensions == 2 ? ringSpan * ringSpan : ringSpan * ringSpan * ringSpan;
+				if(cubeCells > cells.size() * 4)
+				{
+					best.clear();
+					for(std::uint32_t i = 0; i < entries.size(); i++)
+						consider(i);
+					break;
+				}
+
+				ForEachCellInRing(origin, ring, [&](const std::vector<std::uint32_t>& bucket)
+				{
+					visited += bucket.size();
+					for(std::uint32_t index : bucket)
+						consider(index);
+				});
+
+				float ringDistance = ring * cellSize;
+				if(best.size() == count && ringDistance * ringDistance >= best.front().first)
+					break;
+			}
+
+			std::sort_heap(best.begin(), best.end());
+
+			std::vector<TransformNode*> output;
+			output.reserve(best.size());
+			for(auto [distance, index] : best)
+				output.push_back(entries[index].node);
+			return output;
+		}
+
+		//Walks the cells along the ray and returns the closest node whose radius the ray passes through
+		std::optional<SpatialRayHit> Raycast(Vector origin, Vector direction, float maxDistance) const
+		{
+			assert(std::isfinite(maxDistance));
+			if(entries.empty())
+				return std::nullopt;
+
+			if constexpr(Dimensions == 2)
+				direction[2] = 0;
+
+			float length = std::sqrt(Dot(direction, direction));
+			if(length == 0)
+				return std::nullopt;
+			direction = direction * (1.f / length);
+
+			constexpr float infinity = std::numeric_limits<float>::infinity();
+			CellCoord cell = ToCell(origin);
+			std::array<std::int32_t, 3> step{};
+			std::array<float, 3> tMax{ infinity, infinity, infinity };
+			std::array<float, 3> tDelta{ infinity, infinity, infinity };
+
+			for(std::size_t axis = 0; axis < Dimensions; axis++)
+			{
+				if(direction[axis] == 0)
+					continue;
+
+				step[axis] = direction[axis] > 0 ? 1 : -1;
+				tDelta[axis] = cellSize / std::abs(direction[axis]);
+				float boundary = (cell[axis] + (step[axis] > 0 ? 1 : 0)) * cellSize;
+				tMax[axis] = (boundary - origin[axis]) / direction[axis];
+			}
+
+			//Nodes are bucketed by their position, so a node's radius can reach into neighbouring cells
+			const std::int32_t margin = static_cast<std::int32_t>(std::ceil(largestRadius * inverseCellSize));
+			std::unordered_set<std::uint64_t> tested;
+			SpatialRayHit best{ nullptr, maxDistance };
+
+			while(true)
+			{
+				float tExit = (std::min)({ tMax[0], tMax[1], tMax[2] });
+
+				CellCoord min = cell;
+				CellCoord max = cell;
+				for(std::size_t axis = 0; axis < Dimensions; axis++)
+				{
+					min[axis] -= margin;
+					max[axis] += margin;
+				}
+
+				ForEachCell(min, max, [&](std::uint64_t key, const std::vector<std::uint32_t>& bucket)
+				{
+					if(margin > 0 && !tested.insert(key).second)
+						return;
+
+					for(std::uint32_t index : bucket)
+					{
+						const Entry& entry = entries[index];
+						std::optional<float> distance = RaySphere(origin, direction, entry.position, entry.radius);
+						if(distance && *distance <= best.distance)
+							best = { entry.node, *distance };
+					}
+				});
+
+				//Any node not yet tested would have to be hit beyond the cell we just left
+				if((best.node && best.distance <= tExit) || tExit > maxDistance)
+					break;
+
+				std::size_t axis = tMax[0] == tExit ? 0 : (tMax[1] == tExit ? 1 : 2);
+				cell[axis] += step[axis];
+				tMax[axis] += tDelta[axis];
+			}
+
+			return best.node ? std::optional{ best } : std::nullopt;
+		}
+
+	private:
+		void OnNodeMoved(TransformNode* node) override
+		{
+			std::scoped_lock lock{ movedMutex };
+			moved.push_back(node);
+		}
+
+		void OnNodeDestroyed(TransformNode* node) override
+		{
+			Remove(node);
+		}
+
+		//Runs before the object's destructor, and also for objects a fast teardown skips the destructor of
+		void OnObjectDestroyed(Object* object) override
+		{
+			if(TransformNode* node = dynamic_cast<TransformNode*>(object); node && node->GetMoveListener() == this)
+				Remove(node);
+		}
+
+		bool UpdateEntry(std::uint32_t index)
+		{
+			Entry& entry = entries[index];
+			Vector position = entry.node->WorldTransform().Position().Get();
+			if(position == entry.position)
+				return false;
+
+			entry.position = position;
+			std::uint64_t cell = ToKey(ToCell(position));
+			if(cell == entry.cell)
+				return false;
+
+			RemoveFromCell(index);
+			std::vector<std::uint32_t>& bucket = cells[cell];
+			entry.cell = cell;
+			entry.slotInCell = static_cast<std::uint32_t>(bucket.size());
+			bucket.push_back(index);
+			return true;
+		}
+
+		void RemoveFromCell(std::uint32_t index)
+		{
+			auto it = cells.find(entries[index].cell);
+			std::vector<std::uint32_t>& bucket = it->second;
+			std::uint32_t slot = entries[index].slotInCell;
+
+			bucket[slot] = bucket.back();
+			entries[bucket[slot]].slotInCell = slot;
+			bucket.pop_back();
+
+			if(bucket.empty())
+				cells.erase(it);
+		}
+
+		template<class Func>
+		void ForEachCandidate(CellCoord min, CellCoord max, Func func) const
+		{
+			//Huge queries visit fewer buckets by walking the occupied cells instead of the covered ones
+			std::size_t covered = 1;
+			for(std::size_t axis = 0; axis < Dimensions; axis++)
+				covered *= static_cast<std::size_t>(max[axis] - min[axis]) + 1;
+
+			if(covered > cells.size())
+			{
+				for(const Entry& entry : entries)
+					func(entry);
+				return;
+			}
+
+			ForEachCell(min, max, [&](std::uint64_t, const std::vector<std::uint32_t>& bucket)
+			{
+				for(std::uint32_t index : bucket)
+					func(entries[index]);
+			});
+		}
+
+		template<class Func>
+		void ForEachCell(CellCoord min, CellCoord max, Func func) const
+		{
+			if constexpr(Dimensions == 2)
+			{
+				min[2] = max[2] = 0;
+			}
+
+			for(std::int32_t z = min[2]; z <= max[2]; z++)
+			{
+				for(std::int32_t y = min[1]; y <= max[1]; y++)
+				{
+					for(std::int32_t x = min[0]; x <= max[0]; x++)
+					{
+						std::uint64_t key = ToKey({ x, y, z });
+						auto it = cells.find(key);
+						if(it != cells.end())
+							func(key, it->second);
+					}
+				}
+			}
+		}
+
+		template<class Func>
+		void ForEachCellInRing(CellCoord origin, std::int32_t ring, Func func) const
+		{
+			CellCoord min = origin;
+			CellCoord max = origin;
+			for(std::size_t axis = 0; axis < Dimensions; axis++)
+			{
+				min[axis] -= ring;
+				max[axis] += ring;
+			}
+
+			ForEachCell(min, max, [&](std::uint64_t key, const std::vector<std::uint32_t>& bucket)
+			{
+				CellCoord coord = FromKey(key);
+				std::int32_t distance = 0;
+				for(std::size_t axis = 0; axis < Dimensions; axis++)
+					distance = (std::max)(distance, std::abs(coord[axis] - origin[axis]));
+
+				if(distance == ring)
+					func(bucket);
+			});
+		}
+
+		//Positions past the key range share its outermost cells, clamped before the cast as
+		//converting an out of range float is undefined. NaN ends up in the lowest cell
+		CellCoord ToCell(Vector position) const
+		{
+			CellCoord cell{};
+			for(std::size_t axis = 0; axis < Dimensions; axis++)
+			{
+				const float scaled = std::floor(position[axis] * inverseCellSize);
+				if(scaled >= static_cast<float>(maxCell))
+					cell[axis] = maxCell;
+				else if(scaled > static_cast<float>(minCell))
+					cell[axis] = static_cast<std::int32_t>(scaled);
+				else
+					cell[axis] = minCell;
+			}
+			return cell;
+		}
+
+		//Packs 21 bits per axis, enough for ~1 million cells in each direction
+		static std::uint64_t ToKey(CellCoord cell)
+		{
+			constexpr std::uint64_t mask = (1ull << 21) - 1;
+			return ((static_cast<std::uint64_t>(cell[0]) & mask) << 42) |
+				((static_cast<std::uint64_t>(cell[1]) & mask) << 21) |
+				(static_cast<std::uint64_t>(cell[2]) & mask);
+		}
+
+		static CellCoord FromKey(std::uint64_t key)
+		{
+			constexpr std::uint64_t mask = (1ull << 21) - 1;
+			auto unpack = [](std::uint64_t bits)
+			{
+				//Sign extend the 21 bit value
+				return static_cast<std::int32_t>(static_cast<std::int64_t>(bits << 43) >> 43);
+			};
+			return { unpack((key >> 42) & mask), unpack((key >> 21) & mask), unpack(key & mask) };
+		}
+
+		static float Dot(const Vector& a, const Vector& b)
+		{
+			float output = 0;
+			for(std::size_t axis = 0; axis < Dimensions; axis++)
+				output += a[axis] * b[axis];
+			return output;
+		}
+
+		static float DistanceSquared(const Vector& a, const Vector& b)
+		{
+			Vector delta = a - b;
+			return Dot(delta, delta);
+		}
+
+		//Direction is expected to be normalized. Returns 0 when the origin starts inside the sphere
+		static std::optional<float> RaySphere(const Vector& origin, const Vector& direction, const Vector& center, float radius)
+		{
+			Vector offset = origin - center;
+			float c = Dot(offset, offset) - radius * radius;
+			if(c <= 0)
+				return 0.f;
+
+			float b = Dot(offset, direction);
+			if(b > 0)
+				return std::nullopt;
+
+			float discriminant = b * b - c;
+			if(discriminant < 0)
+				return std::nullopt;
+
+			return -b - std::sqrt(discriminant);
+		}
+	};
+}
@@ -0,0 +1,311 @@
+module;
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <concepts>
+
+export module InsanityFramework.ECS.TickScheduler;
+import InsanityFramework.ECS.Scene;
+
+namespace InsanityFramework
+{
+	//High priority groups always run in full, the others stop once the frame budget is used up
+	export enum class TickPriority : std::uint8_t
+	{
+		High,
+		Normal,
+		Low,
+	};
+
+	export using TickGroupID = std::uint32_t;
+
+	//Ids are reused, the generation tells a stale handle from the entry which got its id since
+	export struct TickHandle
+	{
+		std::uint32_t id = ~0u;
+		std::uint32_t generation = 0;
+
+		bool operator==(const TickHandle&) const noexcept = default;
+		explicit operator bool() const noexcept { return id != ~0u; }
+	};
+
+	export struct TickStats
+	{
+		std::size_t ticked = 0;
+		//Ticks that were due but pushed to a later frame by the budget
+		std::size_t deferred = 0;
+		std::chrono::nanoseconds time{};
+	};
+
+	//Ticks registered functions and objects in groups with a target interval. A group's entries are spread
+	//round robin over the frames of its interval, so 1000 objects ticking at 10 Hz cost about 1000 / (10 * frame time)
+	//ticks a frame instead of 1000 every tenth of a second. Normal and Low groups stop when the frame budget runs out,
+	//their entries are picked up where they left off next frame and get the whole time since their last tick.
+	//Update takes the same delta as DefaultMain's update function, the budget is measured on the clock
+	export class TickScheduler : public SceneSystem
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+		using ClockFunc = Clock::time_point(*)();
+		//Gets the game time since the entry last ticked
+		using TickFunc = std::function<void(std::chrono::nanoseconds)>;
+
+		static constexpr std::chrono::nanoseconds everyFrame{ 0 };
+
+	private:
+		struct Entry
+		{
+			std::uint32_t id;
+			TickFunc func;
+			//Set for object registrations, the entry is dropped once the object is gone
+			WeakObject<Object> owner;
+			std::chrono::nanoseconds lastTick;
+		};
+
+		struct Group
+		{
+			std::chrono::nanoseconds interval;
+			TickPriority priority;
+			std::vector<Entry> entries;
+			std::size_t cursor = 0;
+			//Ticks due but not run yet, capped at one pass over the group
+			double owed = 0;
+		};
+
+		struct Location
+		{
+			TickGroupID group;
+			std::uint32_t index;
+			std::uint32_t generation = 0;
+		};
+
+		static constexpr std::uint32_t removedIndex = ~0u;
+		static constexpr std::uint32_t pendingIndex = ~0u - 1;
+
+	private:
+		Scene* scene = Scene::GetActiveScene();
+		ClockFunc clock;
+		std::chrono::nanoseconds frameBudget;
+
+		std::vector<Group> groups;
+		//Group ids by priority, groups of equal priority in the order they were added
+		std::vector<TickGroupID> order;
+
+		std::vector<Location> locations;
+		std::vector<std::uint32_t> freeIds;
+
+		//Changes made while ticking are applied after the frame so entries don't move under the loop
+		bool updating = false;
+		std::vector<std::pair<TickGroupID, Entry>> pendingAdds;
+		std::vector<std::uint32_t> pendingRemoves;
+
+		std::chrono::nanoseconds time{};
+		TickStats stats;
+
+	public:
+		TickScheduler(std::chrono::nanoseconds frameBudget, ClockFunc clock = &Clock::now) :
+			clock{ clock },
+			frameBudget{ frameBudget }
+		{
+
+		}
+
+	public:
+		//interval is everyFrame or the target time between two ticks of each entry
+		TickGroupID AddGroup(std::chrono::nanoseconds interval, TickPriority priority = TickPriority::Normal)
+		{
+			const TickGroupID id = static_cast<TickGroupID>(groups.size());
+			groups.push_back({ interval, priority });
+
+			auto position = std::upper_bound(order.begin(), order.end(), priority, [&](TickPriority value, TickGroupID group) { return value < groups[group].priority; });
+			order.insert(position, id);
+			return id;
+		}
+
+		TickHandle Register(TickGroupID group, TickFunc func)
+		{
+			return Add(group, std::move(func), {});
+		}
+
+		//Calls object->Tick(delta) until the object is destroyed, the entry removes itself then
+		template<std::derived_from<Object> Ty>
+			requires requires(Ty& object, std::chrono::nanoseconds delta) { object.Tick(delta); }
+		TickHandle Register(TickGroupID group, Ty* object)
+		{
+			WeakObject<Ty> weak = object;
+			Scene* owningScene = scene;
+			return Add(group, [weak, owningScene](std::chrono::nanoseconds delta) { weak.Get(owningScene)->Tick(delta); }, weak);
+		}
+
+		void Unregister(TickHandle handle)
+		{
+			if(!handle || handle.id >= locations.size())
+				return;
+
+			//Already removed, or the id belongs to a newer entry
+			const Location& current = locations[handle.id];
+			if(current.generation != handle.generation || current.index == removedIndex)
+				return;
+
+			if(updating)
+			{
+				pendingRemoves.push_back(handle.id);
+				Location location = locations[handle.id];
+				if(location.index < pendingIndex)
+					groups[location.group].entries[location.index].func = nullptr;
+				return;
+			}
+
+			Remove(handle.id);
+		}
+
+		void SetFrameBudget(std::chrono::nanoseconds budget) noexcept { frameBudget = budget; }
+		std::chrono::nanoseconds GetFrameBudget() const noexcept { return frameBudget; }
+
+		//Ticks run and deferred during the last Update
+		const TickStats& GetStats() const noexcept { return stats; }
+
+		void Update(std::chrono::nanoseconds delta)
+		{
+			const Clock::time_point frameStart = clock();
+			time += delta;
+			stats = {};
+			updating = true;
+
+			for(TickGroupID groupID : order)
+			{
+				Group& group = groups[groupID];
+				if(group.entries.empty())
+					continue;
+
+				const double size = static_cast<double>(group.entries.size());
+				const double due = group.interval <= everyFrame ? size : size * delta.count() / group.interval.count();
+				group.owed = (std::min)(group.owed + due, size);
+
+				const std::size_t count = static_cast<std::size_t>(group.owed);
+				for(std::size_t i = 0; i < count; i++)
+				{
+					if(group.priority != TickPriority::High && clock() - frameStart >= frameBudget)
+					{
+						stats.deferred += count - i;
+						break;
+					}
+
+					Entry& entry = group.entries[group.cursor];
+					group.cursor = (group.cursor + 1) % group.entries.size();
+					group.owed -= 1;
+
+					if(!entry.func)
+						continue;
+
+					if(!entry.owner.IsNull() && !entry.owner.Get(scene))
+					{
+						entry.func = nullptr;
+						pendingRemoves.push_back(entry.id);
+						continue;
+					}
+
+					entry.func(time - entry.lastTick);
+					entry.lastTick = time;
+					stats.ticked++;
+				}
+			}
+
+			updating = false;
+			for(std::uint32_t id : pendingRemoves)
+				Remove(id);
+			pendingRemoves.clear();
+			for(auto& [group, entry] : pendingAdds)
+				Insert(group, std::move(entry));
+			pendingAdds.clear();
+
+			stats.time = clock() - frameStart;
+		}
+
+	private:
+		TickHandle Add(TickGroupID group, TickFunc func, WeakObject<Object> owner)
+		{
+			assert(group < groups.size());
+
+			std::uint32_t id;
+			if(freeIds.empty())
+			{
+				id = static_cast<std::uint32_t>(locations.size());
+				locations.push_back({});
+			}
+			else
+			{
+				id = freeIds.back();
+				freeIds.pop_back();
+			}
+			const std::uint32_t generation = locations[id].generation + 1;
+			locations[id] = { group, pendingIndex, generation };
+
+			Entry entry{ id, std::move(func), owner, time };
+			if(updating)
+				pendingAdds.push_back({ group, std::move(entry) });
+			else
+				Insert(group, std::move(entry));
+
+			return { id, generation };
+		}
+
+		void Insert(TickGroupID groupID, Entry entry)
+		{
+			Group& group = groups[groupID];
+			locations[entry.id].group = groupID;
+			locations[entry.id].index = static_cast<std::uint32_t>(group.entries.size());
+			group.entries.push_back(std::move(entry));
+		}
+
+		//Swaps the group's last entry into the removed one's place
+		void Remove(std::uint32_t id)
+		{
+			Location& location = locations[id];
+			if(location.index == removedIndex)
+				return;
+
+			if(location.index == pendingIndex)
+			{
+				//Added and removed within the same Update
+				std::erase_if(pendingAdds, [&](const auto& add) { return add.second.id == id; });
+				location.index = removedIndex;
+				freeIds.push_back(id);
+				return;
+			}
+
+			Group& group = groups[location.group];
+			if(location.index != group.entries.size() - 1)
+			{
+				group.entries[location.index] = std::move(group.entries.back());
+				locations[group.entries[location.index].id].index = location.index;
+			}
+			group.entries.pop_back();
+
+			if(group.cursor >= group.entries.size())
+				group.cursor = 0;
+			group.owed = (std::min)(group.owed, static_cast<double>(group.entries.size()));
+
+			location.index = removedIndex;
+			freeIds.push_back(id);
+		}
+	};
+
+	//Update function for DefaultMain which runs a scheduler, call it from your own update function to do more each frame
+	export class TickUpdateFunction
+	{
+		TickScheduler& scheduler;
+
+	public:
+		TickUpdateFunction(TickScheduler& scheduler) : scheduler{ scheduler } {}
+
+		void operator()(auto&, std::chrono::nanoseconds deltaTime)
+		{
+			scheduler.Update(deltaTime);
+		}
+	};
+}
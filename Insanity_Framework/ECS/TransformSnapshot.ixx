@@ -0,0 +1,466 @@
+module;
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <span>
+#include <bit>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+export module InsanityFramework.ECS.TransformSnapshot;
+import InsanityFramework.TransformationNode;
+import xk.Math;
+
+namespace InsanityFramework
+{
+	export enum class SnapshotSpace
+	{
+		Local,
+		World,
+	};
+
+	export struct TransformQuantization
+	{
+		float positionPrecision = 1.f / 512.f;
+		float scalePrecision = 1.f / 1024.f;
+		std::uint32_t rotationBits = 16;
+	};
+
+	//Position XYZ, rotation, scale XYZ as fixed point integers
+	struct QuantizedTransform
+	{
+		static constexpr std::size_t fieldCount = 7;
+		//Fields are clamped to this magnitude so the difference of two fits in 32 bits
+		static constexpr std::int64_t maxField = (std::int64_t{ 1 } << 30) - 1;
+		std::array<std::int32_t, fieldCount> fields{};
+
+		bool operator==(const QuantizedTransform&) const noexcept = default;
+	};
+
+	class BitWriter
+	{
+		std::vector<std::byte>& output;
+		std::uint64_t pending = 0;
+		std::uint32_t pendingBits = 0;
+
+	public:
+		BitWriter(std::vector<std::byte>& output) :
+			output{ output }
+		{
+
+		}
+
+		void Write(std::uint32_t value, std::uint32_t bits)
+		{
+			assert(bits <= 32);
+			if(bits == 0)
+				return;
+
+			pending |= static_cast<std::uint64_t>(value & (bits == 32 ? ~0u : (1u << bits) - 1)) << pendingBits;
+			pendingBits += bits;
+			while(pendingBits >= 8)
+			{
+				output.push_back(static_cast<std::byte>(pending & 0xFF));
+				pending >>= 8;
+				pendingBits -= 8;
+			}
+		}
+
+		//Values are sent as 5 bits of width followed by the value itself, 0 can't be represented
+		void WriteNonZero(std::uint32_t value)
+		{
+			assert(value != 0);
+			std::uint32_t width = static_cast<std::uint32_t>(std::bit_width(value));
+			Write(width - 1, 5);
+			Write(value, width);
+		}
+
+		void Flush()
+		{
+			if(pendingBits > 0)
+				output.push_back(static_cast<std::byte>(pending & 0xFF));
+			pending = 0;
+			pendingBits = 0;
+		}
+	};
+
+	class BitReader
+	{
+		std::span<const std::byte> input;
+		std::size_t bytePosition = 0;
+		std::uint64_t pending = 0;
+		std::uint32_t pendingBits = 0;
+
+	public:
+		BitReader(std::span<const std::byte> input) :
+			input{ input }
+		{
+
+		}
+
+		std::uint32_t Read(std::uint32_t bits)
+		{
+			assert(bits <= 32);
+			if(bits == 0)
+				return 0;
+
+			while(pendingBits < bits)
+			{
+				std::uint64_t next = bytePosition < input.size() ? static_cast<std::uint64_t>(input[bytePosition]) : 0;
+				bytePosition++;
+				pending |= next << pendingBits;
+				pendingBits += 8;
+			}
+
+			std::uint32_t value = static_cast<std::uint32_t>(pending & (bits == 32 ? ~0u : (1u << bits) - 1));
+			pending >>= bits;
+			pendingBits -= bits;
+			return value;
+		}
+
+		std::uint32_t ReadNonZero()
+		{
+			std::uint32_t width = Read(5) + 1;
+			return Read(width);
+		}
+
+		bool Overrun() const noexcept { return bytePosition > input.size(); }
+	};
+
+	std::uint32_t ZigZag(std::int32_t value)
+	{
+		return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+	}
+
+	std::int32_t UnZigZag(std::uint32_t value)
+	{
+		return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+	}
+
+	QuantizedTransform Quantize(const Transform& transform, const TransformQuantization& quantization)
+	{
+		auto fixedPoint = [](float value, float precision)
+		{
+			const float steps = std::clamp(value / precision, static_cast<float>(-QuantizedTransform::maxField), static_cast<float>(QuantizedTransform::maxField));
+			return static_cast<std::int32_t>(std::clamp(std::llround(steps), -QuantizedTransform::maxField, QuantizedTransform::maxField));
+		};
+
+		const float rotationSteps = static_cast<float>(1ull << quantization.rotationBits);
+		float degrees = std::fmod(transform.rotation._value, 360.f);
+		if(degrees < 0)
+			degrees += 360.f;
+
+		QuantizedTransform output;
+		output.fields[0] = fixedPoint(transform.position.X(), quantization.positionPrecision);
+		output.fields[1] = fixedPoint(transform.position.Y(), quantization.positionPrecision);
+		output.fields[2] = fixedPoint(transform.position.Z(), quantization.positionPrecision);
+		output.fields[3] = static_cast<std::int32_t>(static_cast<std::uint64_t>(std::llround(degrees / 360.f * rotationSteps)) % (1ull << quantization.rotationBits));
+		output.fields[4] = fixedPoint(transform.scale.X(), quantization.scalePrecision);
+		output.fields[5] = fixedPoint(transform.scale.Y(), quantization.scalePrecision);
+		output.fields[6] = fixedPoint(transform.scale.Z(), quantization.scalePrecision);
+		return output;
+	}
+
+	Transform Dequantize(const QuantizedTransform& transform, const TransformQuantization& quantization)
+	{
+		const float rotationSteps = static_cast<float>(1ull << quantization.rotationBits);
+		return
+		{
+			{
+				transform.fields[0] * quantization.positionPrecision,
+				transform.fields[1] * quantization.positionPrecision,
+				transform.fields[2] * quantization.positionPrecision
+			},
+			xk::Math::Degree<float>{ transform.fields[3] / rotationSteps * 360.f },
+			{
+				transform.fields[4] * quantization.scalePrecision,
+				transform.fields[5] * quantization.scalePrecision,
+				transform.fields[6] * quantization.scalePrecision
+			}
+		};
+	}
+
+	QuantizedTransform DefaultBaseline(const TransformQuantization& quantization)
+	{
+		return Quantize(Transform{}, quantization);
+	}
+
+	//A ring of recent snapshots indexed by sequence number, used as baselines by both ends
+	class SnapshotHistory
+	{
+		struct Entry
+		{
+			std::uint32_t sequence = noSequence;
+			std::vector<QuantizedTransform> transforms;
+		};
+
+		std::vector<Entry> entries;
+
+	public:
+		static constexpr std::uint32_t noSequence = ~0u;
+
+	public:
+		SnapshotHistory(std::size_t size) :
+			entries(size)
+		{
+			assert(size > 0);
+		}
+
+		std::vector<QuantizedTransform>& Store(std::uint32_t sequence)
+		{
+			Entry& entry = entries[sequence % entries.size()];
+			entry.sequence = sequence;
+			return entry.transforms;
+		}
+
+		const std::vector<QuantizedTransform>* Find(std::uint32_t sequence) const
+		{
+			if(sequence == noSequence)
+				return nullptr;
+
+			const Entry& entry = entries[sequence % entries.size()];
+			return entry.sequence == sequence ? &entry.transforms : nullptr;
+		}
+	};
+
+	struct SnapshotHeader
+	{
+		std::uint32_t sequence;
+		std::uint32_t baselineSequence;
+		std::uint32_t nodeCount;
+		std::uint32_t changedCount;
+	};
+
+	//Encodes the transforms of a list of nodes against the last snapshot the receiver acknowledged.
+	//Only nodes whose quantized transform differs from the baseline are written, and of those only the changed fields.
+	//Both ends must agree on the node list, a node's index in it is its identity on the wire
+	export class TransformSnapshotEncoder
+	{
+	private:
+		TransformQuantization quantization;
+		SnapshotSpace space;
+		SnapshotHistory history;
+		std::uint32_t nextSequence = 0;
+		std::uint32_t acknowledgedSequence = SnapshotHistory::noSequence;
+
+	public:
+		TransformSnapshotEncoder(SnapshotSpace space = SnapshotSpace::Local, TransformQuantization quantization = {}, std::size_t historySize = 8) :
+			quantization{ quantization },
+			space{ space },
+			history{ historySize }
+		{
+
+		}
+
+	public:
+		std::vector<std::byte> Encode(std::span<const TransformNode* const> nodes)
+		{
+			const std::uint32_t sequence = nextSequence++;
+			const std::vector<QuantizedTransform>* baseline = history.Find(acknowledgedSequence);
+			const QuantizedTransform defaultBaseline = DefaultBaseline(quantization);
+
+			std::vector<QuantizedTransform>& current = history.Store(sequence);
+			current.resize(nodes.size());
+
+			std::vector<std::uint32_t> changed;
+			for(std::size_t i = 0; i < nodes.size(); i++)
+			{
+				current[i] = Quantize(space == SnapshotSpace::Local ? nodes[i]->LocalTransform().Get() : nodes[i]->WorldTransform().Get(), quantization);
+
+				const QuantizedTransform& previous = baseline && i < baseline->size() ? (*baseline)[i] : defaultBaseline;
+				if(current[i] != previous)
+					changed.push_back(static_cast<std::uint32_t>(i));
+			}
+
+			std::vector<std::byte> output;
+			SnapshotHeader header{ sequence, baseline ? acknowledgedSequence : SnapshotHistory::noSequence, static_cast<std::uint32_t>(nodes.size()), static_cast<std::uint32_t>(changed.size()) };
+			output.resize(sizeof(header));
+			std::memcpy(output.data(), &header, sizeof(header));
+
+			BitWriter writer{ output };
+			std::uint32_t previousIndex = 0;
+			for(std::uint32_t index : changed)
+			{
+				//Gaps are written off by one so that index 0 is still non zero
+				writer.WriteNonZero(index - previousIndex + 1);
+				previousIndex = index;
+
+				const QuantizedTransform& previous = baseline && index < baseline->size() ? (*baseline)[index] : defaultBaseline;
+				std::uint32_t mask = 0;
+				for(std::size_t field = 0; field < QuantizedTransform::fieldCount; field++)
+				{
+					if(current[index].fields[field] != previous.fields[field])
+						mask |= 1u << field;
+				}
+
+				writer.Write(mask, QuantizedTransform::fieldCount);
+				for(std::size_t field = 0; field < QuantizedTransform::fieldCount; field++)
+				{
+					if(mask & (1u << field))
+						writer.WriteNonZero(ZigZag(current[index].fields[field] - previous.fields[field]));
+				}
+			}
+			writer.Flush();
+
+			return output;
+		}
+
+		//Acknowledgements older than the history, or older than the current baseline, are ignored.
+		//Compared like the decoder does so that the sequence can wrap around
+		void Acknowledge(std::uint32_t sequence)
+		{
+			if(!history.Find(sequence))
+				return;
+
+			if(acknowledgedSequence == SnapshotHistory::noSequence || static_cast<std::int32_t>(sequence - acknowledgedSequence) > 0)
+				acknowledgedSequence = sequence;
+		}
+
+		std::uint32_t GetAcknowledgedSequence() const noexcept { return acknowledgedSequence; }
+	};
+
+	export class TransformSnapshotDecoder
+	{
+	public:
+		static constexpr std::uint32_t defaultMaxNodeCount = 1 << 20;
+
+	private:
+		//Smallest encoding of a changed node: the index gap, the field mask and one field
+		static constexpr std::size_t minChangedBits = 5 + 1 + QuantizedTransform::fieldCount + 5 + 1;
+
+		TransformQuantization quantization;
+		SnapshotSpace space;
+		SnapshotHistory history;
+		std::uint32_t maxNodeCount;
+		std::uint32_t latestSequence = SnapshotHistory::noSequence;
+		std::vector<std::uint32_t> lastChanged;
+		//What Apply last wrote to the nodes, packets are relative to their baseline and not to this
+		std::vector<QuantizedTransform> applied;
+
+	public:
+		TransformSnapshotDecoder(SnapshotSpace space = SnapshotSpace::Local, TransformQuantization quantization = {}, std::size_t historySize = 8, std::uint32_t maxNodeCount = defaultMaxNodeCount) :
+			quantization{ quantization },
+			space{ space },
+			history{ historySize },
+			maxNodeCount{ maxNodeCount }
+		{
+
+		}
+
+	public:
+		//Returns false if the packet is malformed, not newer than the last decoded one or refers to a baseline
+		//which is no longer held, in which case nothing is stored and the sender should keep encoding against an older acknowledgement
+		bool Decode(std::span<const std::byte> packet)
+		{
+			SnapshotHeader header;
+			if(packet.size() < sizeof(header))
+				return false;
+			std::memcpy(&header, packet.data(), sizeof(header));
+
+			//Late packets would rewind the replica, compared so that the sequence can wrap around
+			if(latestSequence != SnapshotHistory::noSequence && static_cast<std::int32_t>(header.sequence - latestSequence) <= 0)
+				return false;
+
+			//The header isn't trusted before allocating for it
+			const std::size_t payloadBits = (packet.size() - sizeof(header)) * 8;
+			if(header.nodeCount > maxNodeCount || header.changedCount > header.nodeCount || header.changedCount > payloadBits / minChangedBits)
+				return false;
+
+			const std::vector<QuantizedTransform>* baseline = history.Find(header.baselineSequence);
+			if(header.baselineSequence != SnapshotHistory::noSequence && !baseline)
+				return false;
+
+			const QuantizedTransform defaultBaseline = DefaultBaseline(quantization);
+			std::vector<QuantizedTransform> current(header.nodeCount, defaultBaseline);
+			if(baseline)
+				std::copy_n(baseline->begin(), (std::min)(baseline->size(), current.size()), current.begin());
+
+			BitReader reader{ packet.subspan(sizeof(header)) };
+			std::uint32_t index = 0;
+			for(std::uint32_t i = 0; i < header.changedCount; i++)
+			{
+				index += reader.ReadNonZero() - 1;
+				if(index >= header.nodeCount)
+					return false;
+
+				std::uint32_t mask = reader.Read(QuantizedTransform::fieldCount);
+				for(std::size_t field = 0; field < QuantizedTransform::fieldCount; field++)
+				{
+					//Wraps instead of overflowing on hostile deltas
+					if(mask & (1u << field))
+						current[index].fields[field] = static_cast<std::int32_t>(static_cast<std::uint32_t>(current[index].fields[field]) + static_cast<std::uint32_t>(UnZigZag(reader.ReadNonZero())));
+				}
+			}
+
+			if(reader.Overrun())
+				return false;
+
+			//Against the previously decoded state, a node can be unchanged from the baseline but not from what the replica shows
+			const std::vector<QuantizedTransform>* previous = history.Find(latestSequence);
+			lastChanged.clear();
+			for(std::uint32_t i = 0; i < header.nodeCount; i++)
+			{
+				if(current[i] != (previous && i < previous->size() ? (*previous)[i] : defaultBaseline))
+					lastChanged.push_back(i);
+			}
+
+			history.Store(header.sequence) = std::move(current);
+			latestSequence = header.sequence;
+			return true;
+		}
+
+		//Sequence to send back to the encoder as an acknowledgement
+		std::uint32_t GetLatestSequence() const noexcept { return latestSequence; }
+
+		//Indices of the nodes which differ between the last two decoded snapshots
+		std::span<const std::uint32_t> GetLastChanged() const noexcept { return lastChanged; }
+
+		Transform GetTransform(std::size_t index) const
+		{
+			return Dequantize(history.Find(latestSequence)->at(index), quantization);
+		}
+
+		//Writes the nodes whose state in the last decoded snapshot differs from what the previous Apply wrote,
+		//every node on the first call. World space snapshots need parents to come before their children in nodes.
+		//Returns false without writing anything if nodes isn't as long as the snapshot's node list
+		bool Apply(std::span<TransformNode* const> nodes)
+		{
+			const std::vector<QuantizedTransform>* latest = history.Find(latestSequence);
+			if(!latest)
+				return true;
+			if(nodes.size() != latest->size())
+				return false;
+
+			std::vector<std::uint32_t> changed;
+			for(std::uint32_t i = 0; i < latest->size(); i++)
+			{
+				if(i >= applied.size() || (*latest)[i] != applied[i])
+					changed.push_back(i);
+			}
+			applied = *latest;
+
+			if(space == SnapshotSpace::Local)
+			{
+				for(std::uint32_t index : changed)
+					nodes[index]->LocalTransform() = GetTransform(index);
+			}
+			else
+			{
+				std::vector<TransformNode*> changedNodes;
+				std::vector<Transform> transforms;
+				changedNodes.reserve(changed.size());
+				transforms.reserve(changed.size());
+				for(std::uint32_t index : changed)
+				{
+					changedNodes.push_back(nodes[index]);
+					transforms.push_back(GetTransform(index));
+				}
+				TransformNode::SetWorldTransforms(changedNodes, transforms);
+			}
+			return true;
+		}
+	};
+}
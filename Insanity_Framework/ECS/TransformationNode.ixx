@@ -1,8 +1,10 @@
 module;
 
 #include <vector>
+#include <memory>
 #include <span>
 #include <cassert>
+#include <cmath>
 
 export module InsanityFramework.TransformationNode;
 import xk.Math;
@@ -36,18 +38,23 @@ namespace InsanityFramework
 			return lh.position == rh.position && lh.rotation == rh.rotation && lh.scale == rh.scale;
 		}
 
+		//Composes as translation * rotation around Z * scale
 		xk::Math::Matrix<float, 4, 4> ToMatrix() const noexcept
 		{
-			return xk::Math::ScaleMatrix(scale) * xk::Math::TransformMatrix(position);
+			return xk::Math::TransformMatrix(position) * xk::Math::RotationZMatrix(rotation) * xk::Math::ScaleMatrix(scale);
 		}
 
+		//Inverse of ToMatrix, assumes the matrix only holds a translation, a rotation around Z and a positive scale
 		static Transform FromMatrix(const xk::Math::Matrix<float, 4, 4>& matrix)
 		{
+			const float scaleX = std::sqrt(matrix.At(0, 0) * matrix.At(0, 0) + matrix.At(1, 0) * matrix.At(1, 0));
+			const float scaleY = std::sqrt(matrix.At(0, 1) * matrix.At(0, 1) + matrix.At(1, 1) * matrix.At(1, 1));
+
 			return
 			{
 				{ matrix.At(0, 3), matrix.At(1, 3), matrix.At(2, 3) },
-				{},
-				{ matrix.At(0, 0), matrix.At(1, 1), matrix.At(2, 2) }
+				xk::Math::Degree<float>{ xk::Math::Radian<float>{ std::atan2(matrix.At(1, 0), matrix.At(0, 0)) } },
+				{ scaleX, scaleY, matrix.At(2, 2) }
 			};
 		}
 	};
@@ -76,6 +83,19 @@ namespace InsanityFramework
 		WorldTransformType transform;
 	};
 
+	//Hears about a node's world transform changing without having to poll it, see TransformNode::SetMoveListener.
+	//OnNodeMoved runs on whichever thread moved the node
+	export class TransformMoveListener
+	{
+	public:
+		virtual void OnNodeMoved(TransformNode* node) = 0;
+		//The node is being destroyed, the listener must forget it
+		virtual void OnNodeDestroyed(TransformNode* node) = 0;
+
+	protected:
+		~TransformMoveListener() = default;
+	};
+
 	enum class TransformDestructorLogic
 	{
 		Null_Parent_Keep_Local_Transform,
@@ -509,7 +529,11 @@ namespace InsanityFramework
 		std::vector<TransformNode*> children;
 		Transform local;
 		mutable Transform worldCache;
+		mutable xk::Math::Matrix<float, 4, 4> worldMatrixCache = xk::Math::Matrix<float, 4, 4>::Identity();
 		mutable bool worldCacheDirty = false;
+		mutable bool worldMatrixCacheDirty = false;
+		bool moveReported = false;
+		TransformMoveListener* moveListener = nullptr;
 
 	public:
 		TransformDestructorLogic destructionLogic = TransformDestructorLogic::Reparent_Keep_Local_Transform;
@@ -559,6 +583,15 @@ namespace InsanityFramework
 		}
 
 		~TransformNode()
+		{
+			if(moveListener)
+				moveListener->OnNodeDestroyed(this);
+			Detach();
+		}
+
+		//Applies destructionLogic to the children and leaves the parent, as the destructor does.
+		//Afterwards the node's destructor no longer touches other nodes
+		void Detach()
 		{
 			switch(destructionLogic)
 			{
@@ -650,6 +683,177 @@ namespace InsanityFramework
 			return { this };
 		}
 
+		//A node has at most one listener. It's told about the first change after it was set or after
+		//the last AcknowledgeMove, so a node moving many times in between is reported once
+		void SetMoveListener(TransformMoveListener* listener) noexcept
+		{
+			moveListener = listener;
+			moveReported = false;
+		}
+
+		TransformMoveListener* GetMoveListener() const noexcept { return moveListener; }
+
+		void AcknowledgeMove() noexcept
+		{
+			moveReported = false;
+		}
+
+		//Returns the world transform as a matrix, only rebuilt after the world transform has changed
+		const xk::Math::Matrix<float, 4, 4>& GetWorldMatrix() const
+		{
+			if(worldMatrixCacheDirty)
+			{
+				worldMatrixCache = GetWorldTransform().ToMatrix();
+				worldMatrixCacheDirty = false;
+			}
+
+			return worldMatrixCache;
+		}
+
+		//Batches multiple transform writes into a single commit so the subtree is only marked dirty once.
+		//The parent's world transform is fetched at most once per scope. Commits on destruction
+		class EditScope
+		{
+		private:
+			TransformNode* node;
+			Transform local;
+			mutable Transform parentWorld;
+			mutable bool parentWorldFetched = false;
+			bool changed = false;
+
+		public:
+			EditScope(TransformNode* node) :
+				node{ node },
+				local{ node->local }
+			{
+
+			}
+
+			EditScope(const EditScope&) = delete;
+			EditScope& operator=(const EditScope&) = delete;
+
+			~EditScope()
+			{
+				Commit();
+			}
+
+		public:
+			Transform& Local() noexcept
+			{
+				changed = true;
+				return local;
+			}
+
+			const Transform& GetLocalTransform() const noexcept { return local; }
+			Transform GetWorldTransform() const { return ParentWorld() + local; }
+
+			void SetLocalPosition(xk::Math::Vector<float, 3> position) { Local().position = position; }
+			void SetLocalRotation(xk::Math::Degree<float> rotation) { Local().rotation = rotation; }
+			void SetLocalScale(xk::Math::Vector<float, 3> scale) { Local().scale = scale; }
+			void SetLocalTransform(Transform transform) { Local() = transform; }
+
+			void SetWorldPosition(xk::Math::Vector<float, 3> position) { Local().position = position - ParentWorld().position; }
+			void SetWorldRotation(xk::Math::Degree<float> rotation) { Local().rotation = rotation - ParentWorld().rotation; }
+			void SetWorldScale(xk::Math::Vector<float, 3> scale) { Local().scale = xk::Math::HadamardSafeDivision(scale, ParentWorld().scale); }
+			void SetWorldTransform(Transform transform) { Local() = transform - ParentWorld(); }
+
+			void Commit()
+			{
+				if(!changed)
+					return;
+
+				node->SetLocalTransform(local);
+				changed = false;
+			}
+
+			void Cancel() noexcept
+			{
+				local = node->local;
+				changed = false;
+			}
+
+		private:
+			const Transform& ParentWorld() const
+			{
+				if(!parentWorldFetched)
+				{
+					parentWorld = node->parent ? node->parent->GetWorldTransform() : Transform{};
+					parentWorldFetched = true;
+				}
+				return parentWorld;
+			}
+		};
+
+		EditScope Edit()
+		{
+			return { this };
+		}
+
+		//Sets the world transform of many nodes in one pass, each node's world cache is assigned directly
+		//instead of being marked dirty and recalculated on the next read.
+		//Parents must come before their children in nodes, otherwise a child would be solved against its parent's old transform
+		static void SetWorldTransforms(std::span<TransformNode* const> nodes, std::span<const Transform> transforms)
+		{
+			assert(nodes.size() == transforms.size());
+
+			for(std::size_t i = 0; i < nodes.size(); i++)
+			{
+				TransformNode* node = nodes[i];
+				if(node->parent)
+				{
+					const Transform parentWorld = node->parent->GetWorldTransform();
+					node->local = transforms[i] - parentWorld;
+					node->worldCache = parentWorld + node->local;
+				}
+				else
+				{
+					node->local = transforms[i];
+					node->worldCache = transforms[i];
+				}
+
+				for(TransformNode* child : node->children)
+				{
+					child->SetWorldCacheDirty();
+				}
+
+				node->worldCacheDirty = false;
+				node->worldMatrixCacheDirty = true;
+				node->ReportMove();
+			}
+		}
+
+		//Attaches freshly created nodes to parent without SetParent's cycle check and erase from the old parent.
+		//Every child must be parentless and none of them may be an ancestor of parent
+		static void LinkChildren(TransformNode* parent, std::span<TransformNode* const> newChildren)
+		{
+			parent->children.insert(parent->children.end(), newChildren.begin(), newChildren.end());
+			for(TransformNode* child : newChildren)
+			{
+				assert(!child->parent);
+				child->parent = parent;
+				child->SetWorldCacheDirty();
+			}
+		}
+
+		//Used by scene snapshots, whose rollback copies node bytes back without going through the node.
+		//The children list is the only heap memory of a node: it's freed before the copy, restarted empty
+		//afterwards without reading the stale bytes and refilled by relinking every node to its parent
+		void ReleaseChildrenForRollback() noexcept
+		{
+			std::vector<TransformNode*>{}.swap(children);
+		}
+
+		void ResetChildrenAfterRollback() noexcept
+		{
+			std::construct_at(&children);
+		}
+
+		void RelinkAfterRollback()
+		{
+			if(parent)
+				parent->children.push_back(this);
+		}
+
 	private:
 		void DetectCyclicParent(TransformNode* newParent)
 		{
@@ -778,12 +982,25 @@ namespace InsanityFramework
 		}
 
 	private:
-		void SetWorldCacheDirty() noexcept
+		void ReportMove()
+		{
+			if(moveListener && !moveReported)
+			{
+				moveReported = true;
+				moveListener->OnNodeMoved(this);
+			}
+		}
+
+		//A dirty node was reported when it became dirty, and the listener reads it before acknowledging
+		//which cleans it again, so only the transition to dirty has to report
+		void SetWorldCacheDirty()
 		{
 			if(worldCacheDirty)
 				return;
 
 			worldCacheDirty = true;
+			worldMatrixCacheDirty = true;
+			ReportMove();
 
 			for(TransformNode* node : children)
 			{
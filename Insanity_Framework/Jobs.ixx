@@ -0,0 +1,509 @@
+module;
+
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <array>
+#include <memory>
+#include <new>
+#include <random>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+export module InsanityFramework.Jobs;
+import InsanityFramework.Allocator;
+
+namespace InsanityFramework
+{
+	export class JobSystem;
+
+	class Job
+	{
+		friend JobSystem;
+
+	public:
+		static constexpr std::size_t inlineSize = 64;
+		static constexpr std::size_t spillSize = 512;
+		static constexpr std::size_t maxDependents = 8;
+
+	private:
+		//Runs the payload then destroys it
+		void(*invoke)(void* payload) = nullptr;
+		void* payload = nullptr;
+		bool spilled = false;
+
+		Job* parent = nullptr;
+		//Itself plus unfinished children
+		std::atomic<std::int32_t> unfinished = 0;
+		//Unfinished prerequisites plus one until submitted
+		std::atomic<std::int32_t> dependencies = 0;
+		//Bumped once the job is complete, handles with an older generation refer to a finished job
+		std::atomic<std::uint32_t> generation = 0;
+		std::uint32_t owner = 0;
+
+		std::atomic_flag dependentsLock;
+		bool completed = false;
+		std::uint32_t dependentCount = 0;
+		std::array<Job*, maxDependents> dependents{};
+
+		Job* nextFree = nullptr;
+		alignas(std::max_align_t) std::byte storage[inlineSize];
+	};
+
+	export struct JobHandle
+	{
+		Job* job = nullptr;
+		std::uint32_t generation = 0;
+
+		explicit operator bool() const noexcept { return job != nullptr; }
+	};
+
+	//Chase-Lev deque, the owner pushes and pops the bottom while other participants steal from the top
+	class WorkStealingDeque
+	{
+		static constexpr std::int64_t capacity = 4096;
+
+		alignas(std::hardware_destructive_interference_size) std::atomic<std::int64_t> top = 0;
+		alignas(std::hardware_destructive_interference_size) std::atomic<std::int64_t> bottom = 0;
+		std::unique_ptr<std::atomic<Job*>[]> buffer = std::make_unique<std::atomic<Job*>[]>(capacity);
+
+	public:
+		//Returns false when full, the caller is expected to run the job itself
+		bool Push(Job* job)
+		{
+			std::int64_t b = bottom.load(std::memory_order_relaxed);
+			std::int64_t t = top.load(std::memory_order_acquire);
+			if(b - t >= capacity)
+				return false;
+
+			buffer[b & (capacity - 1)].store(job, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		Job* Pop()
+		{
+			std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::int64_t t = top.load(std::memory_order_relaxed);
+
+			if(t > b)
+			{
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			Job* job = buffer[b & (capacity - 1)].load(std::memory_order_relaxed);
+			if(t == b)
+			{
+				//Last job, race thieves for it
+				if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					job = nullptr;
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		Job* Steal()
+		{
+			std::int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::int64_t b = bottom.load(std::memory_order_acquire);
+			if(t >= b)
+				return nullptr;
+
+			Job* job = buffer[t & (capacity - 1)].load(std::memory_order_relaxed);
+			if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return job;
+		}
+	};
+
+	struct alignas(std::hardware_destructive_interference_size) JobParticipant
+	{
+		static constexpr std::size_t jobsPerBlock = 1024;
+		static constexpr std::size_t spillBucketsPerBlock = 64;
+
+		using SpillAllocator = PoolAllocator<Job::spillSize>;
+
+		WorkStealingDeque deque;
+
+		std::vector<std::unique_ptr<Job[]>> jobBlocks;
+		Job* freeJobs = nullptr;
+		//Jobs completed on other participants, handed back through a lock free stack
+		std::atomic<Job*> remoteFreeJobs = nullptr;
+
+		std::vector<std::unique_ptr<std::byte[]>> spillBlocks;
+		std::vector<SpillAllocator> spillAllocators;
+
+		std::minstd_rand random;
+		std::atomic<std::size_t> executed = 0;
+	};
+
+	thread_local JobSystem* currentJobSystem = nullptr;
+	thread_local std::uint32_t currentParticipant = 0;
+
+	//Fixed set of worker threads plus the thread that created the system, which takes part while it waits.
+	//Jobs may only be created, submitted and waited on from those threads
+	export class JobSystem
+	{
+	private:
+		std::thread::id ownerThread = std::this_thread::get_id();
+		std::unique_ptr<JobParticipant[]> participants;
+		std::size_t participantCount;
+		std::vector<std::jthread> workers;
+
+		std::atomic<std::uint64_t> workSignal = 0;
+		std::atomic<std::uint32_t> sleepingWorkers = 0;
+		std::atomic<bool> stopping = false;
+
+	public:
+		JobSystem(std::size_t threadCount = (std::max)(std::thread::hardware_concurrency(), 1u)) :
+			participants{ std::make_unique<JobParticipant[]>((std::max)(threadCount, std::size_t{ 1 })) },
+			participantCount{ (std::max)(threadCount, std::size_t{ 1 }) }
+		{
+			for(std::size_t i = 0; i < participantCount; i++)
+				participants[i].random.seed(static_cast<std::uint32_t>(i + 1));
+
+			for(std::size_t i = 1; i < participantCount; i++)
+				workers.emplace_back([this, i] { WorkerLoop(static_cast<std::uint32_t>(i)); });
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		~JobSystem()
+		{
+			stopping.store(true);
+			workSignal.fetch_add(1);
+			workSignal.notify_all();
+			workers.clear();
+		}
+
+	public:
+		//Creates a job which doesn't run until submitted. Children keep their parent from completing until they complete
+		template<class Func>
+		JobHandle Create(Func&& func, JobHandle parent = {})
+		{
+			using Payload = std::decay_t<Func>;
+			static_assert(sizeof(Payload) <= Job::spillSize, "Job payload is too large");
+			static_assert(sizeof(Payload) <= Job::inlineSize ? alignof(Payload) <= alignof(std::max_align_t) : alignof(Payload) <= alignof(void*), "Job payload is over aligned");
+
+			const std::uint32_t index = ParticipantIndex();
+			Job* job = AllocateJob(index);
+			if constexpr(sizeof(Payload) <= Job::inlineSize)
+			{
+				job->payload = job->storage;
+				job->spilled = false;
+			}
+			else
+			{
+				job->payload = AllocateSpill(index);
+				job->spilled = true;
+			}
+
+			std::construct_at(static_cast<Payload*>(job->payload), std::forward<Func>(func));
+			job->invoke = [](void* payload)
+			{
+				Payload& function = *std::launder(static_cast<Payload*>(payload));
+				function();
+				std::destroy_at(&function);
+			};
+
+			job->unfinished.store(1, std::memory_order_relaxed);
+			job->dependencies.store(1, std::memory_order_relaxed);
+			job->completed = false;
+			job->dependentCount = 0;
+			job->parent = parent.job;
+			if(parent)
+			{
+				assert(!IsDone(parent));
+				parent.job->unfinished.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			return { job, job->generation.load(std::memory_order_relaxed) };
+		}
+
+		//Job won't run before prerequisite completes, job must not have been submitted yet
+		void AddDependency(JobHandle job, JobHandle prerequisite)
+		{
+			assert(!IsDone(job));
+			if(!prerequisite)
+				return;
+
+			Job* target = prerequisite.job;
+			while(target->dependentsLock.test_and_set(std::memory_order_acquire));
+
+			if(target->generation.load(std::memory_order_acquire) == prerequisite.generation && !target->completed)
+			{
+				assert(target->dependentCount < Job::maxDependents);
+				job.job->dependencies.fetch_add(1, std::memory_order_relaxed);
+				target->dependents[target->dependentCount++] = job.job;
+			}
+
+			target->dependentsLock.clear(std::memory_order_release);
+		}
+
+		void Submit(JobHandle job)
+		{
+			if(job.job->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				Schedule(job.job);
+		}
+
+		template<class Func>
+		JobHandle Run(Func&& func, JobHandle parent = {})
+		{
+			JobHandle job = Create(std::forward<Func>(func), parent);
+			Submit(job);
+			return job;
+		}
+
+		bool IsDone(JobHandle job) const noexcept
+		{
+			return !job || job.job->generation.load(std::memory_order_acquire) != job.generation;
+		}
+
+		//Runs other jobs on the calling thread until job is done
+		void Wait(JobHandle job)
+		{
+			const std::uint32_t index = ParticipantIndex();
+			while(!IsDone(job))
+			{
+				if(Job* next = FindJob(index))
+					Execute(next, index);
+				else
+					std::this_thread::yield();
+			}
+		}
+
+		//Calls func(begin, end) over sub ranges of [0, count). Ranges are split in half recursively inside
+		//jobs until they are at most grain long, a grain of 0 aims for 8 ranges per participant
+		template<class Func>
+		void ParallelFor(std::size_t count, Func&& func, std::size_t grain = 0)
+		{
+			if(count == 0)
+				return;
+
+			if(grain == 0)
+				grain = (std::max)(std::size_t{ 1 }, count / (participantCount * 8));
+
+			JobHandle root = Create([] {});
+			Run([this, root, count, grain, &func] { SplitRange(root, 0, count, grain, func); }, root);
+			Submit(root);
+			Wait(root);
+		}
+
+		std::size_t ThreadCount() const noexcept { return participantCount; }
+
+		//Whether the calling thread may create and wait on jobs, which only the owner and the workers can
+		bool IsParticipant() const noexcept
+		{
+			return currentJobSystem == this || std::this_thread::get_id() == ownerThread;
+		}
+
+		//Index of the calling thread in [0, ThreadCount())
+		std::size_t CurrentParticipant() const { return ParticipantIndex(); }
+
+		//Jobs run by each participant since the last reset, participant 0 is the owning thread
+		std::size_t ExecutedBy(std::size_t participant) const noexcept { return participants[participant].executed.load(std::memory_order_relaxed); }
+
+		void ResetStatistics()
+		{
+			for(std::size_t i = 0; i < participantCount; i++)
+				participants[i].executed.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		std::uint32_t ParticipantIndex() const
+		{
+			if(currentJobSystem == this)
+				return currentParticipant;
+
+			assert(std::this_thread::get_id() == ownerThread);
+			return 0;
+		}
+
+		template<class Func>
+		void SplitRange(JobHandle root, std::size_t begin, std::size_t end, std::size_t grain, Func& func)
+		{
+			while(end - begin > grain)
+			{
+				std::size_t middle = begin + (end - begin) / 2;
+				Run([this, root, middle, end, grain, &func] { SplitRange(root, middle, end, grain, func); }, root);
+				end = middle;
+			}
+			func(begin, end);
+		}
+
+		void WorkerLoop(std::uint32_t index)
+		{
+			currentJobSystem = this;
+			currentParticipant = index;
+
+			while(true)
+			{
+				std::uint64_t signal = workSignal.load();
+				if(Job* job = FindJob(index))
+				{
+					Execute(job, index);
+					continue;
+				}
+
+				if(stopping.load())
+					return;
+
+				//Pushes after the signal was read change it, so the wait can't miss them
+				sleepingWorkers.fetch_add(1);
+				if(workSignal.load() == signal)
+					workSignal.wait(signal);
+				sleepingWorkers.fetch_sub(1);
+			}
+		}
+
+		Job* FindJob(std::uint32_t index)
+		{
+			JobParticipant& self = participants[index];
+			if(Job* job = self.deque.Pop())
+				return job;
+
+			if(participantCount == 1)
+				return nullptr;
+
+			const std::size_t start = self.random() % participantCount;
+			for(std::size_t i = 0; i < participantCount; i++)
+			{
+				const std::size_t victim = (start + i) % participantCount;
+				if(victim == index)
+					continue;
+
+				if(Job* job = participants[victim].deque.Steal())
+					return job;
+			}
+			return nullptr;
+		}
+
+		void Schedule(Job* job)
+		{
+			const std::uint32_t index = ParticipantIndex();
+			if(!participants[index].deque.Push(job))
+			{
+				Execute(job, index);
+				return;
+			}
+
+			workSignal.fetch_add(1);
+			if(sleepingWorkers.load() > 0)
+				workSignal.notify_one();
+		}
+
+		void Execute(Job* job, std::uint32_t index)
+		{
+			job->invoke(job->payload);
+			participants[index].executed.fetch_add(1, std::memory_order_relaxed);
+			Finish(job);
+		}
+
+		void Finish(Job* job)
+		{
+			if(job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+
+			while(job->dependentsLock.test_and_set(std::memory_order_acquire));
+			job->completed = true;
+			const std::uint32_t dependentCount = job->dependentCount;
+			const std::array<Job*, Job::maxDependents> dependents = job->dependents;
+			job->dependentsLock.clear(std::memory_order_release);
+
+			for(std::uint32_t i = 0; i < dependentCount; i++)
+			{
+				if(dependents[i]->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					Schedule(dependents[i]);
+			}
+
+			Job* parent = job->parent;
+			job->generation.fetch_add(1, std::memory_order_release);
+			ReleaseJob(job);
+
+			if(parent)
+				Finish(parent);
+		}
+
+		Job* AllocateJob(std::uint32_t index)
+		{
+			JobParticipant& self = participants[index];
+			if(!self.freeJobs)
+				self.freeJobs = self.remoteFreeJobs.exchange(nullptr, std::memory_order_acquire);
+
+			if(!self.freeJobs)
+			{
+				auto& block = self.jobBlocks.emplace_back(std::make_unique<Job[]>(JobParticipant::jobsPerBlock));
+				for(std::size_t i = 0; i < JobParticipant::jobsPerBlock; i++)
+				{
+					block[i].owner = index;
+					block[i].nextFree = i + 1 < JobParticipant::jobsPerBlock ? &block[i + 1] : nullptr;
+				}
+				self.freeJobs = &block[0];
+			}
+
+			Job* job = self.freeJobs;
+			self.freeJobs = job->nextFree;
+
+			//Spilled payloads go back to the owner's pool once the job is reused so only the owner touches it
+			if(job->spilled)
+			{
+				FreeSpill(index, job->payload);
+				job->spilled = false;
+			}
+			return job;
+		}
+
+		void ReleaseJob(Job* job)
+		{
+			JobParticipant& owner = participants[job->owner];
+			if(currentJobSystem == this ? currentParticipant == job->owner : job->owner == 0)
+			{
+				job->nextFree = owner.freeJobs;
+				owner.freeJobs = job;
+				return;
+			}
+
+			Job* head = owner.remoteFreeJobs.load(std::memory_order_relaxed);
+			do
+			{
+				job->nextFree = head;
+			} while(!owner.remoteFreeJobs.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		void* AllocateSpill(std::uint32_t index)
+		{
+			JobParticipant& self = participants[index];
+			for(auto& allocator : self.spillAllocators)
+			{
+				if(void* ptr = allocator.Allocate(Job::spillSize))
+					return ptr;
+			}
+
+			const std::size_t blockSize = JobParticipant::SpillAllocator::alignedBucketSize * JobParticipant::spillBucketsPerBlock + alignof(std::max_align_t);
+			auto& block = self.spillBlocks.emplace_back(std::make_unique<std::byte[]>(blockSize));
+			return self.spillAllocators.emplace_back(BufferView{ block.get(), blockSize }).Allocate(Job::spillSize);
+		}
+
+		void FreeSpill(std::uint32_t index, void* ptr)
+		{
+			for(auto& allocator : participants[index].spillAllocators)
+			{
+				if(allocator.Contains(ptr))
+				{
+					allocator.Free(ptr);
+					return;
+				}
+			}
+			assert(false);
+		}
+	};
+}
@@ -0,0 +1,176 @@
+module;
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <typeinfo>
+#include <typeindex>
+#include <type_traits>
+#include <unordered_map>
+#include <exception>
+#include <utility>
+
+export module InsanityFramework.TypeID;
+
+namespace InsanityFramework
+{
+	//Small dense id per type, handed out on first use and stable for the rest of the process
+	export using TypeID = std::uint32_t;
+	export constexpr TypeID invalidTypeID = ~TypeID{ 0 };
+
+	class TypeRegistry
+	{
+	public:
+		static TypeID Register(const std::type_info& type)
+		{
+			//Function statics so ids can be handed out while other statics are initialized
+			static std::mutex mutex;
+			static std::unordered_map<std::type_index, TypeID> ids;
+
+			std::scoped_lock lock{ mutex };
+			return ids.try_emplace(type, static_cast<TypeID>(ids.size())).first->second;
+		}
+	};
+
+	export template<class Ty>
+	TypeID GetTypeID()
+	{
+		static const TypeID id = TypeRegistry::Register(typeid(Ty));
+		return id;
+	}
+
+	//For dynamic types, locks and hashes unlike the template version
+	export TypeID GetTypeID(const std::type_info& type)
+	{
+		return TypeRegistry::Register(type);
+	}
+
+	//Map keyed by TypeID, a lookup is a bounds check and a load from an array indexed by the id.
+	//Entries are heap allocated so values keep their address, iteration is in insertion order until something is erased
+	export template<class Value>
+	class TypeMap
+	{
+	public:
+		struct Entry
+		{
+			TypeID type;
+			Value value;
+		};
+
+		class Iterator
+		{
+			using Base = typename std::vector<std::unique_ptr<Entry>>::const_iterator;
+
+		private:
+			Base iterator;
+
+		public:
+			Iterator(Base iterator) :
+				iterator{ iterator }
+			{
+
+			}
+
+			Entry& operator*() const noexcept { return **iterator; }
+			Entry* operator->() const noexcept { return iterator->get(); }
+
+			Iterator& operator++() noexcept
+			{
+				++iterator;
+				return *this;
+			}
+
+			bool operator==(const Iterator& other) const noexcept = default;
+		};
+
+	private:
+		std::vector<Entry*> index;
+		std::vector<std::unique_ptr<Entry>> entries;
+
+	public:
+		TypeMap() = default;
+		TypeMap(TypeMap&&) noexcept = default;
+		TypeMap& operator=(TypeMap&&) noexcept = default;
+
+	public:
+		Value* Find(TypeID type) noexcept
+		{
+			return type < index.size() && index[type] ? &index[type]->value : nullptr;
+		}
+
+		const Value* Find(TypeID type) const noexcept
+		{
+			return type < index.size() && index[type] ? &index[type]->value : nullptr;
+		}
+
+		bool Contains(TypeID type) const noexcept
+		{
+			return Find(type) != nullptr;
+		}
+
+		Value& At(TypeID type)
+		{
+			if(Value* value = Find(type))
+				return *value;
+
+			throw std::exception("Type isn't in the map");
+		}
+
+		const Value& At(TypeID type) const
+		{
+			if(const Value* value = Find(type))
+				return *value;
+
+			throw std::exception("Type isn't in the map");
+		}
+
+		//Constructs the value from args if type isn't in the map yet, returns the value and whether it was inserted
+		template<class... Args>
+		std::pair<Value*, bool> TryEmplace(TypeID type, Args&&... args)
+		{
+			assert(type != invalidTypeID);
+			if(Value* value = Find(type))
+				return { value, false };
+
+			if(type >= index.size())
+				index.resize(type + 1);
+
+			entries.push_back(std::unique_ptr<Entry>{ new Entry{ type, Value(std::forward<Args>(args)...) } });
+			index[type] = entries.back().get();
+			return { &entries.back()->value, true };
+		}
+
+		Value& operator[](TypeID type)
+		{
+			return *TryEmplace(type).first;
+		}
+
+		//Moves the last entry into the erased one's place
+		bool Erase(TypeID type)
+		{
+			if(!Contains(type))
+				return false;
+
+			auto it = std::find_if(entries.begin(), entries.end(), [&](const auto& entry) { return entry->type == type; });
+			std::swap(*it, entries.back());
+			entries.pop_back();
+			index[type] = nullptr;
+			return true;
+		}
+
+		void Clear() noexcept
+		{
+			index.clear();
+			entries.clear();
+		}
+
+		std::size_t Size() const noexcept { return entries.size(); }
+		bool Empty() const noexcept { return entries.empty(); }
+
+		Iterator begin() const noexcept { return { entries.begin() }; }
+		Iterator end() const noexcept { return { entries.end() }; }
+	};
+}
@@ -1,8 +1,38 @@
 #include "pch.h"
 #include "CppUnitTest.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 import InsanityFramework.ECS.Scene;
+import InsanityFramework.ECS.SceneGlobals;
+import InsanityFramework.ECS.SpatialIndex;
+import InsanityFramework.ECS.Broadphase;
+import InsanityFramework.ECS.TransformSnapshot;
+import InsanityFramework.Jobs;
+import InsanityFramework.ECS.SceneScheduler;
+import InsanityFramework.ECS.SceneManager;
+import InsanityFramework.ECS.SceneFile;
+import InsanityFramework.ECS.Prefab;
+import InsanityFramework.TypeID;
+import InsanityFramework.ECS.TickScheduler;
+import InsanityFramework.AssetLoader;
 import xk.Math;
 
 using namespace InsanityFramework;
@@ -10,6 +40,22 @@ using namespace xk::Math;
 
 namespace InsanityFrameworkTest
 {
+	//Owns a scene group with a single scene and makes it the active scene for the duration of a test
+	struct TestScene
+	{
+		UniqueSceneGroupHandle group = SceneGroup::New();
+		UniqueSceneHandle scene = group->NewScene();
+
+		TestScene() { activeScene = scene.get(); }
+		~TestScene() { activeScene = nullptr; }
+	};
+
+	class TestObject : public GameObject
+	{
+	public:
+		using GameObject::GameObject;
+	};
+
 	TEST_CLASS(ParentingTests)
 	{
 	public:
@@ -584,4 +630,3441 @@ namespace InsanityFrameworkTest
 			Assert::IsTrue(t3.WorldTransform().Rotation() == t2.WorldTransform().Rotation().Get() + t3.LocalTransform().Rotation());
 		}
 	};
+
+	TEST_CLASS(WorldMatrixTests)
+	{
+		TEST_METHOD(MatrixRoundTrip)
+		{
+			Transform transform{ { 10.f, -5.f, 2.f }, Degree<float>{ 30.f }, { 2.f, 3.f, 1.f } };
+			Transform result = Transform::FromMatrix(transform.ToMatrix());
+
+			Assert::AreEqual(transform.position.X(), result.position.X(), 0.0001f);
+			Assert::AreEqual(transform.position.Y(), result.position.Y(), 0.0001f);
+			Assert::AreEqual(transform.position.Z(), result.position.Z(), 0.0001f);
+			Assert::AreEqual(Radian<float>(transform.rotation)._value, Radian<float>(result.rotation)._value, 0.0001f);
+			Assert::AreEqual(transform.scale.X(), result.scale.X(), 0.0001f);
+			Assert::AreEqual(transform.scale.Y(), result.scale.Y(), 0.0001f);
+		}
+
+		TEST_METHOD(CachedMatrixFollowsParent)
+		{
+			TransformNode t1;
+			TransformNode t2;
+
+			t2.SetParent(&t1);
+			t2.LocalTransform().Position() = Vector<float, 2>{ 10, 10 };
+			Assert::IsTrue(t2.GetWorldMatrix() == t2.WorldTransform().Get().ToMatrix());
+
+			t1.LocalTransform().Rotation() = Degree<float>{ 45 };
+			Assert::IsTrue(t2.GetWorldMatrix() == t2.WorldTransform().Get().ToMatrix());
+		}
+	};
+
+	TEST_CLASS(TransformEditTests)
+	{
+		TEST_METHOD(EditScopeCommitsOnDestruction)
+		{
+			TransformNode t1;
+			TransformNode t2;
+
+			t2.SetParent(&t1);
+			t1.WorldTransform().Position() = Vector<float, 2>{ 10, 10 };
+
+			{
+				auto edit = t2.Edit();
+				edit.SetWorldPosition({ 30.f, 30.f, 0.f });
+				edit.SetLocalRotation(Degree<float>{ 15 });
+				edit.SetLocalScale({ 2.f, 2.f, 1.f });
+
+				Assert::IsTrue(t2.LocalTransform().Position().Get() == Vector<float, 2>{});
+			}
+
+			Assert::IsTrue(t2.WorldTransform().Position().Get() == Vector<float, 2>{ 30.f, 30.f });
+			Assert::IsTrue(t2.LocalTransform().Position().Get() == Vector<float, 2>{ 20.f, 20.f });
+			Assert::IsTrue(t2.WorldTransform().Rotation() == Degree<float>{ 15 });
+		}
+
+		TEST_METHOD(EditScopeCancel)
+		{
+			TransformNode t1;
+
+			{
+				auto edit = t1.Edit();
+				edit.SetWorldPosition({ 30.f, 30.f, 0.f });
+				edit.Cancel();
+			}
+
+			Assert::IsTrue(t1.WorldTransform().Position().Get() == Vector<float, 2>{});
+		}
+
+		TEST_METHOD(BulkSetWorldTransforms)
+		{
+			TransformNode t1;
+			TransformNode t2;
+			TransformNode t3;
+
+			t2.SetParent(&t1);
+			t3.SetParent(&t2);
+
+			TransformNode* nodes[] = { &t1, &t2 };
+			Transform transforms[] = { { { 10.f, 10.f, 0.f } }, { { 15.f, 20.f, 0.f } } };
+			TransformNode::SetWorldTransforms(nodes, transforms);
+
+			Assert::IsTrue(t1.WorldTransform().Position().Get() == Vector<float, 2>{ 10.f, 10.f });
+			Assert::IsTrue(t2.WorldTransform().Position().Get() == Vector<float, 2>{ 15.f, 20.f });
+			Assert::IsTrue(t2.LocalTransform().Position().Get() == Vector<float, 2>{ 5.f, 10.f });
+			Assert::IsTrue(t3.WorldTransform().Position().Get() == Vector<float, 2>{ 15.f, 20.f });
+		}
+	};
+
+	TEST_CLASS(SpatialIndexTests)
+	{
+		TEST_METHOD(RadiusAndAABBQueries)
+		{
+			TransformNode nodes[3];
+			nodes[0].WorldTransform().Position() = Vector<float, 2>{ 0, 0 };
+			nodes[1].WorldTransform().Position() = Vector<float, 2>{ 3, 0 };
+			nodes[2].WorldTransform().Position() = Vector<float, 2>{ 50, 50 };
+
+			SpatialIndex<2> index{ 4.f };
+			for(TransformNode& node : nodes)
+				index.Insert(&node);
+
+			Assert::AreEqual<std::size_t>(2, index.QueryRadius({ 1.f, 0.f, 0.f }, 2.5f).size());
+			Assert::AreEqual<std::size_t>(1, index.QueryAABB({ 40.f, 40.f, 0.f }, { 60.f, 60.f, 0.f }).size());
+			Assert::IsTrue(index.Nearest({ 2.f, 0.f, 0.f }, 5.f) == &nodes[1]);
+		}
+
+		TEST_METHOD(MovedNodesChangeCells)
+		{
+			TransformNode node;
+			SpatialIndex<2> index{ 4.f };
+			index.Insert(&node);
+
+			node.WorldTransform().Position() = Vector<float, 2>{ 100, 100 };
+			Assert::AreEqual<std::size_t>(1, index.Update());
+			Assert::IsTrue(index.QueryRadius({}, 10.f).empty());
+			Assert::AreEqual<std::size_t>(1, index.QueryRadius({ 100.f, 100.f, 0.f }, 1.f).size());
+
+			index.Remove(&node);
+			Assert::AreEqual<std::size_t>(0, index.Size());
+		}
+
+		TEST_METHOD(DestroyedNodesLeaveTheIndex)
+		{
+			TestScene testScene;
+			SpatialIndex<2> index{ 4.f };
+			TestObject* object = Scene::NewObject<TestObject>().release();
+			index.Insert(object);
+			{
+				TransformNode node;
+				index.Insert(&node);
+				node.WorldTransform().Position() = Vector<float, 2>{ 10, 10 };
+				Assert::AreEqual<std::size_t>(2, index.Size());
+			}
+			Assert::AreEqual<std::size_t>(1, index.Size());
+
+			object->WorldTransform().Position() = Vector<float, 2>{ 20, 20 };
+			Scene::DeleteObject(object);
+			Assert::AreEqual<std::size_t>(0, index.Size());
+			//Both nodes were reported as moved before they were destroyed
+			Assert::AreEqual<std::size_t>(0, index.Update());
+		}
+
+		TEST_METHOD(FarPositionsShareTheOutermostCells)
+		{
+			TransformNode node;
+			node.WorldTransform().Position() = Vector<float, 2>{ 1e30f, -1e30f };
+			SpatialIndex<2> index{ 1.f };
+			index.Insert(&node);
+
+			Assert::IsTrue(index.Nearest({ 1e30f, -1e30f, 0.f }, 1.f) == &node);
+			Assert::IsTrue(index.QueryRadius({}, 10.f).empty());
+		}
+
+		TEST_METHOD(KNearestIsOrdered)
+		{
+			TransformNode nodes[5];
+			SpatialIndex<2> index{ 2.f };
+			for(int i = 0; i < 5; i++)
+			{
+				nodes[i].WorldTransform().Position() = Vector<float, 2>{ static_cast<float>(i * 3), 0 };
+				index.Insert(&nodes[i]);
+			}
+
+			auto result = index.KNearest({ 7.f, 0.f, 0.f }, 3);
+			Assert::AreEqual<std::size_t>(3, result.size());
+			Assert::IsTrue(result[0] == &nodes[2]);
+			Assert::IsTrue(result[1] == &nodes[3]);
+			Assert::IsTrue(result[2] == &nodes[1]);
+		}
+
+		TEST_METHOD(RaycastHitsClosest)
+		{
+			TransformNode nodes[2];
+			nodes[0].WorldTransform().Position() = Vector<float, 2>{ 10, 0 };
+			nodes[1].WorldTransform().Position() = Vector<float, 2>{ 20, 0 };
+
+			SpatialIndex<2> index{ 4.f };
+			index.Insert(&nodes[1], 1.f);
+			index.Insert(&nodes[0], 1.f);
+
+			auto hit = index.Raycast({}, { 1.f, 0.f, 0.f }, 100.f);
+			Assert::IsTrue(hit.has_value());
+			Assert::IsTrue(hit->node == &nodes[0]);
+			Assert::AreEqual(9.f, hit->distance, 0.0001f);
+			Assert::IsFalse(index.Raycast({}, { 0.f, 1.f, 0.f }, 100.f).has_value());
+		}
+
+		TEST_METHOD(Benchmark100kMovingObjects)
+		{
+			constexpr std::size_t count = 100'000;
+			auto nodes = std::make_unique<TransformNode[]>(count);
+			std::mt19937 random{ 0 };
+			std::uniform_real_distribution<float> position{ -1000.f, 1000.f };
+			std::uniform_real_distribution<float> velocity{ -1.f, 1.f };
+
+			SpatialIndex<2> index{ 8.f };
+			for(std::size_t i = 0; i < count; i++)
+			{
+				nodes[i].WorldTransform().Position() = Vector<float, 2>{ position(random), position(random) };
+				index.Insert(&nodes[i], 0.5f);
+			}
+
+			using Clock = std::chrono::steady_clock;
+			Clock::duration updateTime{};
+			Clock::duration queryTime{};
+			std::size_t found = 0;
+			constexpr int frames = 10;
+			for(int frame = 0; frame < frames; frame++)
+			{
+				for(std::size_t i = 0; i < count; i++)
+					nodes[i].LocalTransform().Position() += Vector<float, 3>{ velocity(random), velocity(random), 0.f };
+
+				auto start = Clock::now();
+				index.Update();
+				updateTime += Clock::now() - start;
+
+				start = Clock::now();
+				for(int query = 0; query < 1000; query++)
+					found += index.QueryRadius({ position(random), position(random), 0.f }, 10.f).size();
+				queryTime += Clock::now() - start;
+			}
+
+			Logger::WriteMessage(std::format("SpatialIndex 100k: update {}us/frame, 1000 radius queries {}us/frame, {} hits\n",
+				std::chrono::duration_cast<std::chrono::microseconds>(updateTime).count() / frames,
+				std::chrono::duration_cast<std::chrono::microseconds>(queryTime).count() / frames,
+				found).c_str());
+		}
+	};
+
+	TEST_CLASS(BroadphaseTests)
+	{
+		TEST_METHOD(BeginStayEndOverlaps)
+		{
+			TestScene testScene;
+			UniqueObject<TestObject> a = Scene::NewObject<TestObject>();
+			UniqueObject<TestObject> b = Scene::NewObject<TestObject>();
+			b->WorldTransform().Position() = Vector<float, 2>{ 1.5f, 0 };
+
+			Broadphase<2> broadphase;
+			broadphase.Register(a.get(), { 1.f, 1.f, 1.f });
+			broadphase.Register(b.get(), { 1.f, 1.f, 1.f });
+
+			broadphase.Update();
+			Assert::AreEqual<std::size_t>(1, broadphase.GetBeginOverlaps().size());
+			Assert::AreEqual<std::size_t>(0, broadphase.GetStayOverlaps().size());
+
+			broadphase.Update();
+			Assert::AreEqual<std::size_t>(0, broadphase.GetBeginOverlaps().size());
+			Assert::AreEqual<std::size_t>(1, broadphase.GetStayOverlaps().size());
+
+			b->WorldTransform().Position() = Vector<float, 2>{ 0, 5.f };
+			broadphase.Update();
+			Assert::AreEqual<std::size_t>(0, broadphase.GetStayOverlaps().size());
+			Assert::AreEqual<std::size_t>(1, broadphase.GetEndOverlaps().size());
+			Assert::IsTrue(broadphase.GetEndOverlaps()[0].first == a.get() || broadphase.GetEndOverlaps()[0].second == a.get());
+		}
+
+		TEST_METHOD(RotationWidensBounds)
+		{
+			TestScene testScene;
+			UniqueObject<TestObject> a = Scene::NewObject<TestObject>();
+			UniqueObject<TestObject> b = Scene::NewObject<TestObject>();
+			a->WorldTransform().Rotation() = Degree<float>{ 90 };
+			b->WorldTransform().Position() = Vector<float, 2>{ 0, 3.f };
+
+			Broadphase<2> broadphase;
+			broadphase.Register(a.get(), { 0.5f, 2.5f, 1.f });
+			broadphase.Register(b.get(), { 0.5f, 0.5f, 1.f });
+
+			broadphase.Update();
+			Assert::AreEqual<std::size_t>(0, broadphase.GetBeginOverlaps().size());
+		}
+
+		TEST_METHOD(UnregisteredAndDestroyedBodiesLeave)
+		{
+			TestScene testScene;
+			std::vector<UniqueObject<TestObject>> objects;
+			for(int i = 0; i < 4; i++)
+				objects.push_back(Scene::NewObject<TestObject>());
+
+			Broadphase<2> broadphase;
+			std::vector<BroadphaseBodyID> ids;
+			for(auto& object : objects)
+				ids.push_back(broadphase.Register(object.get(), { 1.f, 1.f, 1.f }));
+			broadphase.Update();
+			Assert::AreEqual<std::size_t>(6, broadphase.GetBeginOverlaps().size());
+
+			broadphase.Unregister(ids[1]);
+			Scene::DeleteObject(objects[2].release());
+			Assert::AreEqual<std::size_t>(2, broadphase.Size());
+
+			//The freed ids aren't reused before the pairs which still refer to them are gone
+			UniqueObject<TestObject> added = Scene::NewObject<TestObject>();
+			const BroadphaseBodyID addedID = broadphase.Register(added.get(), { 1.f, 1.f, 1.f });
+			Assert::IsTrue(addedID != ids[1] && addedID != ids[2]);
+
+			broadphase.Update();
+			Assert::AreEqual<std::size_t>(2, broadphase.GetBeginOverlaps().size());
+			Assert::AreEqual<std::size_t>(1, broadphase.GetStayOverlaps().size());
+			Assert::AreEqual<std::size_t>(0, broadphase.GetEndOverlaps().size());
+		}
+
+		TEST_METHOD(Benchmark50kBodies)
+		{
+			TestScene testScene;
+			constexpr std::size_t count = 50'000;
+			std::mt19937 random{ 0 };
+			std::uniform_real_distribution<float> position{ -2000.f, 2000.f };
+			std::uniform_real_distribution<float> velocity{ -0.5f, 0.5f };
+
+			std::vector<UniqueObject<TestObject>> objects;
+			objects.reserve(count);
+			for(std::size_t i = 0; i < count; i++)
+			{
+				objects.push_back(Scene::NewObject<TestObject>());
+				objects.back()->WorldTransform().Position() = Vector<float, 2>{ position(random), position(random) };
+			}
+
+			for(std::size_t threads : { 1, 4 })
+			{
+				JobSystem jobs{ threads };
+				Broadphase<2> broadphase{ jobs };
+				for(auto& object : objects)
+					broadphase.Register(object.get(), { 2.f, 2.f, 1.f });
+				broadphase.Update();
+
+				using Clock = std::chrono::steady_clock;
+				Clock::duration total{};
+				constexpr int frames = 20;
+				for(int frame = 0; frame < frames; frame++)
+				{
+					for(auto& object : objects)
+						object->LocalTransform().Position() += Vector<float, 3>{ velocity(random), velocity(random), 0.f };
+
+					auto start = Clock::now();
+					broadphase.Update();
+					total += Clock::now() - start;
+				}
+
+				Logger::WriteMessage(std::format("Broadphase 50k, {} thread(s): {}us/frame, {} overlapping pairs\n",
+					threads,
+					std::chrono::duration_cast<std::chrono::microseconds>(total).count() / frames,
+					broadphase.GetBeginOverlaps().size() + broadphase.GetStayOverlaps().size()).c_str());
+			}
+		}
+	};
+
+	TEST_CLASS(TransformSnapshotTests)
+	{
+		//Loopback channel, packets are delivered in order and can be dropped by the test
+		struct Loopback
+		{
+			std::deque<std::vector<std::byte>> packets;
+			std::size_t bytesSent = 0;
+
+			void Send(std::vector<std::byte> packet)
+			{
+				bytesSent += packet.size();
+				packets.push_back(std::move(packet));
+			}
+		};
+
+		static void AssertNear(const Transform& expected, const Transform& actual)
+		{
+			Assert::AreEqual(expected.position.X(), actual.position.X(), 0.01f);
+			Assert::AreEqual(expected.position.Y(), actual.position.Y(), 0.01f);
+			Assert::AreEqual(expected.position.Z(), actual.position.Z(), 0.01f);
+			Assert::AreEqual(expected.rotation._value, actual.rotation._value, 0.01f);
+			Assert::AreEqual(expected.scale.X(), actual.scale.X(), 0.01f);
+			Assert::AreEqual(expected.scale.Y(), actual.scale.Y(), 0.01f);
+		}
+
+		TEST_METHOD(LoopbackRoundTrip)
+		{
+			std::array<TransformNode, 4> source;
+			std::array<TransformNode, 4> replica;
+			std::vector<TransformNode*> sourceNodes = { &source[0], &source[1], &source[2], &source[3] };
+			std::vector<TransformNode*> replicaNodes = { &replica[0], &replica[1], &replica[2], &replica[3] };
+
+			TransformSnapshotEncoder encoder;
+			TransformSnapshotDecoder decoder;
+			Loopback channel;
+
+			source[1].LocalTransform() = Transform{ { 10.f, -3.5f, 0.f }, Degree<float>{ 90.f }, { 2.f, 2.f, 1.f } };
+			source[3].LocalTransform().Position() = Vector<float, 2>{ 100.f, 4.f };
+
+			channel.Send(encoder.Encode(sourceNodes));
+			Assert::IsTrue(decoder.Decode(channel.packets.front()));
+			channel.packets.pop_front();
+			decoder.Apply(replicaNodes);
+			Assert::AreEqual(std::size_t{ 2 }, decoder.GetLastChanged().size());
+
+			for(std::size_t i = 0; i < source.size(); i++)
+				AssertNear(source[i].LocalTransform().Get(), replica[i].LocalTransform().Get());
+
+			//Only the node that moved since the acknowledged snapshot is sent
+			encoder.Acknowledge(decoder.GetLatestSequence());
+			source[3].LocalTransform().Position() = Vector<float, 2>{ 101.f, 4.f };
+
+			channel.Send(encoder.Encode(sourceNodes));
+			Assert::IsTrue(decoder.Decode(channel.packets.front()));
+			channel.packets.pop_front();
+			decoder.Apply(replicaNodes);
+			Assert::AreEqual(std::size_t{ 1 }, decoder.GetLastChanged().size());
+			Assert::AreEqual(3u, decoder.GetLastChanged()[0]);
+			AssertNear(source[3].LocalTransform().Get(), replica[3].LocalTransform().Get());
+		}
+
+		TEST_METHOD(DroppedPacketsStillDecode)
+		{
+			std::array<TransformNode, 2> source;
+			std::array<TransformNode, 2> replica;
+			std::vector<TransformNode*> sourceNodes = { &source[0], &source[1] };
+			std::vector<TransformNode*> replicaNodes = { &replica[0], &replica[1] };
+
+			TransformSnapshotEncoder encoder;
+			TransformSnapshotDecoder decoder;
+
+			source[0].LocalTransform().Position() = Vector<float, 2>{ 1.f, 1.f };
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			encoder.Acknowledge(decoder.GetLatestSequence());
+
+			//This packet is lost, the next one is still encoded against the acknowledged baseline
+			source[0].LocalTransform().Position() = Vector<float, 2>{ 2.f, 2.f };
+			encoder.Encode(sourceNodes);
+
+			source[1].LocalTransform().Rotation() = Degree<float>{ 45.f };
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			decoder.Apply(replicaNodes);
+
+			AssertNear(source[0].LocalTransform().Get(), replica[0].LocalTransform().Get());
+			AssertNear(source[1].LocalTransform().Get(), replica[1].LocalTransform().Get());
+		}
+
+		TEST_METHOD(WorldSpaceSnapshots)
+		{
+			TransformNode parent;
+			TransformNode child;
+			child.SetParent(&parent);
+
+			TransformNode replicaParent;
+			TransformNode replicaChild;
+
+			std::vector<TransformNode*> sourceNodes = { &parent, &child };
+			std::vector<TransformNode*> replicaNodes = { &replicaParent, &replicaChild };
+
+			TransformSnapshotEncoder encoder{ SnapshotSpace::World };
+			TransformSnapshotDecoder decoder{ SnapshotSpace::World };
+
+			child.LocalTransform().Position() = Vector<float, 2>{ 5.f, 0.f };
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			encoder.Acknowledge(decoder.GetLatestSequence());
+
+			//Moving the parent changes the child's world state without touching its local state
+			parent.LocalTransform().Position() = Vector<float, 2>{ 10.f, 0.f };
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			decoder.Apply(replicaNodes);
+
+			Assert::AreEqual(std::size_t{ 2 }, decoder.GetLastChanged().size());
+			AssertNear(child.WorldTransform().Get(), replicaChild.WorldTransform().Get());
+		}
+
+		TEST_METHOD(RevertToBaselineIsApplied)
+		{
+			TransformNode source;
+			TransformNode replica;
+			std::vector<TransformNode*> sourceNodes = { &source };
+			std::vector<TransformNode*> replicaNodes = { &replica };
+
+			TransformSnapshotEncoder encoder;
+			TransformSnapshotDecoder decoder;
+
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			encoder.Acknowledge(decoder.GetLatestSequence());
+			decoder.Apply(replicaNodes);
+
+			//Both packets are encoded against the first, the second carries nothing for the node
+			source.LocalTransform().Position() = Vector<float, 2>{ 5.f, 0.f };
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			decoder.Apply(replicaNodes);
+			AssertNear(source.LocalTransform().Get(), replica.LocalTransform().Get());
+
+			source.LocalTransform().Position() = Vector<float, 2>{ 0.f, 0.f };
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			decoder.Apply(replicaNodes);
+			AssertNear(source.LocalTransform().Get(), replica.LocalTransform().Get());
+		}
+
+		TEST_METHOD(LatePacketsAreRejected)
+		{
+			TransformNode node;
+			std::vector<TransformNode*> nodes = { &node };
+
+			TransformSnapshotEncoder encoder;
+			TransformSnapshotDecoder decoder;
+
+			auto first = encoder.Encode(nodes);
+			node.LocalTransform().Position() = Vector<float, 2>{ 1.f, 1.f };
+			auto second = encoder.Encode(nodes);
+
+			Assert::IsTrue(decoder.Decode(second));
+			Assert::IsFalse(decoder.Decode(first));
+			Assert::IsFalse(decoder.Decode(second));
+			Assert::AreEqual(1u, decoder.GetLatestSequence());
+		}
+
+		TEST_METHOD(OversizedHeadersAreRejected)
+		{
+			TransformNode node;
+			std::vector<TransformNode*> nodes = { &node };
+
+			TransformSnapshotEncoder encoder;
+			TransformSnapshotDecoder decoder;
+
+			auto packet = encoder.Encode(nodes);
+			const std::uint32_t nodeCount = ~0u;
+			std::memcpy(packet.data() + 2 * sizeof(std::uint32_t), &nodeCount, sizeof(nodeCount));
+			Assert::IsFalse(decoder.Decode(packet));
+		}
+
+		TEST_METHOD(OutOfRangePositionsAreClamped)
+		{
+			TransformNode source;
+			TransformNode replica;
+			std::vector<TransformNode*> sourceNodes = { &source };
+			std::vector<TransformNode*> replicaNodes = { &replica };
+
+			TransformSnapshotEncoder encoder;
+			TransformSnapshotDecoder decoder;
+
+			source.LocalTransform().Position() = Vector<float, 2>{ -1e12f, 1e12f };
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			encoder.Acknowledge(decoder.GetLatestSequence());
+			Assert::IsTrue(decoder.Apply(replicaNodes));
+
+			//The largest possible jump still fits in a delta
+			const float limit = replica.LocalTransform().Get().position.Y();
+			Assert::AreEqual(-limit, replica.LocalTransform().Get().position.X());
+			source.LocalTransform().Position() = Vector<float, 2>{ 1e12f, -1e12f };
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			Assert::IsTrue(decoder.Apply(replicaNodes));
+			Assert::AreEqual(limit, replica.LocalTransform().Get().position.X());
+			Assert::AreEqual(-limit, replica.LocalTransform().Get().position.Y());
+		}
+
+		TEST_METHOD(ApplyRejectsMismatchedNodeLists)
+		{
+			std::array<TransformNode, 2> source;
+			TransformNode replica;
+			std::vector<TransformNode*> sourceNodes = { &source[0], &source[1] };
+			std::vector<TransformNode*> replicaNodes = { &replica };
+
+			TransformSnapshotEncoder encoder;
+			TransformSnapshotDecoder decoder;
+
+			source[1].LocalTransform().Position() = Vector<float, 2>{ 1.f, 1.f };
+			Assert::IsTrue(decoder.Decode(encoder.Encode(sourceNodes)));
+			Assert::IsFalse(decoder.Apply(replicaNodes));
+		}
+
+		TEST_METHOD(MissingBaselineIsRejected)
+		{
+			TransformNode node;
+			std::vector<TransformNode*> nodes = { &node };
+
+			TransformSnapshotEncoder encoder;
+			TransformSnapshotDecoder decoder;
+
+			encoder.Encode(nodes);
+			encoder.Acknowledge(0);
+
+			node.LocalTransform().Position() = Vector<float, 2>{ 1.f, 1.f };
+			Assert::IsFalse(decoder.Decode(encoder.Encode(nodes)));
+		}
+
+		TEST_METHOD(BenchmarkBandwidth)
+		{
+			for(std::size_t count : { 10'000, 100'000 })
+			{
+				std::unique_ptr<TransformNode[]> source{ new TransformNode[count] };
+				std::vector<TransformNode*> nodes(count);
+				std::mt19937 random{ 1 };
+				std::uniform_real_distribution<float> distribution{ -1000.f, 1000.f };
+				for(std::size_t i = 0; i < count; i++)
+				{
+					nodes[i] = &source[i];
+					source[i].LocalTransform().Position() = Vector<float, 2>{ distribution(random), distribution(random) };
+				}
+
+				TransformSnapshotEncoder encoder;
+				TransformSnapshotDecoder decoder;
+				Loopback channel;
+
+				auto sendTick = [&]()
+				{
+					auto start = std::chrono::steady_clock::now();
+					channel.Send(encoder.Encode(nodes));
+					auto end = std::chrono::steady_clock::now();
+
+					Assert::IsTrue(decoder.Decode(channel.packets.back()));
+					encoder.Acknowledge(decoder.GetLatestSequence());
+					return std::chrono::duration<double, std::milli>(end - start).count();
+				};
+
+				double fullTime = sendTick();
+				std::size_t fullBytes = channel.bytesSent;
+
+				//Move a tenth of the nodes by a small amount each tick
+				constexpr int ticks = 10;
+				double deltaTime = 0;
+				for(int tick = 0; tick < ticks; tick++)
+				{
+					for(std::size_t i = tick; i < count; i += 10)
+						source[i].LocalTransform().Position() += Vector<float, 2>{ 0.25f, -0.125f };
+					deltaTime += sendTick();
+				}
+				std::size_t deltaBytes = (channel.bytesSent - fullBytes) / ticks;
+
+				Logger::WriteMessage(std::format("{} nodes: raw {} bytes, full snapshot {} bytes in {:.3f}ms, 10% moving delta {} bytes in {:.3f}ms\n",
+					count, count * sizeof(Transform), fullBytes, fullTime, deltaBytes, deltaTime / ticks).c_str());
+			}
+		}
+	};
+
+	TEST_CLASS(ComponentStoreTests)
+	{
+		struct Position { float x, y; };
+		struct Velocity { float x, y; };
+		struct Health { int value; };
+
+		class MovingObject : public GameObject
+		{
+		public:
+			UniqueEntity entity = Scene::NewEntity(Position{}, Velocity{ 1.f, 2.f });
+
+			using GameObject::GameObject;
+		};
+
+		TEST_METHOD(QueryMatchesArchetypes)
+		{
+			TestScene testScene;
+
+			UniqueEntity a = Scene::NewEntity(Position{ 1.f, 1.f });
+			UniqueEntity b = Scene::NewEntity(Position{ 2.f, 2.f }, Velocity{ 1.f, 0.f });
+			UniqueEntity c = Scene::NewEntity(Velocity{ 0.f, 1.f }, Position{ 3.f, 3.f }, Health{ 10 });
+
+			auto query = Scene::Query<Position, Velocity>();
+			Assert::AreEqual(std::size_t{ 2 }, query.Count());
+
+			query.ForEach([](Position& position, const Velocity& velocity)
+			{
+				position.x += velocity.x;
+				position.y += velocity.y;
+			});
+
+			float sum = 0;
+			Scene::Query<Position>().ForEach([&](const Position& position) { sum += position.x + position.y; });
+			Assert::AreEqual(1.f + 1.f + 3.f + 2.f + 3.f + 4.f, sum);
+
+			//Entities created after the query are picked up on the next iteration
+			UniqueEntity d = Scene::NewEntity(Position{}, Velocity{}, Health{});
+			Assert::AreEqual(std::size_t{ 3 }, query.Count());
+		}
+
+		TEST_METHOD(AddAndRemoveComponents)
+		{
+			TestScene testScene;
+			ComponentStore& store = Scene::GetComponentStore();
+
+			Entity a = store.NewEntity(Position{ 1.f, 2.f });
+			Entity b = store.NewEntity(Position{ 3.f, 4.f });
+
+			store.AddComponent(a, Health{ 5 });
+			Assert::IsTrue(store.Has<Health>(a));
+			Assert::AreEqual(1.f, store.Get<Position>(a)->x);
+			Assert::AreEqual(3.f, store.Get<Position>(b)->x);
+
+			store.RemoveComponent<Position>(a);
+			Assert::IsNull(store.Get<Position>(a));
+			Assert::AreEqual(5, store.Get<Health>(a)->value);
+
+			store.DeleteEntity(b);
+			Assert::IsFalse(store.IsAlive(b));
+			Assert::AreEqual(std::size_t{ 0 }, store.Query<Position>().Count());
+
+			//Recycled indices don't revive old handles
+			Entity c = store.NewEntity(Position{});
+			Assert::AreEqual(b.index, c.index);
+			Assert::IsFalse(store.IsAlive(b));
+			Assert::IsTrue(store.IsAlive(c));
+		}
+
+		TEST_METHOD(RowsStayPackedAcrossChunks)
+		{
+			TestScene testScene;
+			ComponentStore& store = Scene::GetComponentStore();
+
+			std::vector<Entity> entities;
+			for(int i = 0; i < 10'000; i++)
+				entities.push_back(store.NewEntity(Health{ i }));
+
+			for(std::size_t i = 0; i < entities.size(); i += 2)
+				store.DeleteEntity(entities[i]);
+
+			for(std::size_t i = 1; i < entities.size(); i += 2)
+				Assert::AreEqual(static_cast<int>(i), store.Get<Health>(entities[i])->value);
+
+			std::size_t chunks = 0;
+			std::size_t rows = 0;
+			store.Query<Health>().ForEachChunk([&](std::span<const Entity> chunkEntities, std::span<Health> health)
+			{
+				Assert::IsTrue(chunkEntities.size() * (sizeof(Entity) + sizeof(Health)) <= 16 * 1024);
+				chunks++;
+				rows += health.size();
+			});
+			Assert::AreEqual(std::size_t{ 5'000 }, rows);
+			Assert::IsTrue(chunks > 1);
+		}
+
+		TEST_METHOD(GameObjectOwnsEntity)
+		{
+			TestScene testScene;
+
+			{
+				UniqueObject<MovingObject> object = Scene::NewObject<MovingObject>();
+				Assert::AreEqual(2.f, object->entity.Get<Velocity>()->y);
+				Assert::AreEqual(std::size_t{ 1 }, Scene::GetComponentStore().EntityCount());
+			}
+
+			Assert::AreEqual(std::size_t{ 0 }, Scene::GetComponentStore().EntityCount());
+		}
+
+		TEST_METHOD(BenchmarkQueryVersusObjects)
+		{
+			TestScene testScene;
+			constexpr std::size_t count = 100'000;
+
+			std::vector<UniqueObject<MovingObject>> objects;
+			objects.reserve(count);
+			for(std::size_t i = 0; i < count; i++)
+				objects.push_back(Scene::NewObject<MovingObject>());
+
+			auto start = std::chrono::steady_clock::now();
+			for(MovingObject* object : Scene::GetObjectsExactTypeInScene<MovingObject>(testScene.scene.get()))
+			{
+				const Velocity* velocity = object->entity.Get<Velocity>();
+				Position* position = object->entity.Get<Position>();
+				position->x += velocity->x;
+				position->y += velocity->y;
+			}
+			auto objectTime = std::chrono::steady_clock::now() - start;
+
+			auto query = Scene::Query<Position, Velocity>();
+			start = std::chrono::steady_clock::now();
+			query.ForEachChunk([](std::span<const Entity>, std::span<Position> positions, std::span<Velocity> velocities)
+			{
+				for(std::size_t i = 0; i < positions.size(); i++)
+				{
+					positions[i].x += velocities[i].x;
+					positions[i].y += velocities[i].y;
+				}
+			});
+			auto queryTime = std::chrono::steady_clock::now() - start;
+
+			Logger::WriteMessage(std::format("{} movement updates: through objects {:.3f}ms, chunk query {:.3f}ms\n", count,
+				std::chrono::duration<double, std::milli>(objectTime).count(),
+				std::chrono::duration<double, std::milli>(queryTime).count()).c_str());
+		}
+	};
+
+	TEST_CLASS(SubtypeQueryTests)
+	{
+		class Damageable
+		{
+		public:
+			virtual ~Damageable() = default;
+			int hits = 0;
+		};
+
+		struct Plain {};
+
+		template<std::size_t N>
+		class NumberedObject : public GameObject, public std::conditional_t<N % 4 == 0, Damageable, Plain>
+		{
+		public:
+			using GameObject::GameObject;
+		};
+
+		template<std::size_t... Indices>
+		static void Spawn(std::vector<UniqueObject<GameObject>>& objects, std::size_t perType, std::index_sequence<Indices...>)
+		{
+			auto spawnType = [&]<class Ty>(std::type_identity<Ty>)
+			{
+				for(std::size_t i = 0; i < perType; i++)
+					objects.push_back(Scene::NewObject<Ty>());
+			};
+			(spawnType(std::type_identity<NumberedObject<Indices>>{}), ...);
+		}
+
+		static std::size_t CountDamageable(Scene* scene)
+		{
+			std::size_t count = 0;
+			for(Damageable* damageable : Scene::GetObjectsInScene<Damageable>(scene))
+			{
+				damageable->hits++;
+				count++;
+			}
+			return count;
+		}
+
+		TEST_METHOD(NewTypesAreAddedToCachedQueries)
+		{
+			TestScene testScene;
+			std::vector<UniqueObject<GameObject>> objects;
+
+			Spawn(objects, 2, std::make_index_sequence<2>{});
+			Assert::AreEqual(std::size_t{ 2 }, CountDamageable(testScene.scene.get()));
+
+			objects.push_back(Scene::NewObject<NumberedObject<4>>());
+			Assert::AreEqual(std::size_t{ 3 }, CountDamageable(testScene.scene.get()));
+
+			//Hits go through the pointer adjustment, every object must have been visited once per query
+			Assert::AreEqual(2, dynamic_cast<Damageable*>(objects[0].get())->hits);
+			Assert::AreEqual(1, dynamic_cast<Damageable*>(objects.back().get())->hits);
+		}
+
+		TEST_METHOD(EmptyBucketsAreResolvedLater)
+		{
+			TestScene testScene;
+
+			Scene::NewObject<NumberedObject<8>>();
+			Assert::AreEqual(std::size_t{ 0 }, CountDamageable(testScene.scene.get()));
+
+			UniqueObject<NumberedObject<8>> object = Scene::NewObject<NumberedObject<8>>();
+			Assert::AreEqual(std::size_t{ 1 }, CountDamageable(testScene.scene.get()));
+		}
+
+		TEST_METHOD(NestedQueriesKeepOuterIteratorsValid)
+		{
+			TestScene testScene;
+			std::vector<UniqueObject<GameObject>> objects;
+			Spawn(objects, 1, std::make_index_sequence<9>{});
+
+			std::size_t outer = 0;
+			for(Damageable* damageable : Scene::GetObjectsInScene<Damageable>(testScene.scene.get()))
+			{
+				//A new type makes the inner query rebuild the cached list the outer loop is walking
+				if(outer++ == 0)
+					objects.push_back(Scene::NewObject<NumberedObject<12>>());
+				CountDamageable(testScene.scene.get());
+				damageable->hits++;
+			}
+			Assert::IsTrue(outer >= 3);
+		}
+
+		TEST_METHOD(ConcurrentQueriesOfDifferentTypes)
+		{
+			TestScene testScene;
+			std::vector<UniqueObject<GameObject>> objects;
+			Spawn(objects, 4, std::make_index_sequence<16>{});
+
+			std::atomic<std::size_t> gameObjects = 0;
+			std::atomic<std::size_t> damageables = 0;
+			{
+				std::vector<std::jthread> threads;
+				for(int i = 0; i < 8; i++)
+				{
+					threads.emplace_back([&, i]
+					{
+						for(int repeat = 0; repeat < 100; repeat++)
+						{
+							if(i % 2 == 0)
+							{
+								for(Damageable* damageable : Scene::GetObjectsInScene<Damageable>(testScene.scene.get()))
+									damageables++;
+							}
+							else
+							{
+								for(GameObject* object : Scene::GetObjectsInScene<GameObject>(testScene.scene.get()))
+									gameObjects++;
+							}
+						}
+					});
+				}
+			}
+
+			Assert::AreEqual(std::size_t{ 4 * 100 * 4 * 4 }, damageables.load());
+			Assert::AreEqual(std::size_t{ 4 * 100 * 16 * 4 }, gameObjects.load());
+		}
+
+		TEST_METHOD(Benchmark200Types)
+		{
+			TestScene testScene;
+			std::vector<UniqueObject<GameObject>> objects;
+			Spawn(objects, 50, std::make_index_sequence<200>{});
+
+			auto start = std::chrono::steady_clock::now();
+			std::size_t count = CountDamageable(testScene.scene.get());
+			auto coldTime = std::chrono::steady_clock::now() - start;
+			Assert::AreEqual(std::size_t{ 50 * 50 }, count);
+
+			constexpr int frames = 100;
+			start = std::chrono::steady_clock::now();
+			for(int frame = 0; frame < frames; frame++)
+			{
+				for(int query = 0; query < 10; query++)
+					count += CountDamageable(testScene.scene.get());
+			}
+			auto warmTime = std::chrono::steady_clock::now() - start;
+
+			Logger::WriteMessage(std::format("200 types, {} objects: first query {:.3f}ms, 10 cached queries per frame {:.3f}ms ({} visits)\n",
+				objects.size(),
+				std::chrono::duration<double, std::milli>(coldTime).count(),
+				std::chrono::duration<double, std::milli>(warmTime).count() / frames,
+				count).c_str());
+		}
+	};
+
+	TEST_CLASS(ParallelForEachTests)
+	{
+		class Counter : public GameObject
+		{
+		public:
+			int value = 0;
+
+			using GameObject::GameObject;
+		};
+
+		static std::vector<UniqueObject<Counter>> SpawnCounters(std::size_t count)
+		{
+			std::vector<UniqueObject<Counter>> objects;
+			objects.reserve(count);
+			for(std::size_t i = 0; i < count; i++)
+			{
+				objects.push_back(Scene::NewObject<Counter>());
+				objects.back()->value = static_cast<int>(i);
+			}
+			return objects;
+		}
+
+		TEST_METHOD(VisitsEveryObjectOnce)
+		{
+			TestScene testScene;
+			auto objects = SpawnCounters(10'000);
+
+			JobSystem jobs{ 4 };
+			Scene::ParallelForEach<Counter>([](Counter& counter) { counter.value++; }, jobs);
+
+			for(std::size_t i = 0; i < objects.size(); i++)
+				Assert::AreEqual(static_cast<int>(i) + 1, objects[i]->value);
+		}
+
+		TEST_METHOD(CommandsRunInSerialOrder)
+		{
+			TestScene testScene;
+			auto objects = SpawnCounters(10'000);
+			for(auto& object : objects)
+				object.release();
+
+			std::vector<int> order;
+			JobSystem jobs{ 8 };
+			Scene::ParallelForEach<Counter>([&](Counter& counter, SceneCommands& commands)
+			{
+				if(counter.value % 3 != 0)
+					return;
+
+				commands.Defer([&order, value = counter.value] { order.push_back(value); });
+				commands.Delete(&counter);
+			}, jobs);
+
+			Assert::IsTrue(std::is_sorted(order.begin(), order.end()));
+			Assert::AreEqual(std::size_t{ 3334 }, order.size());
+
+			std::size_t remaining = 0;
+			for(Counter* counter : Scene::GetObjectsExactTypeInScene<Counter>(testScene.scene.get()))
+			{
+				Assert::IsTrue(counter->value % 3 != 0);
+				remaining++;
+			}
+			Assert::AreEqual(std::size_t{ 10'000 - 3334 }, remaining);
+		}
+
+		TEST_METHOD(GroupCoversEveryScene)
+		{
+			TestScene testScene;
+			UniqueSceneHandle secondScene = testScene.group->NewScene();
+
+			auto first = SpawnCounters(3'000);
+			activeScene = secondScene.get();
+			auto second = SpawnCounters(5'000);
+			activeScene = testScene.scene.get();
+
+			JobSystem jobs{ 4 };
+			std::atomic<std::size_t> visited = 0;
+			testScene.group->ParallelForEach<Counter>([&](Counter& counter) { visited++; }, jobs);
+			Assert::AreEqual(std::size_t{ 8'000 }, visited.load());
+		}
+
+		TEST_METHOD(OtherThreadsRunInline)
+		{
+			TestScene testScene;
+			auto objects = SpawnCounters(5'000);
+
+			JobSystem jobs{ 4 };
+			std::thread{ [&]
+			{
+				activeScene = testScene.scene.get();
+				Scene::ParallelForEach<Counter>([](Counter& counter) { counter.value++; }, jobs);
+				activeScene = nullptr;
+			} }.join();
+
+			for(std::size_t i = 0; i < objects.size(); i++)
+				Assert::AreEqual(static_cast<int>(i) + 1, objects[i]->value);
+		}
+
+		TEST_METHOD(Benchmark1MUpdates)
+		{
+			TestScene testScene;
+			auto objects = SpawnCounters(1'000'000);
+
+			for(std::size_t threads : { 1, 2, 4, 8, 16 })
+			{
+				JobSystem jobs{ threads };
+				auto start = std::chrono::steady_clock::now();
+				Scene::ParallelForEach<Counter>([](Counter& counter) { counter.value++; }, jobs);
+				auto time = std::chrono::steady_clock::now() - start;
+
+				Logger::WriteMessage(std::format("1M updates on {} threads: {:.3f}ms\n", threads, std::chrono::duration<double, std::milli>(time).count()).c_str());
+			}
+		}
+	};
+
+	TEST_CLASS(JobSystemTests)
+	{
+		TEST_METHOD(DependenciesRunInOrder)
+		{
+			JobSystem jobs{ 4 };
+			std::atomic<int> counter = 0;
+			int first = -1;
+			int second = -1;
+			int third = -1;
+
+			JobHandle a = jobs.Create([&] { first = counter++; });
+			JobHandle b = jobs.Create([&] { second = counter++; });
+			JobHandle c = jobs.Create([&] { third = counter++; });
+			jobs.AddDependency(c, b);
+			jobs.AddDependency(b, a);
+
+			jobs.Submit(c);
+			jobs.Submit(b);
+			jobs.Submit(a);
+			jobs.Wait(c);
+
+			Assert::AreEqual(0, first);
+			Assert::AreEqual(1, second);
+			Assert::AreEqual(2, third);
+			Assert::IsTrue(jobs.IsDone(a));
+		}
+
+		TEST_METHOD(ParentWaitsForChildren)
+		{
+			JobSystem jobs{ 4 };
+			std::atomic<int> counter = 0;
+
+			JobHandle root = jobs.Create([] {});
+			for(int i = 0; i < 1000; i++)
+				jobs.Run([&] { counter++; }, root);
+			jobs.Submit(root);
+			jobs.Wait(root);
+
+			Assert::AreEqual(1000, counter.load());
+		}
+
+		TEST_METHOD(ParallelForCoversRange)
+		{
+			JobSystem jobs{ 4 };
+			std::vector<int> visits(1'000'000);
+
+			jobs.ParallelFor(visits.size(), [&](std::size_t begin, std::size_t end)
+			{
+				for(std::size_t i = begin; i < end; i++)
+					visits[i]++;
+			});
+
+			Assert::IsTrue(std::all_of(visits.begin(), visits.end(), [](int visit) { return visit == 1; }));
+		}
+
+		TEST_METHOD(LargePayloadsSpill)
+		{
+			JobSystem jobs{ 2 };
+			std::array<int, 64> values{};
+			values.fill(2);
+			std::atomic<int> sum = 0;
+
+			JobHandle root = jobs.Create([] {});
+			for(int i = 0; i < 2000; i++)
+				jobs.Run([values, &sum] { for(int value : values) sum += value; }, root);
+			jobs.Submit(root);
+			jobs.Wait(root);
+
+			Assert::AreEqual(2000 * 128, sum.load());
+		}
+
+		TEST_METHOD(BenchmarkSpawnOverhead)
+		{
+			for(std::size_t threads : { 1, 4, 8 })
+			{
+				JobSystem jobs{ threads };
+				constexpr int count = 100'000;
+
+				auto start = std::chrono::steady_clock::now();
+				JobHandle root = jobs.Create([] {});
+				for(int i = 0; i < count; i++)
+					jobs.Run([] {}, root);
+				jobs.Submit(root);
+				jobs.Wait(root);
+				auto time = std::chrono::steady_clock::now() - start;
+
+				Logger::WriteMessage(std::format("{} threads: {:.1f}ns per empty job\n", threads, std::chrono::duration<double, std::nano>(time).count() / count).c_str());
+			}
+		}
+
+		TEST_METHOD(BenchmarkFanOutFanIn)
+		{
+			for(std::size_t threads : { 1, 4, 8 })
+			{
+				JobSystem jobs{ threads };
+				constexpr int iterations = 1000;
+				constexpr int fanOut = 64;
+
+				auto start = std::chrono::steady_clock::now();
+				for(int iteration = 0; iteration < iterations; iteration++)
+				{
+					JobHandle root = jobs.Create([] {});
+					for(int i = 0; i < fanOut; i++)
+						jobs.Run([] {}, root);
+					jobs.Submit(root);
+					jobs.Wait(root);
+				}
+				auto time = std::chrono::steady_clock::now() - start;
+
+				Logger::WriteMessage(std::format("{} threads: {:.2f}us per {} job fan-out/fan-in\n", threads, std::chrono::duration<double, std::micro>(time).count() / iterations, fanOut).c_str());
+			}
+		}
+
+		TEST_METHOD(BenchmarkStealFairness)
+		{
+			JobSystem jobs{ 8 };
+			std::vector<float> values(4'000'000, 1.f);
+
+			auto start = std::chrono::steady_clock::now();
+			jobs.ParallelFor(values.size(), [&](std::size_t begin, std::size_t end)
+			{
+				for(std::size_t i = begin; i < end; i++)
+					values[i] = values[i] * 1.0001f + 0.5f;
+			}, 4096);
+			auto time = std::chrono::steady_clock::now() - start;
+
+			std::string distribution;
+			for(std::size_t i = 0; i < jobs.ThreadCount(); i++)
+				distribution += std::format(" {}", jobs.ExecutedBy(i));
+
+			Logger::WriteMessage(std::format("ParallelFor over {} items in {:.3f}ms, jobs per participant:{}\n", values.size(), std::chrono::duration<double, std::milli>(time).count(), distribution).c_str());
+		}
+	};
+
+	TEST_CLASS(SceneSchedulerTests)
+	{
+		struct Position {};
+		struct Audio {};
+
+		template<class Tag>
+		class SpinningSystem : public ScheduledSystem
+		{
+		public:
+			std::function<void(SystemAccess&)> declare;
+			std::chrono::microseconds duration{ 2000 };
+
+			SpinningSystem(std::function<void(SystemAccess&)> declare) :
+				declare{ std::move(declare) }
+			{
+
+			}
+
+			void DeclareAccess(SystemAccess& access) const override { declare(access); }
+
+			void Update() override
+			{
+				auto end = std::chrono::steady_clock::now() + duration;
+				while(std::chrono::steady_clock::now() < end);
+			}
+		};
+
+		struct Movement {};
+		struct Animation {};
+		struct AudioBookkeeping {};
+		struct Cleanup {};
+
+		static const ScheduleTraceEntry& Find(std::span<const ScheduleTraceEntry> trace, const ScheduledSystem& system)
+		{
+			return *std::find_if(trace.begin(), trace.end(), [&](const ScheduleTraceEntry& entry) { return entry.system == &system; });
+		}
+
+		TEST_METHOD(ConflictingSystemsAreOrdered)
+		{
+			TestScene testScene;
+			JobSystem jobs{ 4 };
+
+			auto& scheduler = Scene::AddSystem<SceneScheduler>(jobs);
+			auto& movement = Scene::AddSystem<SpinningSystem<Movement>>([](SystemAccess& access) { access.Write<Position>(); });
+			auto& animation = Scene::AddSystem<SpinningSystem<Animation>>([](SystemAccess& access) { access.Read<Position>(); });
+			auto& audio = Scene::AddSystem<SpinningSystem<AudioBookkeeping>>([](SystemAccess& access) { access.Write<Audio>(); });
+			auto& cleanup = Scene::AddSystem<SpinningSystem<Cleanup>>([](SystemAccess& access) { access.Phase(UpdatePhase::Late).Read<Audio>(); });
+
+			scheduler.Update();
+			auto trace = scheduler.GetTrace();
+
+			Assert::IsTrue(Find(trace, movement).end <= Find(trace, animation).start);
+			Assert::IsTrue(Find(trace, audio).end <= Find(trace, cleanup).start);
+			Assert::IsTrue(Find(trace, animation).end <= Find(trace, cleanup).start);
+
+			auto predecessors = scheduler.GetPredecessors(&animation);
+			Assert::AreEqual(std::size_t{ 1 }, predecessors.size());
+			Assert::IsTrue(predecessors[0] == &movement);
+			Assert::IsTrue(scheduler.GetPredecessors(&audio).empty());
+		}
+
+		TEST_METHOD(ExclusiveSystemsRunAlone)
+		{
+			TestScene testScene;
+			JobSystem jobs{ 4 };
+
+			auto& scheduler = Scene::AddSystem<SceneScheduler>(jobs);
+			auto& movement = Scene::AddSystem<SpinningSystem<Movement>>([](SystemAccess& access) { access.Write<Position>(); });
+			auto& cleanup = Scene::AddSystem<SpinningSystem<Cleanup>>([](SystemAccess& access) { access.Exclusive(); });
+			auto& audio = Scene::AddSystem<SpinningSystem<AudioBookkeeping>>([](SystemAccess& access) { access.Write<Audio>(); });
+
+			scheduler.Update();
+			auto trace = scheduler.GetTrace();
+
+			Assert::IsTrue(Find(trace, movement).end <= Find(trace, cleanup).start);
+			Assert::IsTrue(Find(trace, cleanup).end <= Find(trace, audio).start);
+		}
+
+		TEST_METHOD(CyclesThrow)
+		{
+			TestScene testScene;
+			JobSystem jobs{ 2 };
+
+			auto& scheduler = Scene::AddSystem<SceneScheduler>(jobs);
+			Scene::AddSystem<SpinningSystem<Movement>>([](SystemAccess& access) { access.After<SpinningSystem<Animation>>(); });
+			Scene::AddSystem<SpinningSystem<Animation>>([](SystemAccess& access) { access.After<SpinningSystem<Movement>>(); });
+
+			Assert::ExpectException<std::exception>([&] { scheduler.Update(); });
+		}
+
+		TEST_METHOD(BenchmarkIndependentSystemsOverlap)
+		{
+			TestScene testScene;
+			JobSystem jobs{ 4 };
+
+			auto& scheduler = Scene::AddSystem<SceneScheduler>(jobs);
+			Scene::AddSystem<SpinningSystem<Movement>>([](SystemAccess& access) { access.Write<Position>(); });
+			Scene::AddSystem<SpinningSystem<Animation>>([](SystemAccess& access) { access.Write<Animation>(); });
+			Scene::AddSystem<SpinningSystem<AudioBookkeeping>>([](SystemAccess& access) { access.Write<Audio>(); });
+
+			scheduler.Update();
+
+			std::string schedule;
+			for(const ScheduleTraceEntry& entry : scheduler.GetTrace())
+			{
+				schedule += std::format("  {} on thread {}: {:.3f}ms - {:.3f}ms\n", entry.name, entry.thread,
+					std::chrono::duration<double, std::milli>(entry.start).count(),
+					std::chrono::duration<double, std::milli>(entry.end).count());
+			}
+
+			Logger::WriteMessage(std::format("3 independent 2ms systems on 4 threads took {:.3f}ms\n{}",
+				std::chrono::duration<double, std::milli>(scheduler.GetFrameTime()).count(), schedule).c_str());
+		}
+	};
+
+	TEST_CLASS(LifetimeFlushTests)
+	{
+		class Bullet : public GameObject
+		{
+		public:
+			int id = 0;
+
+			using GameObject::GameObject;
+		};
+
+		class Enemy : public GameObject
+		{
+		public:
+			using GameObject::GameObject;
+		};
+
+		struct CountingCallbacks : SceneCallbacks
+		{
+			std::size_t created = 0;
+			std::size_t destroyed = 0;
+			std::size_t createdBatches = 0;
+			std::size_t destroyedBatches = 0;
+
+			void OnObjectCreated(Object* object) override { created++; }
+			void OnObjectDestroyed(Object* object) override { destroyed++; }
+
+			void OnObjectsCreated(std::span<Object* const> objects) override
+			{
+				createdBatches++;
+				created += objects.size();
+			}
+
+			void OnObjectsDestroyed(std::span<Object* const> objects) override
+			{
+				destroyedBatches++;
+				destroyed += objects.size();
+			}
+		};
+
+		struct ScopedCallbacks
+		{
+			SceneCallbacks* previous;
+
+			ScopedCallbacks(SceneCallbacks& callbacks) : previous{ std::exchange(Scene::callbacks, &callbacks) } {}
+			~ScopedCallbacks() { Scene::callbacks = previous; }
+		};
+
+		TEST_METHOD(FlushBatchesByType)
+		{
+			TestScene testScene;
+			CountingCallbacks counting;
+			ScopedCallbacks scopedCallbacks{ counting };
+
+			testScene.scene->LockLifetimes();
+			std::vector<Object*> objects;
+			for(int i = 0; i < 100; i++)
+			{
+				objects.push_back(Scene::NewObject<Bullet>().release());
+				objects.push_back(Scene::NewObject<Enemy>().release());
+			}
+			Assert::AreEqual(std::size_t{ 0 }, counting.created);
+			testScene.scene->UnlockLifetimes();
+
+			Assert::AreEqual(std::size_t{ 200 }, counting.created);
+			Assert::AreEqual(std::size_t{ 2 }, counting.createdBatches);
+
+			testScene.scene->LockLifetimes();
+			for(Object* object : objects)
+				Scene::DeleteObject(object);
+			testScene.scene->UnlockLifetimes();
+
+			Assert::AreEqual(std::size_t{ 200 }, counting.destroyed);
+			Assert::AreEqual(std::size_t{ 2 }, counting.destroyedBatches);
+		}
+
+		TEST_METHOD(SwapAndPopKeepsBucketsConsistent)
+		{
+			TestScene testScene;
+			std::vector<Bullet*> bullets;
+			for(int i = 0; i < 1000; i++)
+			{
+				bullets.push_back(Scene::NewObject<Bullet>().release());
+				bullets.back()->id = i;
+			}
+
+			testScene.scene->LockLifetimes();
+			for(int i = 0; i < 1000; i += 3)
+				Scene::DeleteObject(bullets[i]);
+			testScene.scene->UnlockLifetimes();
+
+			//Immediate deletes go through the same path
+			Scene::DeleteObject(bullets[1]);
+
+			std::vector<int> remaining;
+			for(Bullet* bullet : Scene::GetObjectsExactTypeInScene<Bullet>(testScene.scene.get()))
+				remaining.push_back(bullet->id);
+			std::sort(remaining.begin(), remaining.end());
+
+			std::vector<int> expected;
+			for(int i = 2; i < 1000; i++)
+			{
+				if(i % 3 != 0)
+					expected.push_back(i);
+			}
+			Assert::IsTrue(remaining == expected);
+		}
+
+		TEST_METHOD(Benchmark10kBulletsDestroyedInOneFrame)
+		{
+			TestScene testScene;
+			constexpr int count = 10'000;
+
+			std::vector<Object*> bullets;
+			for(int i = 0; i < count; i++)
+				bullets.push_back(Scene::NewObject<Bullet>().release());
+
+			auto start = std::chrono::steady_clock::now();
+			testScene.scene->LockLifetimes();
+			for(Object* bullet : bullets)
+				Scene::DeleteObject(bullet);
+			testScene.scene->UnlockLifetimes();
+			auto time = std::chrono::steady_clock::now() - start;
+
+			Logger::WriteMessage(std::format("Destroying {} objects of one type in one frame: {:.3f}ms\n", count, std::chrono::duration<double, std::milli>(time).count()).c_str());
+		}
+	};
+
+	TEST_CLASS(FastTeardownTests)
+	{
+		class Owner : public GameObject
+		{
+		public:
+			UniqueObject<TestObject> child = Scene::NewObject<TestObject>();
+			int* destroyedCount;
+
+			Owner(Object::Key key, int* destroyedCount) : GameObject{ key }, destroyedCount{ destroyedCount } {}
+			~Owner() { (*destroyedCount)++; }
+		};
+
+		class Debris : public GameObject
+		{
+		public:
+			static constexpr bool skipDestructorOnTeardown = true;
+			int* destroyedCount;
+
+			Debris(Object::Key key, int* destroyedCount) : GameObject{ key }, destroyedCount{ destroyedCount } {}
+			~Debris() { (*destroyedCount)++; }
+		};
+
+		struct CountingCallbacks : SceneCallbacks
+		{
+			std::size_t destroyed = 0;
+			std::size_t destroyedBatches = 0;
+
+			void OnObjectDestroyed(Object* object) override { destroyed++; }
+
+			void OnObjectsDestroyed(std::span<Object* const> objects) override
+			{
+				destroyedBatches++;
+				destroyed += objects.size();
+			}
+		};
+
+		struct ScopedCallbacks
+		{
+			SceneCallbacks* previous;
+
+			ScopedCallbacks(SceneCallbacks& callbacks) : previous{ std::exchange(Scene::callbacks, &callbacks) } {}
+			~ScopedCallbacks() { Scene::callbacks = previous; }
+		};
+
+		TEST_METHOD(ReportsEveryObjectInOneBatch)
+		{
+			CountingCallbacks counting;
+			ScopedCallbacks scopedCallbacks{ counting };
+			int ownersDestroyed = 0;
+			{
+				TestScene testScene;
+				testScene.scene->SetTeardownMode(SceneTeardownMode::Fast);
+				for(int i = 0; i < 100; i++)
+				{
+					Scene::NewObject<Owner>(&ownersDestroyed).release();
+					Scene::NewObject<TestObject>().release();
+				}
+			}
+
+			Assert::AreEqual(100, ownersDestroyed);
+			Assert::AreEqual(std::size_t{ 300 }, counting.destroyed);
+			Assert::AreEqual(std::size_t{ 1 }, counting.destroyedBatches);
+		}
+
+		TEST_METHOD(OwnedObjectsAreDestroyedOnce)
+		{
+			CountingCallbacks counting;
+			ScopedCallbacks scopedCallbacks{ counting };
+			int ownersDestroyed = 0;
+			{
+				TestScene testScene;
+				testScene.scene->SetTeardownMode(SceneTeardownMode::Fast);
+				auto parent = Scene::NewObject<TestObject>();
+				auto owner = Scene::NewObject<Owner>(&ownersDestroyed);
+				owner->SetParent(parent.get());
+				owner->child->SetParent(owner.get());
+				parent.release();
+				owner.release();
+			}
+
+			Assert::AreEqual(1, ownersDestroyed);
+			Assert::AreEqual(std::size_t{ 3 }, counting.destroyed);
+		}
+
+		TEST_METHOD(SafeModeStillDeletesAfterLeavingGroup)
+		{
+			int ownersDestroyed = 0;
+			UniqueSceneGroupHandle group = SceneGroup::New();
+			UniqueSceneHandle first = group->NewScene();
+			UniqueSceneHandle second = group->NewScene();
+
+			activeScene = first.get();
+			Scene::NewObject<Owner>(&ownersDestroyed).release();
+			activeScene = nullptr;
+
+			first = nullptr;
+			Assert::AreEqual(1, ownersDestroyed);
+		}
+
+		TEST_METHOD(MarkedTypesSkipDestructors)
+		{
+			int debrisDestroyed = 0;
+			{
+				TestScene testScene;
+				testScene.scene->SetTeardownMode(SceneTeardownMode::Fast);
+				for(int i = 0; i < 10; i++)
+					Scene::NewObject<Debris>(&debrisDestroyed).release();
+			}
+			Assert::AreEqual(0, debrisDestroyed);
+
+			{
+				TestScene testScene;
+				for(int i = 0; i < 10; i++)
+					Scene::NewObject<Debris>(&debrisDestroyed).release();
+			}
+			Assert::AreEqual(10, debrisDestroyed);
+		}
+
+		TEST_METHOD(Benchmark200kTeardown)
+		{
+			constexpr int count = 200'000;
+			for(SceneTeardownMode mode : { SceneTeardownMode::Safe, SceneTeardownMode::Fast })
+			{
+				TestScene testScene;
+				testScene.scene->SetTeardownMode(mode);
+				for(int i = 0; i < count; i++)
+					Scene::NewObject<TestObject>().release();
+
+				activeScene = nullptr;
+				auto start = std::chrono::steady_clock::now();
+				testScene.scene = nullptr;
+				auto time = std::chrono::steady_clock::now() - start;
+
+				Logger::WriteMessage(std::format("{} teardown of {} objects: {:.3f}ms\n", mode == SceneTeardownMode::Fast ? "Fast" : "Safe", count, std::chrono::duration<double, std::milli>(time).count()).c_str());
+			}
+		}
+	};
+
+	TEST_CLASS(AsyncSceneLoadTests)
+	{
+		class Prop : public GameObject
+		{
+		public:
+			using GameObject::GameObject;
+		};
+
+		class GatedLoader : public SceneLoader
+		{
+		public:
+			void Load(std::atomic<bool>* gate, int count)
+			{
+				while(!gate->load())
+					std::this_thread::yield();
+
+				for(int i = 0; i < count; i++)
+				{
+					Scene::NewObject<Prop>().release();
+					ReportProgress(static_cast<float>(i + 1) / count);
+				}
+			}
+
+			void Unload() override {}
+		};
+
+		//Only finishes when another loader is running at the same time
+		class RendezvousLoader : public SceneLoader
+		{
+		public:
+			void Load(std::atomic<int>* started, bool* metOther)
+			{
+				started->fetch_add(1);
+				const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 5 };
+				while(started->load() < 2 && std::chrono::steady_clock::now() < deadline)
+					std::this_thread::yield();
+				*metOther = started->load() >= 2;
+			}
+
+			void Unload() override {}
+		};
+
+		class ThrowingLoader : public SceneLoader
+		{
+		public:
+			void Load()
+			{
+				Scene::NewObject<Prop>().release();
+				throw std::exception("Missing asset");
+			}
+
+			void Unload() override {}
+		};
+
+		struct RecordingCallbacks : SceneManagerCallbacks
+		{
+			std::vector<float> progress;
+			std::size_t completed = 0;
+
+			void OnSceneLoadProgress(SceneManager& manager, Scene& scene, float value) override { progress.push_back(value); }
+			void OnSceneLoadComplete(SceneManager& manager, Scene& scene) override { completed++; }
+		};
+
+		static LoadedSceneResult WaitForCommit(SceneManager& manager)
+		{
+			std::optional<LoadedSceneResult> result;
+			while(!(result = manager.UpdateLoadingScenes(std::chrono::milliseconds{ 1 })))
+				std::this_thread::yield();
+			return *result;
+		}
+
+		static std::size_t CountProps(Scene* scene)
+		{
+			std::size_t count = 0;
+			for(Prop* prop : Scene::GetObjectsExactTypeInScene<Prop>(scene))
+				count++;
+			return count;
+		}
+
+		TEST_METHOD(CommitsOnceTheLoaderIsDone)
+		{
+			RecordingCallbacks callbacks;
+			std::atomic<bool> gate = false;
+			{
+				SceneManager manager;
+				manager.callbacks = &callbacks;
+
+				manager.LoadSceneAsync<GatedLoader>(&gate, 1000);
+				Assert::IsFalse(manager.UpdateLoadingScenes(std::chrono::milliseconds{ 1 }).has_value());
+				Assert::IsTrue(manager.HasAnySceneLoading());
+				Assert::AreEqual(std::size_t{ 0 }, callbacks.completed);
+
+				gate = true;
+				LoadedSceneResult result = WaitForCommit(manager);
+
+				Assert::IsTrue(result.type == LoadedSceneResult::Type::Scene);
+				Assert::AreEqual(std::size_t{ 1 }, callbacks.completed);
+				Assert::IsFalse(manager.HasAnySceneLoading());
+				Assert::AreEqual(std::size_t{ 1000 }, CountProps(manager.GetScene()));
+				Assert::IsTrue(std::is_sorted(callbacks.progress.begin(), callbacks.progress.end()));
+				Assert::AreEqual(1.f, callbacks.progress.back());
+			}
+			activeScene = nullptr;
+		}
+
+		TEST_METHOD(SubscenesLoadConcurrently)
+		{
+			std::atomic<bool> gate = true;
+			std::atomic<int> started = 0;
+			bool firstMetOther = false;
+			bool secondMetOther = false;
+			{
+				SceneManager manager;
+				manager.LoadSceneAsync<GatedLoader>(&gate, 10);
+				manager.LoadSubsceneAsync<RendezvousLoader>(&started, &firstMetOther);
+				manager.LoadSubsceneAsync<RendezvousLoader>(&started, &secondMetOther);
+
+				Assert::IsTrue(WaitForCommit(manager).type == LoadedSceneResult::Type::Scene);
+
+				std::size_t subscenes = 0;
+				while(subscenes < 2)
+				{
+					LoadedSceneResult result = WaitForCommit(manager);
+					Assert::IsTrue(result.type == LoadedSceneResult::Type::Subscene);
+					subscenes += result.count;
+				}
+
+				Assert::AreEqual(std::size_t{ 2 }, manager.GetSubsceneCount());
+				Assert::IsTrue(firstMetOther);
+				Assert::IsTrue(secondMetOther);
+			}
+			activeScene = nullptr;
+		}
+
+		TEST_METHOD(LoaderErrorsAreRethrownOnCommit)
+		{
+			{
+				SceneManager manager;
+				manager.LoadSceneAsync<ThrowingLoader>();
+				Assert::ExpectException<std::exception>([&] { WaitForCommit(manager); });
+				Assert::IsFalse(manager.HasAnySceneLoading());
+			}
+			activeScene = nullptr;
+		}
+	};
+
+	TEST_CLASS(SceneFileTests)
+	{
+		class Crate : public GameObject
+		{
+		public:
+			struct SceneData
+			{
+				int health;
+				float mass;
+			};
+
+			SceneData data;
+
+			Crate(Object::Key key, const SceneData& data) : GameObject{ key }, data{ data } {}
+
+			SceneData GetSceneData() const { return data; }
+		};
+
+		class Marker : public GameObject
+		{
+		public:
+			struct SceneData
+			{
+				std::uint64_t id;
+			};
+
+			std::uint64_t id;
+
+			Marker(Object::Key key, const SceneData& data) : GameObject{ key }, id{ data.id } {}
+
+			SceneData GetSceneData() const { return { id }; }
+		};
+
+		static SceneFileTypes Types()
+		{
+			SceneFileTypes types;
+			types.Register<Crate>("Crate");
+			types.Register<Marker>("Marker");
+			return types;
+		}
+
+		TEST_METHOD(RoundTripsDataAndHierarchy)
+		{
+			std::vector<std::byte> file;
+			{
+				TestScene testScene;
+				auto root = Scene::NewObject<Marker>(Marker::SceneData{ 7 });
+				root->LocalTransform() = Transform{ { 10.f, 0.f, 0.f } };
+				auto child = Scene::NewObject<Crate>(Crate::SceneData{ 50, 2.5f });
+				child->SetParent(root.get());
+				child->LocalTransform() = Transform{ { 1.f, 2.f, 0.f } };
+				root.release();
+				child.release();
+
+				file = SceneFileWriter::Write(testScene.scene.get(), Types());
+			}
+
+			TestScene testScene;
+			SceneFileView view{ file };
+			Assert::AreEqual(std::size_t{ 2 }, view.ObjectCount());
+
+			std::vector<GameObject*> objects = view.Instantiate(Types());
+			Assert::AreEqual(std::size_t{ 2 }, objects.size());
+
+			Crate* crate = nullptr;
+			for(Crate* object : Scene::GetObjectsExactTypeInScene<Crate>(testScene.scene.get()))
+				crate = object;
+			Marker* marker = nullptr;
+			for(Marker* object : Scene::GetObjectsExactTypeInScene<Marker>(testScene.scene.get()))
+				marker = object;
+
+			Assert::IsNotNull(crate);
+			Assert::IsNotNull(marker);
+			Assert::AreEqual(50, crate->data.health);
+			Assert::AreEqual(2.5f, crate->data.mass);
+			Assert::AreEqual(std::uint64_t{ 7 }, marker->id);
+			Assert::IsTrue(crate->GetParent() == static_cast<TransformNode*>(marker));
+			Assert::AreEqual(11.f, crate->WorldTransform().Get().position.X());
+			Assert::AreEqual(2.f, crate->WorldTransform().Get().position.Y());
+		}
+
+		TEST_METHOD(RejectsMismatchedFiles)
+		{
+			std::vector<std::byte> file;
+			{
+				TestScene testScene;
+				Scene::NewObject<Crate>(Crate::SceneData{ 1, 1.f }).release();
+				file = SceneFileWriter::Write(testScene.scene.get(), Types());
+			}
+
+			std::vector<std::byte> truncated{ file.begin(), file.end() - 1 };
+			Assert::ExpectException<std::exception>([&] { SceneFileView{ truncated }; });
+
+			std::vector<std::byte> wrongVersion = file;
+			wrongVersion[4] = std::byte{ 0xFF };
+			Assert::ExpectException<std::exception>([&] { SceneFileView{ wrongVersion }; });
+
+			TestScene testScene;
+			SceneFileTypes onlyMarkers;
+			onlyMarkers.Register<Marker>("Marker");
+			Assert::ExpectException<std::exception>([&] { SceneFileView{ file }.Instantiate(onlyMarkers); });
+		}
+
+		TEST_METHOD(RejectsCorruptRecords)
+		{
+			std::vector<std::byte> file;
+			{
+				TestScene testScene;
+				Scene::NewObject<Crate>(Crate::SceneData{ 1, 1.f }).release();
+				Scene::NewObject<Crate>(Crate::SceneData{ 2, 1.f }).release();
+				file = SceneFileWriter::Write(testScene.scene.get(), Types());
+			}
+
+			//Records start with their type and parent index
+			std::uint64_t recordsOffset;
+			std::memcpy(&recordsOffset, file.data() + 24, sizeof(recordsOffset));
+			constexpr std::size_t recordSize = 2 * sizeof(std::uint32_t) + 7 * sizeof(float);
+			auto setParent = [&](std::vector<std::byte>& bytes, std::size_t record, std::uint32_t parent)
+			{
+				std::memcpy(bytes.data() + recordsOffset + record * recordSize + sizeof(std::uint32_t), &parent, sizeof(parent));
+			};
+
+			TestScene testScene;
+			std::vector<std::byte> outOfRange = file;
+			setParent(outOfRange, 0, 2);
+			Assert::ExpectException<std::exception>([&] { SceneFileView{ outOfRange }.Instantiate(Types()); });
+
+			//Throws while linking, the objects made so far are still registered once the scene unlocks
+			std::vector<std::byte> cyclic = file;
+			setParent(cyclic, 0, 1);
+			setParent(cyclic, 1, 0);
+			Assert::ExpectException<std::exception>([&] { SceneFileView{ cyclic }.Instantiate(Types()); });
+
+			Scene::NewObject<Crate>(Crate::SceneData{ 3, 1.f }).release();
+			std::size_t count = 0;
+			for(Crate* crate : Scene::GetObjectsExactTypeInScene<Crate>(testScene.scene.get()))
+				count++;
+			Assert::AreEqual(std::size_t{ 3 }, count);
+		}
+
+		TEST_METHOD(Benchmark100kLoad)
+		{
+			constexpr int count = 100'000;
+			const SceneFileTypes types = Types();
+			const std::filesystem::path path = std::filesystem::temp_directory_path() / "InsanityFramework_Benchmark100kLoad.scene";
+
+			auto buildInCode = [&]
+			{
+				for(int i = 0; i < count; i++)
+				{
+					auto crate = Scene::NewObject<Crate>(Crate::SceneData{ i, 1.f });
+					crate->LocalTransform() = Transform{ { static_cast<float>(i % 1000), static_cast<float>(i / 1000), 0.f } };
+					crate.release();
+				}
+			};
+
+			std::chrono::nanoseconds codeTime;
+			{
+				TestScene testScene;
+				auto start = std::chrono::steady_clock::now();
+				buildInCode();
+				codeTime = std::chrono::steady_clock::now() - start;
+
+				SceneFileWriter::WriteFile(path, testScene.scene.get(), types);
+			}
+
+			std::chrono::nanoseconds fileTime;
+			{
+				TestScene testScene;
+				auto start = std::chrono::steady_clock::now();
+				{
+					MappedSceneFile mapped{ path };
+					Assert::AreEqual(std::size_t{ count }, mapped.GetView().Instantiate(types).size());
+				}
+				fileTime = std::chrono::steady_clock::now() - start;
+			}
+			std::filesystem::remove(path);
+
+			Logger::WriteMessage(std::format("Building {} objects in code: {:.3f}ms\n", count, std::chrono::duration<double, std::milli>(codeTime).count()).c_str());
+			Logger::WriteMessage(std::format("Loading {} objects from a mapped scene file: {:.3f}ms\n", count, std::chrono::duration<double, std::milli>(fileTime).count()).c_str());
+		}
+	};
+
+	TEST_CLASS(PrefabTests)
+	{
+		class Hull : public GameObject
+		{
+		public:
+			struct SceneData
+			{
+				int armor;
+			};
+
+			int armor;
+
+			Hull(Object::Key key, const SceneData& data) : GameObject{ key }, armor{ data.armor } {}
+
+			SceneData GetSceneData() const { return { armor }; }
+		};
+
+		class Turret : public GameObject
+		{
+		public:
+			struct SceneData
+			{
+				float range;
+			};
+
+			float range;
+
+			Turret(Object::Key key, const SceneData& data) : GameObject{ key }, range{ data.range } {}
+
+			SceneData GetSceneData() const { return { range }; }
+		};
+
+		struct CountingCallbacks : SceneCallbacks
+		{
+			std::size_t created = 0;
+			std::size_t createdBatches = 0;
+
+			void OnObjectCreated(Object* object) override { created++; }
+
+			void OnObjectsCreated(std::span<Object* const> objects) override
+			{
+				createdBatches++;
+				created += objects.size();
+			}
+		};
+
+		static SceneFileTypes Types()
+		{
+			SceneFileTypes types;
+			types.Register<Hull>("Hull");
+			types.Register<Turret>("Turret");
+			return types;
+		}
+
+		//A hull with two turrets, the second carrying a smaller turret
+		static GameObject* BuildTank()
+		{
+			auto hull = Scene::NewObject<Hull>(Hull::SceneData{ 100 });
+			auto left = Scene::NewObject<Turret>(Turret::SceneData{ 10.f });
+			auto right = Scene::NewObject<Turret>(Turret::SceneData{ 20.f });
+			auto top = Scene::NewObject<Turret>(Turret::SceneData{ 5.f });
+			left->SetParent(hull.get());
+			right->SetParent(hull.get());
+			top->SetParent(right.get());
+			left->LocalTransform() = Transform{ { -1.f, 0.f, 0.f } };
+			right->LocalTransform() = Transform{ { 1.f, 0.f, 0.f } };
+			top->LocalTransform() = Transform{ { 0.f, 1.f, 0.f } };
+			left.release();
+			right.release();
+			top.release();
+			return hull.release();
+		}
+
+		TEST_METHOD(InstancesCopyDataAndHierarchy)
+		{
+			const SceneFileTypes types = Types();
+			TestScene testScene;
+			Prefab prefab = Prefab::Capture(*BuildTank(), types);
+			Assert::AreEqual(std::size_t{ 4 }, prefab.NodeCount());
+
+			std::vector<Transform> placements{ Transform{ { 10.f, 0.f, 0.f } }, Transform{ { 20.f, 0.f, 0.f } } };
+			std::vector<GameObject*> roots = prefab.Instantiate(placements);
+			Assert::AreEqual(std::size_t{ 2 }, roots.size());
+
+			auto findTurret = [&](const TransformNode* node)
+			{
+				for(Turret* turret : Scene::GetObjectsExactTypeInScene<Turret>(testScene.scene.get()))
+				{
+					if(static_cast<const TransformNode*>(turret) == node)
+						return turret;
+				}
+				return static_cast<Turret*>(nullptr);
+			};
+
+			for(std::size_t i = 0; i < roots.size(); i++)
+			{
+				auto hull = static_cast<Hull*>(roots[i]);
+				Assert::AreEqual(100, hull->armor);
+				Assert::AreEqual(std::size_t{ 2 }, hull->GetChildren().size());
+
+				Turret* left = findTurret(hull->GetChildren()[0]);
+				Turret* right = findTurret(hull->GetChildren()[1]);
+				Assert::IsNotNull(left);
+				Assert::IsNotNull(right);
+				Assert::AreEqual(10.f, left->range);
+				Assert::AreEqual(20.f, right->range);
+				Assert::AreEqual(std::size_t{ 1 }, right->GetChildren().size());
+
+				Turret* top = findTurret(right->GetChildren()[0]);
+				Assert::IsNotNull(top);
+				Assert::AreEqual(5.f, top->range);
+				Assert::AreEqual(placements[i].position.X() - 1.f, left->WorldTransform().Get().position.X());
+				Assert::AreEqual(placements[i].position.X() + 1.f, top->WorldTransform().Get().position.X());
+				Assert::AreEqual(1.f, top->WorldTransform().Get().position.Y());
+			}
+		}
+
+		TEST_METHOD(RegistersOneBatchPerType)
+		{
+			const SceneFileTypes types = Types();
+			TestScene testScene;
+			Prefab prefab = Prefab::Capture(*BuildTank(), types);
+
+			CountingCallbacks counting;
+			SceneCallbacks* previous = std::exchange(Scene::callbacks, &counting);
+			prefab.Instantiate(50);
+			Scene::callbacks = previous;
+
+			Assert::AreEqual(std::size_t{ 200 }, counting.created);
+			Assert::AreEqual(std::size_t{ 2 }, counting.createdBatches);
+		}
+
+		TEST_METHOD(Benchmark10kInstances)
+		{
+			constexpr int count = 10'000;
+			const SceneFileTypes types = Types();
+
+			std::chrono::nanoseconds manualTime;
+			{
+				TestScene testScene;
+				auto start = std::chrono::steady_clock::now();
+				for(int i = 0; i < count; i++)
+					BuildTank();
+				manualTime = std::chrono::steady_clock::now() - start;
+			}
+
+			std::chrono::nanoseconds prefabTime;
+			{
+				TestScene testScene;
+				Prefab prefab = Prefab::Capture(*BuildTank(), types);
+				auto start = std::chrono::steady_clock::now();
+				prefab.Instantiate(count);
+				prefabTime = std::chrono::steady_clock::now() - start;
+			}
+
+			Logger::WriteMessage(std::format("Spawning {} tanks one object at a time: {:.3f}ms\n", count, std::chrono::duration<double, std::milli>(manualTime).count()).c_str());
+			Logger::WriteMessage(std::format("Spawning {} tanks from a prefab: {:.3f}ms\n", count, std::chrono::duration<double, std::milli>(prefabTime).count()).c_str());
+		}
+	};
+
+	TEST_CLASS(SceneCommandsTests)
+	{
+		class Spawned : public GameObject
+		{
+		public:
+			int id;
+
+			Spawned(Object::Key key, int id) : GameObject{ key }, id{ id } {}
+		};
+
+		class DeferredSystem : public SceneSystem
+		{
+		};
+
+		static std::vector<Spawned*> GetSpawned(Scene* scene)
+		{
+			std::vector<Spawned*> output;
+			for(Spawned* spawned : Scene::GetObjectsExactTypeInScene<Spawned>(scene))
+				output.push_back(spawned);
+			return output;
+		}
+
+		TEST_METHOD(WorkerCreationsPlayBackInKeyOrder)
+		{
+			TestScene testScene;
+			Scene* scene = testScene.scene.get();
+			JobSystem jobs{ 4 };
+
+			scene->LockLifetimes();
+			jobs.ParallelFor(1000, [&](std::size_t begin, std::size_t end)
+			{
+				SceneCommands& commands = scene->GetThreadCommands();
+				for(std::size_t index = begin; index < end; index++)
+				{
+					commands.SetSortKey(index);
+					commands.New<Spawned>(static_cast<int>(index));
+				}
+			}, 1);
+			Assert::IsTrue(GetSpawned(scene).empty());
+			scene->UnlockLifetimes();
+
+			std::vector<Spawned*> spawned = GetSpawned(scene);
+			Assert::AreEqual(std::size_t{ 1000 }, spawned.size());
+			for(std::size_t i = 0; i < spawned.size(); i++)
+				Assert::AreEqual(static_cast<int>(i), spawned[i]->id);
+		}
+
+		TEST_METHOD(SortKeyScopeRestoresThePreviousKey)
+		{
+			TestScene testScene;
+			SceneCommands& commands = testScene.scene->GetThreadCommands();
+			commands.SetSortKey(7);
+			{
+				SceneCommands::SortKeyScope scope{ commands, 3 };
+				Assert::AreEqual(std::uint64_t{ 3 }, commands.GetSortKey());
+			}
+			Assert::AreEqual(std::uint64_t{ 7 }, commands.GetSortKey());
+		}
+
+		TEST_METHOD(PendingObjectsCanBeLinked)
+		{
+			TestScene testScene;
+			Scene* scene = testScene.scene.get();
+
+			scene->LockLifetimes();
+			std::thread worker{ [&]
+			{
+				SceneCommands& commands = scene->GetThreadCommands();
+				PendingObject<Spawned> parent = commands.New<Spawned>(1);
+				PendingObject<Spawned> child = commands.New<Spawned>(2);
+				commands.SetParent(child, parent);
+				commands.AddSystem<DeferredSystem>();
+			} };
+			worker.join();
+			scene->UnlockLifetimes();
+
+			std::vector<Spawned*> spawned = GetSpawned(scene);
+			Assert::AreEqual(std::size_t{ 2 }, spawned.size());
+			Spawned* parent = spawned[0]->id == 1 ? spawned[0] : spawned[1];
+			Spawned* child = spawned[0]->id == 2 ? spawned[0] : spawned[1];
+			Assert::IsTrue(child->GetParent() == static_cast<TransformNode*>(parent));
+			Assert::IsNotNull(Scene::TryGetSystem<DeferredSystem>());
+		}
+
+		TEST_METHOD(WorkerDeletesWaitForTheFlush)
+		{
+			TestScene testScene;
+			Scene* scene = testScene.scene.get();
+			std::vector<Spawned*> objects;
+			for(int i = 0; i < 10; i++)
+				objects.push_back(Scene::NewObject<Spawned>(i).release());
+
+			scene->LockLifetimes();
+			std::thread worker{ [&]
+			{
+				SceneCommands& commands = scene->GetThreadCommands();
+				for(std::size_t i = 0; i < objects.size(); i += 2)
+					commands.Delete(objects[i]);
+			} };
+			worker.join();
+			Assert::AreEqual(std::size_t{ 10 }, GetSpawned(scene).size());
+			scene->UnlockLifetimes();
+
+			std::vector<Spawned*> spawned = GetSpawned(scene);
+			Assert::AreEqual(std::size_t{ 5 }, spawned.size());
+			for(Spawned* object : spawned)
+				Assert::AreEqual(1, object->id % 2);
+		}
+	};
+
+	TEST_CLASS(ConcurrentSceneGroupTests)
+	{
+		class Unit : public GameObject
+		{
+		public:
+			int health = 10;
+
+			using GameObject::GameObject;
+		};
+
+		//One match: spawns units, damages them in parallel, deletes the dead and spawns replacements every frame
+		static std::size_t RunMatch(int frames)
+		{
+			UniqueSceneGroupHandle group = SceneGroup::New();
+			UniqueSceneHandle scene = group->NewScene();
+			activeScene = scene.get();
+
+			for(int i = 0; i < 1000; i++)
+				Scene::NewObject<Unit>().release();
+
+			JobSystem jobs{ 2 };
+			for(int frame = 0; frame < frames; frame++)
+			{
+				Scene::ParallelForEach<Unit>([](Unit& unit, SceneCommands& commands)
+				{
+					if(--unit.health <= 0)
+						commands.Delete(&unit);
+				}, jobs);
+
+				std::size_t alive = 0;
+				for(Unit* unit : Scene::GetObjects<Unit>())
+					alive++;
+				for(std::size_t i = alive; i < 1000; i++)
+					Scene::NewObject<Unit>().release();
+			}
+
+			std::size_t count = 0;
+			for(Unit* unit : Scene::GetObjectsExactType<Unit>())
+				count++;
+
+			activeScene = nullptr;
+			return count;
+		}
+
+		TEST_METHOD(GroupsTickOnSeparateThreads)
+		{
+			constexpr std::size_t matchCount = 4;
+			std::array<std::size_t, matchCount> counts{};
+			{
+				std::vector<std::jthread> matches;
+				for(std::size_t i = 0; i < matchCount; i++)
+					matches.emplace_back([&counts, i] { counts[i] = RunMatch(50); });
+			}
+
+			for(std::size_t count : counts)
+				Assert::AreEqual(std::size_t{ 1000 }, count);
+		}
+
+		TEST_METHOD(GroupRegistrationIsThreadSafe)
+		{
+			std::vector<std::jthread> threads;
+			for(int i = 0; i < 8; i++)
+			{
+				threads.emplace_back([]
+				{
+					for(int j = 0; j < 200; j++)
+					{
+						UniqueSceneGroupHandle group = SceneGroup::New();
+						UniqueSceneHandle first = group->NewScene();
+						UniqueSceneHandle second = group->NewScene();
+						Assert::IsTrue(SceneGroup::GetGroup(first.get()) == group.get());
+						second = nullptr;
+						Assert::IsTrue(group->Contains(first.get()));
+					}
+				});
+			}
+		}
+
+		TEST_METHOD(OwnerIsFoundOutsideTheActiveGroup)
+		{
+			UniqueSceneGroupHandle firstGroup = SceneGroup::New();
+			UniqueSceneGroupHandle secondGroup = SceneGroup::New();
+			UniqueSceneHandle first = firstGroup->NewScene();
+			UniqueSceneHandle second = secondGroup->NewScene();
+
+			activeScene = second.get();
+			Unit* unit = Scene::NewObject<Unit>().release();
+			activeScene = first.get();
+			Unit* firstUnit = Scene::NewObject<Unit>().release();
+			Assert::IsTrue(Scene::GetOwner(unit) == second.get());
+			Assert::IsTrue(Scene::GetOwner(firstUnit) == first.get());
+			Assert::IsTrue(SceneGroup::GetScene(unit).first == second.get());
+			Assert::IsTrue(SceneGroup::GetScene(unit).second == secondGroup.get());
+
+			Scene::DeleteObject(unit);
+			std::size_t count = 0;
+			for(Unit* remaining : Scene::GetObjectsExactTypeInScene<Unit>(second.get()))
+				count++;
+			Assert::AreEqual(std::size_t{ 0 }, count);
+			activeScene = nullptr;
+		}
+	};
+
+	TEST_CLASS(SceneSnapshotTests)
+	{
+		class Unit : public GameObject
+		{
+		public:
+			int health;
+
+			Unit(Object::Key key, int health) : GameObject{ key }, health{ health } {}
+		};
+
+		static std::size_t CountUnits()
+		{
+			std::size_t count = 0;
+			for(Unit* unit : Scene::GetObjects<Unit>())
+				count++;
+			return count;
+		}
+
+		TEST_METHOD(RestoreRollsBackFieldsObjectsAndHierarchy)
+		{
+			TestScene testScene;
+			std::vector<Unit*> units;
+			for(int i = 0; i < 10; i++)
+				units.push_back(Scene::NewObject<Unit>(i).release());
+			units[1]->SetParent(units[0]);
+
+			SceneSnapshots snapshots{ *testScene.scene, 4 };
+			const std::uint64_t sequence = snapshots.Capture();
+
+			for(Unit* unit : units)
+				unit->health = -1;
+			Scene::DeleteObject(units[2]);
+			Scene::NewObject<Unit>(100).release();
+			units[1]->SetParent(units[3]);
+
+			Assert::IsTrue(snapshots.Restore(sequence));
+
+			Assert::AreEqual(std::size_t{ 10 }, CountUnits());
+			for(int i = 0; i < 10; i++)
+				Assert::AreEqual(i, units[i]->health);
+
+			Assert::IsTrue(units[1]->GetParent() == units[0]);
+			Assert::AreEqual(std::size_t{ 1 }, units[0]->GetChildren().size());
+			Assert::IsTrue(units[0]->GetChildren()[0] == static_cast<TransformNode*>(units[1]));
+			Assert::IsTrue(units[3]->GetChildren().empty());
+
+			//The deleted unit is back at its old address and can be deleted normally
+			Scene::DeleteObject(units[2]);
+			Assert::AreEqual(std::size_t{ 9 }, CountUnits());
+		}
+
+		TEST_METHOD(ObjectsCanBeMadeAfterRestore)
+		{
+			TestScene testScene;
+			for(int i = 0; i < 100; i++)
+				Scene::NewObject<Unit>(i).release();
+
+			SceneSnapshots snapshots{ *testScene.scene, 4 };
+			const std::uint64_t sequence = snapshots.Capture();
+			for(int i = 0; i < 100; i++)
+				Scene::NewObject<Unit>(i).release();
+
+			Assert::IsTrue(snapshots.Restore(sequence));
+			for(int i = 0; i < 50; i++)
+				Scene::NewObject<Unit>(i).release();
+			Assert::AreEqual(std::size_t{ 150 }, CountUnits());
+
+			const std::uint64_t later = snapshots.Capture();
+			for(Unit* unit : Scene::GetObjects<Unit>())
+				Scene::DeleteObject(unit);
+			Assert::IsTrue(snapshots.Restore(later));
+			Assert::AreEqual(std::size_t{ 150 }, CountUnits());
+		}
+
+		TEST_METHOD(RingDropsOldestAndRestoreDropsNewer)
+		{
+			TestScene testScene;
+			Scene::NewObject<Unit>(0).release();
+
+			SceneSnapshots snapshots{ *testScene.scene, 2 };
+			const std::uint64_t first = snapshots.Capture();
+			const std::uint64_t second = snapshots.Capture();
+			const std::uint64_t third = snapshots.Capture();
+			Assert::AreEqual(std::size_t{ 2 }, snapshots.Size());
+
+			Assert::IsFalse(snapshots.Restore(first));
+			Assert::IsTrue(snapshots.Restore(second));
+			Assert::AreEqual(std::size_t{ 1 }, snapshots.Size());
+			Assert::IsFalse(snapshots.Restore(third));
+		}
+
+		TEST_METHOD(CaptureCopiesOnlyWrittenBlocks)
+		{
+			TestScene testScene;
+			std::vector<Unit*> units;
+			for(int i = 0; i < 50'000; i++)
+				units.push_back(Scene::NewObject<Unit>(i).release());
+
+			SceneSnapshots snapshots{ *testScene.scene, 8 };
+			snapshots.Capture();
+
+			//Spread out so every write lands in a different block
+			for(std::size_t i = 0; i < 10; i++)
+				units[i * 4000]->health = 0;
+
+			auto start = std::chrono::steady_clock::now();
+			const std::uint64_t sequence = snapshots.Capture();
+			auto captureTime = std::chrono::steady_clock::now() - start;
+			Assert::IsTrue(snapshots.LastCopiedBytes() <= 10 * SceneSnapshots::blockSize);
+
+			for(std::size_t i = 0; i < 10; i++)
+				units[i * 4000 + 1]->health = 0;
+
+			start = std::chrono::steady_clock::now();
+			Assert::IsTrue(snapshots.Restore(sequence));
+			auto restoreTime = std::chrono::steady_clock::now() - start;
+			Assert::IsTrue(snapshots.LastCopiedBytes() <= 10 * SceneSnapshots::blockSize);
+			Assert::AreEqual(1, units[1]->health);
+
+			Logger::WriteMessage(std::format("50000 objects, 10 changed: capture {}, restore {}\n",
+				std::chrono::duration_cast<std::chrono::microseconds>(captureTime),
+				std::chrono::duration_cast<std::chrono::microseconds>(restoreTime)).c_str());
+		}
+
+		TEST_METHOD(ObjectsMadeAfterAttachingAreWatched)
+		{
+			TestScene testScene;
+			SceneSnapshots snapshots{ *testScene.scene, 4 };
+
+			std::vector<Unit*> units;
+			for(int i = 0; i < 10'000; i++)
+				units.push_back(Scene::NewObject<Unit>(i).release());
+			snapshots.Capture();
+
+			units[5000]->health = 0;
+			const std::uint64_t sequence = snapshots.Capture();
+			Assert::IsTrue(snapshots.LastCopiedBytes() <= SceneSnapshots::blockSize);
+
+			units[5000]->health = -1;
+			Assert::IsTrue(snapshots.Restore(sequence));
+			Assert::AreEqual(0, units[5000]->health);
+			Assert::AreEqual(4999, units[4999]->health);
+		}
+
+		TEST_METHOD(ScenesWithPoolsCantBeSnapshotted)
+		{
+			TestScene testScene;
+			Scene::NewObject<Unit>(0).release();
+
+			{
+				SceneSnapshots snapshots{ *testScene.scene, 4 };
+				const std::uint64_t sequence = snapshots.Capture();
+
+				Scene::AddSystem<ObjectPool<Unit>>(4);
+				Assert::ExpectException<std::exception>([&] { snapshots.Capture(); });
+				Assert::ExpectException<std::exception>([&] { snapshots.Restore(sequence); });
+			}
+
+			Assert::ExpectException<std::exception>([&] { SceneSnapshots snapshots{ *testScene.scene, 4 }; });
+		}
+	};
+
+	TEST_CLASS(WeakObjectTests)
+	{
+		class Unit : public GameObject
+		{
+		public:
+			int health = 10;
+
+			using GameObject::GameObject;
+		};
+
+		TEST_METHOD(IsEightBytes)
+		{
+			static_assert(sizeof(WeakObject<Unit>) == 8);
+			Assert::IsTrue(WeakObject<Unit>{}.IsNull());
+		}
+
+		TEST_METHOD(ReturnsNullOnceDestroyed)
+		{
+			TestScene testScene;
+			Unit* unit = Scene::NewObject<Unit>().release();
+			WeakObject<Unit> handle = unit;
+			WeakObject<GameObject> baseHandle = handle;
+
+			Assert::IsTrue(handle.Get() == unit);
+			Assert::IsTrue(baseHandle.Get() == unit);
+
+			Scene::DeleteObject(unit);
+			Assert::IsNull(handle.Get());
+			Assert::IsNull(baseHandle.Get());
+			Assert::IsFalse(handle.IsNull());
+		}
+
+		TEST_METHOD(ResolvesInParallelForEach)
+		{
+			TestScene testScene;
+			std::vector<UniqueObject<Unit>> units;
+			for(int i = 0; i < 256; i++)
+				units.push_back(Scene::NewObject<Unit>());
+
+			JobSystem jobs{ 4 };
+			std::atomic<int> resolved = 0;
+			Scene::ParallelForEach<Unit>([&](Unit& unit)
+			{
+				if(WeakObject<Unit>{ &unit }.Get() == &unit)
+					resolved++;
+			}, jobs);
+			Assert::AreEqual(256, resolved.load());
+
+			//Threads without an active scene get nullptr instead of crashing
+			WeakObject<Unit> handle = units.front().get();
+			std::thread{ [&] { Assert::IsNull(handle.Get()); } }.join();
+		}
+
+		TEST_METHOD(ReusedSlotsDontResolveOldHandles)
+		{
+			TestScene testScene;
+			Unit* first = Scene::NewObject<Unit>().release();
+			WeakObject<Unit> firstHandle = first;
+			Scene::DeleteObject(first);
+
+			Unit* second = Scene::NewObject<Unit>().release();
+			WeakObject<Unit> secondHandle = second;
+
+			Assert::IsNull(firstHandle.Get());
+			Assert::IsTrue(secondHandle.Get() == second);
+			Assert::IsFalse(firstHandle == secondHandle);
+		}
+
+		TEST_METHOD(QueuedDeletesStayAliveUntilFlushed)
+		{
+			TestScene testScene;
+			Unit* unit = Scene::NewObject<Unit>().release();
+			WeakObject<Unit> handle = unit;
+
+			testScene.scene->LockLifetimes();
+			Scene::DeleteObject(unit);
+			Assert::IsTrue(handle.Get() == unit);
+			testScene.scene->UnlockLifetimes();
+
+			Assert::IsNull(handle.Get());
+		}
+
+		TEST_METHOD(HandlesDontResolveInOtherScenes)
+		{
+			TestScene testScene;
+			WeakObject<Unit> handle = Scene::NewObject<Unit>().release();
+
+			UniqueSceneHandle other = testScene.group->NewScene();
+			activeScene = other.get();
+			Scene::NewObject<Unit>().release();
+			Assert::IsNull(handle.Get());
+
+			activeScene = testScene.scene.get();
+			Assert::IsNotNull(handle.Get());
+		}
+
+		TEST_METHOD(BenchmarkAgainstContains)
+		{
+			TestScene testScene;
+			constexpr std::size_t objectCount = 100'000;
+			constexpr std::size_t lookups = 1'000'000;
+
+			std::vector<Unit*> units;
+			std::vector<WeakObject<Unit>> handles;
+			for(std::size_t i = 0; i < objectCount; i++)
+			{
+				units.push_back(Scene::NewObject<Unit>().release());
+				handles.push_back(units.back());
+			}
+
+			std::mt19937 random{ 7 };
+			std::uniform_int_distribution<std::size_t> distribution{ 0, objectCount - 1 };
+			std::vector<std::size_t> order(lookups);
+			for(std::size_t& index : order)
+				index = distribution(random);
+
+			Scene* scene = testScene.scene.get();
+			int pointerHealth = 0;
+			auto start = std::chrono::steady_clock::now();
+			for(std::size_t index : order)
+			{
+				if(scene->Contains(units[index]))
+					pointerHealth += units[index]->health;
+			}
+			auto pointerTime = std::chrono::steady_clock::now() - start;
+
+			int handleHealth = 0;
+			start = std::chrono::steady_clock::now();
+			for(std::size_t index : order)
+			{
+				if(Unit* unit = handles[index].Get(scene))
+					handleHealth += unit->health;
+			}
+			auto handleTime = std::chrono::steady_clock::now() - start;
+
+			Assert::AreEqual(pointerHealth, handleHealth);
+			Logger::WriteMessage(std::format("{} lookups: pointer + Contains {}, WeakObject {}\n", lookups,
+				std::chrono::duration_cast<std::chrono::microseconds>(pointerTime),
+				std::chrono::duration_cast<std::chrono::microseconds>(handleTime)).c_str());
+		}
+	};
+
+	TEST_CLASS(TypeIDTests)
+	{
+		struct First {};
+		struct Second {};
+
+		TEST_METHOD(IdsAreStableAndIgnoreQualifiers)
+		{
+			const TypeID first = GetTypeID<First>();
+			Assert::AreEqual(first, GetTypeID<First>());
+			Assert::AreEqual(first, GetTypeID<const First>());
+			Assert::AreEqual(first, GetTypeID(typeid(First)));
+			Assert::AreNotEqual(first, GetTypeID<Second>());
+		}
+
+		TEST_METHOD(MapKeepsValueAddresses)
+		{
+			TypeMap<std::vector<int>> map;
+			auto [values, inserted] = map.TryEmplace(GetTypeID<First>(), 3, 7);
+			Assert::IsTrue(inserted);
+			Assert::IsFalse(map.TryEmplace(GetTypeID<First>()).second);
+
+			map[GetTypeID<Second>()].push_back(1);
+			Assert::IsTrue(map.Find(GetTypeID<First>()) == values);
+			Assert::AreEqual(std::size_t{ 3 }, map.At(GetTypeID<First>()).size());
+			Assert::AreEqual(std::size_t{ 2 }, map.Size());
+
+			Assert::IsTrue(map.Erase(GetTypeID<First>()));
+			Assert::IsFalse(map.Contains(GetTypeID<First>()));
+			Assert::IsTrue(map.Contains(GetTypeID<Second>()));
+
+			std::size_t visited = 0;
+			for(auto& [type, entry] : map)
+			{
+				Assert::AreEqual(GetTypeID<Second>(), type);
+				visited++;
+			}
+			Assert::AreEqual(std::size_t{ 1 }, visited);
+		}
+
+		TEST_METHOD(SystemLookupBenchmark)
+		{
+			struct Physics : SceneSystem { int value = 1; };
+			struct Audio : SceneSystem { int value = 2; };
+
+			TestScene testScene;
+			Scene::AddSystem<Physics>();
+			Scene::AddSystem<Audio>();
+
+			std::unordered_map<std::type_index, SceneSystem*> hashed;
+			hashed.insert({ typeid(Physics), &Scene::GetSystem<Physics>() });
+			hashed.insert({ typeid(Audio), &Scene::GetSystem<Audio>() });
+
+			constexpr int lookups = 1'000'000;
+			int hashedSum = 0;
+			auto start = std::chrono::steady_clock::now();
+			for(int i = 0; i < lookups; i++)
+				hashedSum += static_cast<Physics*>(hashed.at(typeid(Physics)))->value;
+			auto hashedTime = std::chrono::steady_clock::now() - start;
+
+			int flatSum = 0;
+			start = std::chrono::steady_clock::now();
+			for(int i = 0; i < lookups; i++)
+				flatSum += Scene::GetSystem<Physics>().value;
+			auto flatTime = std::chrono::steady_clock::now() - start;
+
+			Assert::AreEqual(hashedSum, flatSum);
+			Logger::WriteMessage(std::format("{} system lookups: type_index hash map {}, TypeMap {}\n", lookups,
+				std::chrono::duration_cast<std::chrono::microseconds>(hashedTime),
+				std::chrono::duration_cast<std::chrono::microseconds>(flatTime)).c_str());
+		}
+	};
+
+	TEST_CLASS(BackgroundReclaimTests)
+	{
+		struct Destructions
+		{
+			std::atomic<int> count = 0;
+			std::atomic<bool> offThread = true;
+			std::thread::id owner = std::this_thread::get_id();
+		};
+
+		class Chunk : public GameObject
+		{
+		public:
+			static constexpr bool reclaimInBackground = true;
+
+			std::vector<int> data;
+			Destructions* destructions;
+
+			Chunk(Object::Key key, Destructions* destructions, std::size_t size = 16) : GameObject{ key }, data(size, 1), destructions{ destructions } {}
+
+			~Chunk()
+			{
+				if(std::this_thread::get_id() == destructions->owner)
+					destructions->offThread = false;
+				destructions->count++;
+			}
+		};
+
+		class SyncChunk : public GameObject
+		{
+		public:
+			std::vector<int> data;
+
+			SyncChunk(Object::Key key, std::size_t size) : GameObject{ key }, data(size, 1) {}
+		};
+
+		TEST_METHOD(DestructorsRunOffTheOwningThread)
+		{
+			Destructions destructions;
+			TestScene testScene;
+			for(int i = 0; i < 100; i++)
+				Scene::NewObject<Chunk>(&destructions).release();
+
+			std::vector<Chunk*> chunks;
+			for(Chunk* chunk : Scene::GetObjects<Chunk>())
+				chunks.push_back(chunk);
+			WeakObject<Chunk> handle = chunks.front();
+
+			testScene.scene->LockLifetimes();
+			for(Chunk* chunk : chunks)
+				Scene::DeleteObject(chunk);
+			testScene.scene->UnlockLifetimes();
+
+			//Gone from the scene right away
+			Assert::IsNull(handle.Get());
+			std::size_t remaining = 0;
+			for(Chunk* chunk : Scene::GetObjects<Chunk>())
+				remaining++;
+			Assert::AreEqual(std::size_t{ 0 }, remaining);
+
+			testScene.scene->WaitForReclaims();
+			Assert::AreEqual(100, destructions.count.load());
+			Assert::IsTrue(destructions.offThread.load());
+		}
+
+		TEST_METHOD(PerCallDeleteLeavesHierarchyImmediately)
+		{
+			TestScene testScene;
+			auto parent = Scene::NewObject<TestObject>().release();
+			auto child = Scene::NewObject<TestObject>().release();
+			child->SetParent(parent);
+
+			Scene::DeleteObjectInBackground(parent);
+			Assert::IsNull(child->GetParent());
+			testScene.scene->WaitForReclaims();
+		}
+
+		TEST_METHOD(BackPressureKeepsEverythingReclaimed)
+		{
+			Destructions destructions;
+			TestScene testScene;
+			//Several times the reclaimer's queue limit
+			constexpr int count = 50'000;
+
+			testScene.scene->LockLifetimes();
+			for(int i = 0; i < count; i++)
+				Scene::DeleteObject(Scene::NewObject<Chunk>(&destructions).release());
+			testScene.scene->UnlockLifetimes();
+
+			testScene.scene->WaitForReclaims();
+			Assert::AreEqual(count, destructions.count.load());
+
+			//Freed memory is reused
+			for(int i = 0; i < count; i++)
+				Scene::NewObject<Chunk>(&destructions).release();
+		}
+
+		//Time of the flush deleting count objects made from args
+		template<class Ty, class... Args>
+		static std::chrono::nanoseconds TimeFlush(Scene& scene, int count, Args... args)
+		{
+			scene.LockLifetimes();
+			for(int i = 0; i < count; i++)
+				Scene::DeleteObject(Scene::NewObject<Ty>(args...).release());
+
+			auto start = std::chrono::steady_clock::now();
+			scene.UnlockLifetimes();
+			return std::chrono::steady_clock::now() - start;
+		}
+
+		TEST_METHOD(FlushBenchmark)
+		{
+			Destructions destructions;
+			TestScene testScene;
+			constexpr int count = 1000;
+			constexpr std::size_t size = 16 * 1024;
+
+			auto syncTime = TimeFlush<SyncChunk>(*testScene.scene, count, size);
+			auto backgroundTime = TimeFlush<Chunk>(*testScene.scene, count, &destructions, size);
+			testScene.scene->WaitForReclaims();
+			Assert::AreEqual(count, destructions.count.load());
+
+			Logger::WriteMessage(std::format("Flushing {} deletes of 64 KiB objects: inline {}, background {}\n", count,
+				std::chrono::duration_cast<std::chrono::microseconds>(syncTime),
+				std::chrono::duration_cast<std::chrono::microseconds>(backgroundTime)).c_str());
+		}
+	};
+
+	TEST_CLASS(TickSchedulerTests)
+	{
+		static inline TickScheduler::Clock::time_point now{};
+		static TickScheduler::Clock::time_point FakeNow() { return now; }
+
+		class Unit : public GameObject
+		{
+		public:
+			int* ticks;
+
+			Unit(Object::Key key, int* ticks) : GameObject{ key }, ticks{ ticks } {}
+
+			void Tick(std::chrono::nanoseconds) { (*ticks)++; }
+		};
+
+		TEST_METHOD(GroupsAreSpreadOverTheirInterval)
+		{
+			using namespace std::chrono_literals;
+			TestScene testScene;
+			auto& scheduler = Scene::AddSystem<TickScheduler>(1s, &FakeNow);
+			auto tenHz = scheduler.AddGroup(100ms);
+
+			std::array<int, 10> ticks{};
+			std::array<std::chrono::nanoseconds, 10> deltas{};
+			for(int i = 0; i < 10; i++)
+				scheduler.Register(tenHz, [&, i](std::chrono::nanoseconds delta) { ticks[i]++; deltas[i] = delta; });
+
+			for(int frame = 0; frame < 10; frame++)
+			{
+				scheduler.Update(10ms);
+				Assert::AreEqual(std::size_t{ 1 }, scheduler.GetStats().ticked);
+			}
+
+			for(int i = 0; i < 10; i++)
+			{
+				Assert::AreEqual(1, ticks[i]);
+				Assert::IsTrue(deltas[i] == 10ms * (i + 1));
+			}
+		}
+
+		TEST_METHOD(EveryFrameGroupsTickEverything)
+		{
+			using namespace std::chrono_literals;
+			TestScene testScene;
+			auto& scheduler = Scene::AddSystem<TickScheduler>(1s, &FakeNow);
+			auto group = scheduler.AddGroup(TickScheduler::everyFrame);
+
+			int ticks = 0;
+			for(int i = 0; i < 5; i++)
+				scheduler.Register(group, [&](std::chrono::nanoseconds) { ticks++; });
+
+			scheduler.Update(16ms);
+			scheduler.Update(16ms);
+			Assert::AreEqual(10, ticks);
+		}
+
+		TEST_METHOD(StaleHandlesDontRemoveReusedIds)
+		{
+			using namespace std::chrono_literals;
+			TestScene testScene;
+			auto& scheduler = Scene::AddSystem<TickScheduler>(1s, &FakeNow);
+			auto group = scheduler.AddGroup(TickScheduler::everyFrame);
+
+			int ticks = 0;
+			TickHandle first = scheduler.Register(group, [&](std::chrono::nanoseconds) {});
+			scheduler.Unregister(first);
+			TickHandle second = scheduler.Register(group, [&](std::chrono::nanoseconds) { ticks++; });
+			Assert::AreEqual(first.id, second.id);
+
+			scheduler.Unregister(first);
+			scheduler.Update(16ms);
+			Assert::AreEqual(1, ticks);
+		}
+
+		TEST_METHOD(BudgetDefersAndResumesRoundRobin)
+		{
+			using namespace std::chrono_literals;
+			TestScene testScene;
+			auto& scheduler = Scene::AddSystem<TickScheduler>(3ms, &FakeNow);
+			auto group = scheduler.AddGroup(TickScheduler::everyFrame, TickPriority::Low);
+
+			std::vector<int> order;
+			for(int i = 0; i < 10; i++)
+				scheduler.Register(group, [&, i](std::chrono::nanoseconds) { order.push_back(i); now += 1ms; });
+
+			scheduler.Update(16ms);
+			Assert::AreEqual(std::size_t{ 3 }, scheduler.GetStats().ticked);
+			Assert::AreEqual(std::size_t{ 7 }, scheduler.GetStats().deferred);
+
+			scheduler.Update(16ms);
+			Assert::IsTrue(order == std::vector<int>{ 0, 1, 2, 3, 4, 5 });
+		}
+
+		TEST_METHOD(HighPriorityIgnoresBudget)
+		{
+			using namespace std::chrono_literals;
+			TestScene testScene;
+			auto& scheduler = Scene::AddSystem<TickScheduler>(3ms, &FakeNow);
+			auto low = scheduler.AddGroup(TickScheduler::everyFrame, TickPriority::Low);
+			auto high = scheduler.AddGroup(TickScheduler::everyFrame, TickPriority::High);
+
+			int lowTicks = 0;
+			int highTicks = 0;
+			for(int i = 0; i < 4; i++)
+			{
+				scheduler.Register(low, [&](std::chrono::nanoseconds) { lowTicks++; });
+				scheduler.Register(high, [&](std::chrono::nanoseconds) { highTicks++; now += 2ms; });
+			}
+
+			scheduler.Update(16ms);
+			Assert::AreEqual(4, highTicks);
+			Assert::AreEqual(0, lowTicks);
+			Assert::AreEqual(std::size_t{ 4 }, scheduler.GetStats().deferred);
+		}
+
+		TEST_METHOD(DestroyedObjectsAreDropped)
+		{
+			using namespace std::chrono_literals;
+			TestScene testScene;
+			auto& scheduler = Scene::AddSystem<TickScheduler>(1s, &FakeNow);
+			auto group = scheduler.AddGroup(TickScheduler::everyFrame);
+
+			int ticks = 0;
+			Unit* first = Scene::NewObject<Unit>(&ticks).release();
+			Unit* second = Scene::NewObject<Unit>(&ticks).release();
+			scheduler.Register(group, first);
+			scheduler.Register(group, second);
+
+			scheduler.Update(16ms);
+			Assert::AreEqual(2, ticks);
+
+			Scene::DeleteObject(first);
+			scheduler.Update(16ms);
+			scheduler.Update(16ms);
+			Assert::AreEqual(4, ticks);
+		}
+
+		TEST_METHOD(UnregisterWhileTicking)
+		{
+			using namespace std::chrono_literals;
+			TestScene testScene;
+			auto& scheduler = Scene::AddSystem<TickScheduler>(1s, &FakeNow);
+			auto group = scheduler.AddGroup(TickScheduler::everyFrame);
+
+			int ticks = 0;
+			TickHandle second;
+			TickHandle first = scheduler.Register(group, [&](std::chrono::nanoseconds)
+			{
+				scheduler.Unregister(second);
+				scheduler.Register(group, [&](std::chrono::nanoseconds) { ticks += 10; });
+			});
+			second = scheduler.Register(group, [&](std::chrono::nanoseconds) { ticks++; });
+
+			scheduler.Update(16ms);
+			Assert::AreEqual(0, ticks);
+
+			scheduler.Unregister(first);
+			scheduler.Update(16ms);
+			Assert::AreEqual(10, ticks);
+		}
+
+		TEST_METHOD(SpreadBenchmark)
+		{
+			using namespace std::chrono_literals;
+			TestScene testScene;
+			auto& scheduler = Scene::AddSystem<TickScheduler>(1s);
+			auto everyFrame = scheduler.AddGroup(TickScheduler::everyFrame);
+			auto tenHz = scheduler.AddGroup(100ms);
+			constexpr int count = 10'000;
+			constexpr int frames = 60;
+
+			volatile float sink = 0;
+			auto work = [&](std::chrono::nanoseconds delta)
+			{
+				float value = 0;
+				for(int i = 0; i < 200; i++)
+					value += std::sqrt(static_cast<float>(i + delta.count() % 7));
+				sink = sink + value;
+			};
+
+			//Time of the slowest frame
+			auto run = [&](TickGroupID group)
+			{
+				std::vector<TickHandle> handles;
+				for(int i = 0; i < count; i++)
+					handles.push_back(scheduler.Register(group, work));
+
+				std::chrono::nanoseconds worst{};
+				for(int frame = 0; frame < frames; frame++)
+				{
+					scheduler.Update(16ms);
+					worst = (std::max)(worst, scheduler.GetStats().time);
+				}
+
+				for(TickHandle handle : handles)
+					scheduler.Unregister(handle);
+				return worst;
+			};
+
+			auto everyFrameTime = run(everyFrame);
+			auto tenHzTime = run(tenHz);
+
+			Logger::WriteMessage(std::format("Slowest of {} frames ticking {} entries: every frame {}, 10 Hz spread {}\n", frames, count,
+				std::chrono::duration_cast<std::chrono::microseconds>(everyFrameTime),
+				std::chrono::duration_cast<std::chrono::microseconds>(tenHzTime)).c_str());
+		}
+	};
+
+	TEST_CLASS(ObjectMaskTests)
+	{
+		static constexpr std::uint64_t enemyTag = 1 << 0;
+		static constexpr std::uint64_t burningTag = 1 << 1;
+		static constexpr std::uint64_t staticLayer = 1 << 1;
+
+		class Unit : public GameObject
+		{
+		public:
+			int id = 0;
+			bool enemy = false;
+
+			Unit(Object::Key key, int id = 0) : GameObject{ key }, id{ id } {}
+		};
+
+		class Enemy : public Unit
+		{
+		public:
+			static constexpr std::uint64_t objectTags = enemyTag;
+
+			using Unit::Unit;
+		};
+
+		class Wall : public GameObject
+		{
+		public:
+			static constexpr std::uint64_t objectLayers = staticLayer;
+
+			using GameObject::GameObject;
+		};
+
+		template<class Range>
+		static std::vector<int> Ids(Range&& range)
+		{
+			std::vector<int> ids;
+			for(Unit* unit : range)
+				ids.push_back(unit->id);
+			std::sort(ids.begin(), ids.end());
+			return ids;
+		}
+
+		TEST_METHOD(TypesSetInitialMasks)
+		{
+			TestScene testScene;
+			auto unit = Scene::NewObject<Unit>().release();
+			auto enemy = Scene::NewObject<Enemy>().release();
+			auto wall = Scene::NewObject<Wall>().release();
+
+			Assert::AreEqual(defaultObjectLayers, Scene::GetLayers(unit));
+			Assert::AreEqual(std::uint64_t{ 0 }, Scene::GetTags(unit));
+			Assert::AreEqual(enemyTag, Scene::GetTags(enemy));
+			Assert::AreEqual(staticLayer, Scene::GetLayers(wall));
+		}
+
+		TEST_METHOD(MasksOfQueuedObjectsSurviveRegistration)
+		{
+			TestScene testScene;
+			testScene.scene->LockLifetimes();
+			auto unit = Scene::NewObject<Unit>(1).release();
+			Scene::AddTags(unit, burningTag);
+			Scene::SetLayers(unit, staticLayer);
+			testScene.scene->UnlockLifetimes();
+
+			Assert::AreEqual(burningTag, Scene::GetTags(unit));
+			Assert::AreEqual(staticLayer, Scene::GetLayers(unit));
+			Assert::IsTrue(Ids(Scene::GetObjectsExactTypeInScene<Unit>(testScene.scene.get(), { .allTags = burningTag })) == std::vector<int>{ 1 });
+		}
+
+		TEST_METHOD(FiltersComposeWithTypes)
+		{
+			TestScene testScene;
+			Scene::NewObject<Unit>(1).release();
+			Scene::NewObject<Enemy>(2).release();
+			auto burning = Scene::NewObject<Enemy>(3).release();
+			auto friendly = Scene::NewObject<Unit>(4).release();
+			Scene::AddTags(burning, burningTag);
+			Scene::AddTags(friendly, burningTag);
+			Scene::NewObject<Wall>().release();
+			Scene* scene = testScene.scene.get();
+
+			Assert::IsTrue(Ids(Scene::GetObjectsInScene<Unit>(scene, { .allTags = enemyTag })) == std::vector<int>{ 2, 3 });
+			Assert::IsTrue(Ids(Scene::GetObjectsInScene<Unit>(scene, { .allTags = burningTag })) == std::vector<int>{ 3, 4 });
+			Assert::IsTrue(Ids(Scene::GetObjectsExactTypeInScene<Unit>(scene, { .allTags = burningTag })) == std::vector<int>{ 4 });
+			Assert::IsTrue(Ids(Scene::GetObjectsInScene<Unit>(scene, { .allTags = enemyTag, .noTags = burningTag })) == std::vector<int>{ 2 });
+			Assert::IsTrue(Ids(Scene::GetObjectsInScene<Unit>(scene, { .layers = staticLayer })).empty());
+
+			int walls = 0;
+			for(GameObject* wall : Scene::GetObjectsInScene<GameObject>(scene, { .layers = staticLayer }))
+				walls++;
+			Assert::AreEqual(1, walls);
+		}
+
+		TEST_METHOD(MatchesAcrossBlocksAfterDeletes)
+		{
+			TestScene testScene;
+			std::mt19937 random{ 7 };
+			std::vector<Unit*> units;
+			for(int i = 0; i < 1000; i++)
+			{
+				Unit* unit = Scene::NewObject<Unit>(i).release();
+				if(random() % 3 == 0)
+				{
+					Scene::AddTags(unit, enemyTag);
+					unit->enemy = true;
+				}
+				units.push_back(unit);
+			}
+
+			//Swap removals have to move the masks along with the objects
+			for(int i = 0; i < 1000; i += 7)
+				Scene::DeleteObject(units[i]);
+
+			std::vector<int> expected;
+			for(Unit* unit : Scene::GetObjectsExactTypeInScene<Unit>(testScene.scene.get()))
+			{
+				if(unit->enemy)
+					expected.push_back(unit->id);
+			}
+			std::sort(expected.begin(), expected.end());
+
+			Assert::IsTrue(Ids(Scene::GetObjectsExactTypeInScene<Unit>(testScene.scene.get(), { .allTags = enemyTag })) == expected);
+		}
+
+		TEST_METHOD(FilterBenchmark)
+		{
+			TestScene testScene;
+			constexpr int count = 200'000;
+			std::mt19937 random{ 7 };
+			for(int i = 0; i < count; i++)
+			{
+				Unit* unit = Scene::NewObject<Unit>(i).release();
+				if(random() % 100 == 0)
+				{
+					Scene::AddTags(unit, enemyTag);
+					unit->enemy = true;
+				}
+			}
+			Scene* scene = testScene.scene.get();
+
+			auto start = std::chrono::steady_clock::now();
+			int walked = 0;
+			for(Unit* unit : Scene::GetObjectsExactTypeInScene<Unit>(scene))
+			{
+				if(unit->enemy)
+					walked++;
+			}
+			auto walkTime = std::chrono::steady_clock::now() - start;
+
+			start = std::chrono::steady_clock::now();
+			int filtered = 0;
+			for(Unit* unit : Scene::GetObjectsExactTypeInScene<Unit>(scene, { .allTags = enemyTag }))
+				filtered++;
+			auto filterTime = std::chrono::steady_clock::now() - start;
+
+			Assert::AreEqual(walked, filtered);
+			Logger::WriteMessage(std::format("Finding {} tagged of {} objects: member test {}, mask scan {}\n", filtered, count,
+				std::chrono::duration_cast<std::chrono::microseconds>(walkTime),
+				std::chrono::duration_cast<std::chrono::microseconds>(filterTime)).c_str());
+		}
+	};
+
+	TEST_CLASS(ObjectPoolTests)
+	{
+		struct Counts
+		{
+			int resets = 0;
+			int destructions = 0;
+		};
+
+		class Bullet : public GameObject
+		{
+		public:
+			Counts* counts;
+			float speed;
+
+			Bullet(Object::Key key, Counts* counts, float speed) : GameObject{ key }, counts{ counts }, speed{ speed } {}
+			~Bullet() { counts->destructions++; }
+
+			void Reset(Counts* newCounts, float newSpeed)
+			{
+				counts = newCounts;
+				speed = newSpeed;
+				counts->resets++;
+			}
+		};
+
+		static int CountBullets(Scene* scene)
+		{
+			int count = 0;
+			for(Bullet* bullet : Scene::GetObjectsExactTypeInScene<Bullet>(scene))
+				count++;
+			return count;
+		}
+
+		TEST_METHOD(ReleasedObjectsAreReused)
+		{
+			Counts counts;
+			TestScene testScene;
+			auto& pool = Scene::AddSystem<ObjectPool<Bullet>>(8);
+
+			Bullet* first = pool.Spawn(&counts, 1.f);
+			WeakObject<Bullet> handle = first;
+			Assert::AreEqual(1, CountBullets(testScene.scene.get()));
+
+			pool.Release(first);
+			Assert::AreEqual(0, CountBullets(testScene.scene.get()));
+			Assert::IsNull(handle.Get());
+			Assert::AreEqual(std::size_t{ 1 }, pool.KeptCount());
+
+			Bullet* second = pool.Spawn(&counts, 2.f);
+			Assert::IsTrue(first == second);
+			Assert::AreEqual(1, counts.resets);
+			Assert::AreEqual(2.f, second->speed);
+			Assert::AreEqual(1, CountBullets(testScene.scene.get()));
+			Assert::AreEqual(0, counts.destructions);
+		}
+
+		TEST_METHOD(PrewarmedObjectsAreSpawned)
+		{
+			Counts counts;
+			TestScene testScene;
+			auto& pool = Scene::AddSystem<ObjectPool<Bullet>>(4);
+			pool.Prewarm(16, &counts, 0.f);
+			Assert::AreEqual(std::size_t{ 4 }, pool.KeptCount());
+			Assert::AreEqual(0, CountBullets(testScene.scene.get()));
+
+			for(int i = 0; i < 4; i++)
+				pool.Spawn(&counts, 1.f);
+			Assert::AreEqual(4, counts.resets);
+			Assert::AreEqual(std::size_t{ 0 }, pool.KeptCount());
+		}
+
+		TEST_METHOD(ReleasesOverCapacityAreDeleted)
+		{
+			Counts counts;
+			TestScene testScene;
+			auto& pool = Scene::AddSystem<ObjectPool<Bullet>>(2);
+
+			std::vector<Bullet*> bullets;
+			for(int i = 0; i < 5; i++)
+				bullets.push_back(pool.Spawn(&counts, 1.f));
+			for(Bullet* bullet : bullets)
+				pool.Release(bullet);
+
+			Assert::AreEqual(std::size_t{ 2 }, pool.KeptCount());
+			Assert::AreEqual(3, counts.destructions);
+
+			pool.SetCapacity(1);
+			Assert::AreEqual(4, counts.destructions);
+		}
+
+		TEST_METHOD(LockedReleasesWaitForTheFlush)
+		{
+			Counts counts;
+			TestScene testScene;
+			auto& pool = Scene::AddSystem<ObjectPool<Bullet>>(8);
+			Bullet* bullet = pool.Spawn(&counts, 1.f);
+
+			testScene.scene->LockLifetimes();
+			pool.Release(bullet);
+			Assert::AreEqual(1, CountBullets(testScene.scene.get()));
+			testScene.scene->UnlockLifetimes();
+
+			Assert::AreEqual(0, CountBullets(testScene.scene.get()));
+			Assert::AreEqual(std::size_t{ 1 }, pool.KeptCount());
+		}
+
+		TEST_METHOD(SceneDeletesKeptAndActiveObjects)
+		{
+			Counts counts;
+			{
+				TestScene testScene;
+				testScene.scene->SetTeardownMode(SceneTeardownMode::Fast);
+				auto& pool = Scene::AddSystem<ObjectPool<Bullet>>(8);
+				pool.Prewarm(3, &counts, 0.f);
+				pool.Spawn(&counts, 1.f);
+			}
+			Assert::AreEqual(3, counts.destructions);
+		}
+
+		TEST_METHOD(SpawnBenchmark)
+		{
+			Counts counts;
+			TestScene testScene;
+			constexpr int count = 1000;
+			constexpr int rounds = 100;
+			std::vector<Bullet*> bullets;
+			bullets.reserve(count);
+
+			auto start = std::chrono::steady_clock::now();
+			for(int round = 0; round < rounds; round++)
+			{
+				for(int i = 0; i < count; i++)
+					bullets.push_back(Scene::NewObject<Bullet>(&counts, 1.f).release());
+				for(Bullet* bullet : bullets)
+					Scene::DeleteObject(bullet);
+				bullets.clear();
+			}
+			auto newTime = std::chrono::steady_clock::now() - start;
+
+			auto& pool = Scene::AddSystem<ObjectPool<Bullet>>(count);
+			pool.Prewarm(count, &counts, 0.f);
+			start = std::chrono::steady_clock::now();
+			for(int round = 0; round < rounds; round++)
+			{
+				for(int i = 0; i < count; i++)
+					bullets.push_back(pool.Spawn(&counts, 1.f));
+				for(Bullet* bullet : bullets)
+					pool.Release(bullet);
+				bullets.clear();
+			}
+			auto poolTime = std::chrono::steady_clock::now() - start;
+
+			Logger::WriteMessage(std::format("{} rounds of spawning and removing {} objects: new/delete {}, pool {}\n", rounds, count,
+				std::chrono::duration_cast<std::chrono::microseconds>(newTime),
+				std::chrono::duration_cast<std::chrono::microseconds>(poolTime)).c_str());
+		}
+	};
+
+	TEST_CLASS(AssetCacheTests)
+	{
+		struct Texture
+		{
+			int id;
+			std::size_t bytes;
+
+			std::size_t MemoryUsage() const { return bytes; }
+		};
+
+		//Registers a loader counting its calls for the length of a test
+		struct TextureLoader
+		{
+			std::atomic<int> loads = 0;
+			std::size_t bytes = 100;
+			std::chrono::milliseconds delay{ 0 };
+			bool fail = false;
+
+			TextureLoader()
+			{
+				AssetLoader::Register<Texture>([this](std::filesystem::path path)
+				{
+					std::this_thread::sleep_for(delay);
+					if(fail)
+						throw std::exception("Broken texture");
+					return Texture{ ++loads, bytes };
+				});
+			}
+
+			~TextureLoader()
+			{
+				AssetLoader::Unregister<Texture>();
+			}
+		};
+
+		TEST_METHOD(SamePathLoadsOnce)
+		{
+			TextureLoader loader;
+			AssetCache cache{ 1024 };
+
+			auto first = cache.Load<Texture>("textures/wall.png");
+			auto second = cache.Load<Texture>("textures/../textures/wall.png");
+			auto other = cache.Load<Texture>("textures/floor.png");
+
+			Assert::IsTrue(first == second);
+			Assert::IsFalse(first == other);
+			Assert::AreEqual(2, loader.loads.load());
+
+			AssetCacheStats stats = cache.GetStats();
+			Assert::AreEqual(std::size_t{ 1 }, stats.hits);
+			Assert::AreEqual(std::size_t{ 2 }, stats.misses);
+			Assert::AreEqual(std::size_t{ 200 }, stats.residentBytes);
+			Assert::AreEqual(std::size_t{ 0 }, stats.unreferencedBytes);
+		}
+
+		TEST_METHOD(UnreferencedAssetsStayUnderBudget)
+		{
+			TextureLoader loader;
+			AssetCache cache{ 250 };
+
+			cache.Load<Texture>("a.png");
+			cache.Load<Texture>("b.png");
+			Assert::AreEqual(std::size_t{ 200 }, cache.GetStats().unreferencedBytes);
+
+			//b was released last, a goes first
+			cache.Load<Texture>("c.png");
+			Assert::AreEqual(std::size_t{ 1 }, cache.GetStats().evictions);
+			cache.Load<Texture>("b.png");
+			Assert::AreEqual(3, loader.loads.load());
+			cache.Load<Texture>("a.png");
+			Assert::AreEqual(4, loader.loads.load());
+		}
+
+		TEST_METHOD(LoadsEvictOnceOverBudget)
+		{
+			TextureLoader loader;
+			AssetCache cache{ 250 };
+
+			cache.Load<Texture>("a.png");
+			cache.Load<Texture>("b.png");
+
+			//Evicted by the load itself, not once some handle is released
+			auto kept = cache.Load<Texture>("c.png");
+			AssetCacheStats stats = cache.GetStats();
+			Assert::AreEqual(std::size_t{ 1 }, stats.evictions);
+			Assert::AreEqual(std::size_t{ 200 }, stats.residentBytes);
+			Assert::AreEqual(std::size_t{ 100 }, stats.unreferencedBytes);
+		}
+
+		TEST_METHOD(ReferencedAssetsAreNotEvicted)
+		{
+			TextureLoader loader;
+			AssetCache cache{ 150 };
+
+			auto kept = cache.Load<Texture>("a.png");
+			cache.Load<Texture>("b.png");
+			cache.SetBudget(0);
+
+			AssetCacheStats stats = cache.GetStats();
+			Assert::AreEqual(std::size_t{ 1 }, stats.evictions);
+			Assert::AreEqual(std::size_t{ 100 }, stats.residentBytes);
+			Assert::AreEqual(1, kept->id);
+
+			kept.reset();
+			Assert::AreEqual(std::size_t{ 0 }, cache.GetStats().residentBytes);
+		}
+
+		TEST_METHOD(ConcurrentRequestsShareOneLoad)
+		{
+			TextureLoader loader;
+			loader.delay = std::chrono::milliseconds{ 50 };
+			AssetCache cache{ 1024 };
+
+			std::array<std::shared_ptr<const Texture>, 8> results;
+			{
+				std::vector<std::jthread> threads;
+				for(auto& result : results)
+					threads.emplace_back([&] { result = cache.Load<Texture>("shared.png"); });
+			}
+
+			Assert::AreEqual(1, loader.loads.load());
+			for(auto& result : results)
+				Assert::IsTrue(result == results.front());
+		}
+
+		TEST_METHOD(FailedLoadsAreRetried)
+		{
+			TextureLoader loader;
+			loader.fail = true;
+			AssetCache cache{ 1024 };
+
+			Assert::ExpectException<std::exception>([&] { cache.Load<Texture>("broken.png"); });
+
+			loader.fail = false;
+			Assert::AreEqual(1, cache.Load<Texture>("broken.png")->id);
+		}
+
+		TEST_METHOD(CacheBenchmark)
+		{
+			TextureLoader loader;
+			loader.delay = std::chrono::milliseconds{ 1 };
+			AssetCache cache{ 1024 * 1024 };
+			constexpr int count = 200;
+
+			auto start = std::chrono::steady_clock::now();
+			for(int i = 0; i < count; i++)
+				AssetLoader::Load<Texture>("wall.png");
+			auto uncachedTime = std::chrono::steady_clock::now() - start;
+
+			start = std::chrono::steady_clock::now();
+			std::vector<std::shared_ptr<const Texture>> handles;
+			for(int i = 0; i < count; i++)
+				handles.push_back(cache.Load<Texture>("wall.png"));
+			auto cachedTime = std::chrono::steady_clock::now() - start;
+
+			Logger::WriteMessage(std::format("Loading the same asset {} times: uncached {}, cached {}\n", count,
+				std::chrono::duration_cast<std::chrono::microseconds>(uncachedTime),
+				std::chrono::duration_cast<std::chrono::microseconds>(cachedTime)).c_str());
+		}
+	};
 }